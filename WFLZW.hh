@@ -3,27 +3,214 @@
 #include <cstdint>
 #include <type_traits>
 #include <cassert>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <memory>
+#include <new>
+#include <utility>
+#include <algorithm>
+#ifdef WFLZW_USE_THREADS
+#include <thread>
+#include <exception>
+#endif
+#ifdef WFLZW_USE_HUGE_PAGES
+#include <sys/mman.h>
+#endif
 
 #define WFLZW_VERSION 0x010003
 #define WFLZW_VERSION_STRING "1.0.3"
 #define WFLZW_COPYRIGHT_STRING "WFLZW v" WFLZW_VERSION_STRING " (C)2018 Juha Nieminen"
 
+#ifdef WFLZW_COLLECT_STATS
+#define WFLZW_STATS(statement) statement
+#else
+#define WFLZW_STATS(statement)
+#endif
+
 namespace WFLZW
 {
     using Byte = std::uint8_t;
 
+    // Number of bits needed to represent the given value.
+    constexpr unsigned bitSizeOf(unsigned value)
+    { return value > 1 ? 1 + bitSizeOf(value >> 1) : 1; }
+
     enum class DictionaryType { list, tree };
 
-    template<unsigned kDictionaryMaxSize, DictionaryType, unsigned kOutputBufferSize>
+    template<unsigned kDictionaryMaxSize, DictionaryType = DictionaryType::tree,
+             unsigned kOutputBufferSize = 256, typename Symbol_t = Byte, bool kLogCodes = false>
     class Encoder;
 
-    template<unsigned kDictionaryMaxSize>
+    template<unsigned kDictionaryMaxSize, typename Symbol_t = Byte>
     class Decoder;
 
-    enum class EncodeStatus { ok, inputByteTooLarge };
+    enum class EncodeStatus { ok, inputByteTooLarge, verificationFailed };
     enum class DecodeStatus { inputContinues, inputDone, inputError };
 
-    struct ByteRemapper;
+    struct ResetPoint
+    {
+        std::uint64_t bitOffset, byteOffset;
+    };
+
+    enum class BlockType: Byte
+    { end = 0, stored = 1, lzw = 2, filteredLZW = 3, entropyLZW = 4, filteredEntropyLZW = 5 };
+    enum class Filter: Byte { none = 0, delta = 1, shuffle = 2, shuffleDelta = 3 };
+
+    template<typename Symbol_t> struct SymbolRemapper;
+    using ByteRemapper = SymbolRemapper<Byte>;
+    enum class RootOrder { byteValue, frequency };
+
+    struct PackedIndex24;
+
+    template<unsigned kIndexBits, std::uint32_t kStoredEmptyIndex>
+    class BitPackedIndex;
+
+    template<typename Record_t, unsigned kRecordBits, unsigned kRecordsAmount>
+    class BitPackedArray;
+
+#ifdef WFLZW_PACKED_INDICES
+    const bool kUsePackedIndices = true;
+#else
+    const bool kUsePackedIndices = false;
+#endif
+
+#ifdef WFLZW_BIT_PACKED_INDICES
+    const bool kUseBitPackedIndices = true;
+#else
+    const bool kUseBitPackedIndices = false;
+#endif
+
+    template<unsigned kDictionaryMaxSize>
+    class CodeEntropyEncoder;
+
+    template<unsigned kDictionaryMaxSize>
+    class CodeEntropyDecoder;
+
+    template<unsigned kDictionaryMaxSize, DictionaryType, unsigned kBlockSize>
+    class BlockEncoder;
+
+    template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+    class BlockDecoder;
+
+    struct ByteSpan
+    {
+        const Byte* data;
+        std::size_t size;
+    };
+
+    template<unsigned kDictionaryMaxSize, DictionaryType>
+    class BatchEncoder;
+
+    template<unsigned kDictionaryMaxSize>
+    class BatchDecoder;
+
+#ifdef WFLZW_COLLECT_STATS
+    struct EncoderStats
+    {
+        std::uint64_t inputBytes, codesPerBitSize[33], dictionaryResets, streamsFinalized;
+        std::uint64_t dictionaryLookups, dictionaryProbes, outputCallbacks;
+
+        std::uint64_t codes() const;
+        double averageMatchLength() const;
+        double averageProbeDepth() const;
+    };
+
+    struct DecoderStats
+    {
+        std::uint64_t codesPerBitSize[33], dictionaryResets;
+        std::uint64_t outputCallbacks, chainLengthTotal, longestChain;
+
+        std::uint64_t codes() const;
+        double averageChainLength() const;
+    };
+#endif
+
+    enum class StreamStatus { inputNeeded, outputFull, done, inputError };
+
+    template<unsigned kDictionaryMaxSize>
+    class DecoderStream;
+
+    template<unsigned kDictionaryMaxSize, DictionaryType, unsigned kOutputBufferSize>
+    class LookaheadEncoder;
+
+    /* The code stream layout of a classic LZW format; see ClassicEncoder.
+       Codes 0 to rootsAmount-1 are the byte values, followed by the clear
+       code and the end code when the format has them.
+    */
+    enum class BitOrder { lsbFirst, msbFirst };
+
+    struct ClassicFormat
+    {
+        BitOrder bitOrder;
+        unsigned rootsAmount, minBitSize, maxBitSize;
+        bool hasClearCode, hasEndCode, clearCodeFirst, earlyChange;
+        // Unix compress: the 3-byte header, and codes written in groups of 8.
+        bool compressHeader, codeGroups;
+    };
+
+    ClassicFormat unixCompressFormat(unsigned maxBitSize = 16);
+    ClassicFormat gifFormat(unsigned minCodeSize = 8);
+    ClassicFormat tiffFormat();
+
+    template<unsigned kMaxBitSize> class ClassicEncoder;
+    template<unsigned kMaxBitSize> class ClassicDecoder;
+
+    template<unsigned kDictionaryMaxSize>
+    class PatternSearcher;
+
+    template<unsigned kDictionaryMaxSize, DictionaryType, unsigned kOutputBufferSize>
+    class VerifyingEncoder;
+
+    template<unsigned kDictionaryMaxSize = 65536>
+    constexpr std::size_t compressedSizeBound(std::size_t inputSize);
+
+    template<unsigned kDictionaryMaxSize = 65536, DictionaryType = DictionaryType::tree>
+    EncodeStatus compress(const Byte*, std::size_t, std::vector<Byte>& output);
+    template<unsigned kDictionaryMaxSize = 65536, DictionaryType = DictionaryType::tree>
+    EncodeStatus compress(const Byte*, std::size_t, std::string& output);
+    template<unsigned kDictionaryMaxSize = 65536, DictionaryType = DictionaryType::tree>
+    std::vector<Byte> compress(const Byte*, std::size_t);
+
+    template<unsigned kDictionaryMaxSize = 65536>
+    DecodeStatus decompress(const Byte*, std::size_t, std::vector<Byte>& output,
+                            std::size_t sizeHint = 0);
+    template<unsigned kDictionaryMaxSize = 65536>
+    DecodeStatus decompress(const Byte*, std::size_t, std::string& output,
+                            std::size_t sizeHint = 0);
+    template<unsigned kDictionaryMaxSize = 65536>
+    std::vector<Byte> decompress(const Byte*, std::size_t, std::size_t sizeHint = 0);
+
+    template<unsigned kDictionaryMaxSize = 65536, DictionaryType = DictionaryType::tree>
+    EncodeStatus compress(const Byte*, std::size_t, std::vector<Byte>& output,
+                          std::vector<ResetPoint>& resetPoints);
+    template<unsigned kDictionaryMaxSize = 65536>
+    DecodeStatus decompressSegment(const Byte*, std::size_t, const std::vector<ResetPoint>&,
+                                   std::size_t segmentIndex, std::vector<Byte>& output);
+#ifdef WFLZW_USE_THREADS
+    template<unsigned kDictionaryMaxSize = 65536>
+    DecodeStatus decompressInParallel(const Byte*, std::size_t, const std::vector<ResetPoint>&,
+                                      std::vector<Byte>& output, unsigned threadsAmount);
+#endif
+    void writeResetPoints(const std::vector<ResetPoint>&, std::vector<Byte>& output);
+    bool readResetPoints(const Byte*, std::size_t, std::vector<ResetPoint>&);
+
+    void* allocateLargeObjectMemory(std::size_t size);
+    void deallocateLargeObjectMemory(void*, std::size_t size);
+
+    template<typename Object_t>
+    struct LargeObjectDeleter { void operator()(Object_t*) const; };
+
+    template<typename Object_t>
+    using LargeObjectPtr = std::unique_ptr<Object_t, LargeObjectDeleter<Object_t>>;
+
+    template<typename Object_t, typename... Args_t>
+    LargeObjectPtr<Object_t> makeLargeObject(Args_t&&...);
+
+    void applyFilter(Filter, unsigned elementSize, const Byte* input, Byte* output,
+                     std::size_t amount);
+    void reverseFilter(Filter, unsigned elementSize, const Byte* input, Byte* output,
+                       std::size_t amount);
 
     using Encoder64k = Encoder<65536, DictionaryType::tree, 256>;
     using Encoder32k = Encoder<32768, DictionaryType::tree, 256>;
@@ -36,611 +223,4979 @@ namespace WFLZW
 //============================================================================
 // Encoder
 //============================================================================
-template<unsigned kDictionaryMaxSize,
-         WFLZW::DictionaryType kDictionaryType = WFLZW::DictionaryType::tree,
-         unsigned kOutputBufferSize = 256>
+/* With Symbol_t std::uint16_t the input consists of 16-bit symbols instead
+   of bytes (for example 12-bit samples with maxInputByteValue 4095), and
+   "byte" in the names of the functions means a symbol. The stream format is
+   the same, with the symbols as the roots.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictionaryType,
+         unsigned kOutputBufferSize, typename Symbol_t, bool kLogCodes>
 class WFLZW::Encoder
 {
     static_assert(kDictionaryMaxSize > 1,
                   "WFLZW::Encoder kDictionaryMaxSize template parameter is too small");
+    static_assert(kDictionaryMaxSize <= 0x80000000U,
+                  "WFLZW::Encoder kDictionaryMaxSize template parameter is too large");
+    static_assert(std::is_same<Symbol_t, WFLZW::Byte>::value ||
+                  std::is_same<Symbol_t, std::uint16_t>::value,
+                  "WFLZW::Encoder Symbol_t must be WFLZW::Byte or std::uint16_t");
 
-    static const WFLZW::Byte kMaxInputByteValueDefault =
-        (kDictionaryMaxSize <= 257U ? WFLZW::Byte(kDictionaryMaxSize - 3) : WFLZW::Byte(255U));
+    static const unsigned kMaxSymbolValue = Symbol_t(~Symbol_t(0));
+    static const Symbol_t kMaxInputByteValueDefault =
+        (kDictionaryMaxSize <= kMaxSymbolValue + 2U ?
+         Symbol_t(kDictionaryMaxSize - 3) : Symbol_t(kMaxSymbolValue));
 
  public:
-    Encoder(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault);
+    Encoder(Symbol_t maxInputByteValue = kMaxInputByteValueDefault,
+            bool enableFlush = false);
 
-    void initialize(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault);
+    void initialize(Symbol_t maxInputByteValue = kMaxInputByteValueDefault,
+                    bool enableFlush = false);
 
-    WFLZW::Byte maxByteValue() const { return mMaxInputByteValue; }
+    Symbol_t maxByteValue() const { return mMaxInputByteValue; }
 
-    WFLZW::EncodeStatus encodeBytes(const WFLZW::Byte*, const std::size_t amount);
-    WFLZW::EncodeStatus encodeBytes(const WFLZW::Byte*, const std::size_t amount,
-                                    const WFLZW::ByteRemapper&);
-    WFLZW::EncodeStatus encodeByte(WFLZW::Byte);
-    WFLZW::EncodeStatus encodeByte(WFLZW::Byte, const WFLZW::ByteRemapper&);
+    WFLZW::EncodeStatus encodeBytes(const Symbol_t*, const std::size_t amount);
+    WFLZW::EncodeStatus encodeBytes(const Symbol_t*, const std::size_t amount,
+                                    const WFLZW::SymbolRemapper<Symbol_t>&);
+    WFLZW::EncodeStatus encodeByte(Symbol_t);
+    WFLZW::EncodeStatus encodeByte(Symbol_t, const WFLZW::SymbolRemapper<Symbol_t>&);
+    void flush();
     void finalizeEncoding();
 
+    /* Ends the current message of a session like finalizeEncoding() ends a
+       stream, but keeps the dictionary for the next message.
+    */
+    void finalizeMessage();
+
+    /* For appending to the stream later, possibly in another process:
+       finalizeEncoding() can also store the state of the encoder as it was
+       before finalizing into checkpoint. resumeEncoding() restores it, giving
+       the amount of bytes of the stream to keep; the output that follows
+       continues from there. Returns false if the checkpoint is invalid, in
+       which case the encoder is initialized as for a new stream.
+    */
+    void finalizeEncoding(std::vector<WFLZW::Byte>& checkpoint);
+    bool resumeEncoding(const WFLZW::Byte* checkpoint, std::size_t checkpointSize,
+                        std::uint64_t& streamSize);
+
     virtual void outputEncodedBytes(const WFLZW::Byte*, unsigned) {}
+    virtual void outputResetPoint(const WFLZW::ResetPoint&) {}
 
+#ifdef WFLZW_COLLECT_STATS
+    WFLZW::EncoderStats stats() const;
+    void resetStats();
+#endif
 
- private:
+
+ protected:
     using Index_t = typename
         std::conditional<(kDictionaryMaxSize <= 0x100U), std::uint8_t,
         typename std::conditional<(kDictionaryMaxSize <= 0x10000U), std::uint16_t,
         std::uint32_t>::type>::type;
 
+    /* Encoding one string at a time, for parsers other than the greedy one
+       (the single bytes are the strings at their byte values): findString()
+       gets the index of the string prefixIndex+byte if it's in the
+       dictionary. outputString() outputs the code of a string of length bytes
+       which is followed by nextByte in the input, and adds the entry the
+       decoder will add for it, as a duplicate that findString() doesn't find
+       if the string extended with nextByte is already in the dictionary. If
+       the dictionary becomes full, nextByte is also output and the dictionary
+       reset (as in greedy parsing), and true is returned. Neither may be
+       called while the encoder has a current string.
+    */
+    bool findString(Index_t prefixIndex, Symbol_t, Index_t& index) const;
+    bool outputString(Index_t index, unsigned length, Symbol_t nextByte);
+
+    /* With kLogCodes, every code output (also the control codes) is appended
+       to codeLog(). Otherwise the log is an empty class whose push_back()
+       compiles to nothing.
+    */
+    struct NoCodeLog { void push_back(Index_t) {} };
+    using CodeLog_t = typename std::conditional<kLogCodes, std::vector<Index_t>, NoCodeLog>::type;
+
+    CodeLog_t& codeLog() { return mCodeLog; }
+
+
+ private:
+    template<unsigned> friend class WFLZW::ClassicEncoder;
+
     static_assert(kOutputBufferSize >= sizeof(Index_t),
                   "WFLZW::Encoder kOutputBufferSize template parameter is too small");
 
+    // With WFLZW_PACKED_INDICES, dictionaries with 24-bit indices store them in three bytes.
+    using IndexStorage_t = typename
+        std::conditional<(WFLZW::kUsePackedIndices && !WFLZW::kUseBitPackedIndices &&
+                          kDictionaryMaxSize > 0x10000U && kDictionaryMaxSize < 0x1000000U),
+                         WFLZW::PackedIndex24, Index_t>::type;
+
+    static const Index_t kEmptyIndexValue =
+        (std::is_same<IndexStorage_t, WFLZW::PackedIndex24>::value ?
+         Index_t(0xFFFFFFU) : Index_t(~Index_t()));
+
+    /* With WFLZW_BIT_PACKED_INDICES, dictionaries with 32-bit indices store
+       them in kIndexBits bits. The links always point to entries after the
+       roots, so 0 can be used as the stored value of kEmptyIndex.
+    */
+    static const bool kBitPackedIndices =
+        (WFLZW::kUseBitPackedIndices && kDictionaryMaxSize > 0x10000U);
+    static const unsigned kIndexBits = WFLZW::bitSizeOf(kDictionaryMaxSize - 1);
+    using PackedLink_t = WFLZW::BitPackedIndex<kIndexBits, 0>;
+
     class DictionaryList
     {
      public:
-        static const Index_t kEmptyIndex = ~Index_t();
+        static const Index_t kEmptyIndex = kEmptyIndexValue;
 
-        void initialize(WFLZW::Byte);
-        Index_t addIfNotExistent(const Index_t, const WFLZW::Byte);
+        void initialize(Symbol_t, unsigned reservedCodesAmount);
+        Index_t addIfNotExistent(const Index_t, const Symbol_t);
+        Index_t find(const Index_t, const Symbol_t) const;
+        void addUnreachable(const Symbol_t);
         unsigned size() const { return mEntriesAmount; }
         bool isFull() const { return mEntriesAmount >= kDictionaryMaxSize; }
+        void getPrefixIndices(unsigned rootsAmount, unsigned firstEntryIndex,
+                              std::vector<Index_t>&) const;
+        Symbol_t byteAt(Index_t index) const { return mBytes[index]; }
 
      private:
         struct ListIndices
         {
-            Index_t first, next;
+            IndexStorage_t first, next;
         };
 
-        ListIndices mListIndices[kDictionaryMaxSize];
-        WFLZW::Byte mBytes[kDictionaryMaxSize];
+        struct PackedListIndices
+        {
+            PackedLink_t first, next;
+
+            PackedListIndices(WFLZW::Byte* bytes, std::size_t bitOffset):
+                first(bytes, bitOffset), next(bytes, bitOffset + kIndexBits) {}
+        };
+
+        using ListIndicesArray_t = typename std::conditional
+            <kBitPackedIndices,
+             WFLZW::BitPackedArray<PackedListIndices, 2 * kIndexBits, kDictionaryMaxSize>,
+             ListIndices[kDictionaryMaxSize]>::type;
+
+        ListIndicesArray_t mListIndices;
+        Symbol_t mBytes[kDictionaryMaxSize];
         unsigned mEntriesAmount;
+
+#ifdef WFLZW_COLLECT_STATS
+     public:
+        std::uint64_t mLookupsAmount = 0, mProbesAmount = 0;
+#endif
     };
 
     class DictionaryTree
     {
      public:
-        static const Index_t kEmptyIndex = ~Index_t();
+        static const Index_t kEmptyIndex = kEmptyIndexValue;
 
-        void initialize(WFLZW::Byte);
-        Index_t addIfNotExistent(const Index_t, const WFLZW::Byte);
+        void initialize(Symbol_t, unsigned reservedCodesAmount);
+        Index_t addIfNotExistent(const Index_t, const Symbol_t);
+        Index_t find(const Index_t, const Symbol_t) const;
+        void addUnreachable(const Symbol_t);
         unsigned size() const { return mEntriesAmount; }
         bool isFull() const { return mEntriesAmount >= kDictionaryMaxSize; }
+        void getPrefixIndices(unsigned rootsAmount, unsigned firstEntryIndex,
+                              std::vector<Index_t>&) const;
+        Symbol_t byteAt(Index_t index) const { return mBytes[index]; }
 
      private:
         struct ListIndices
         {
-            Index_t first, left, right;
+            IndexStorage_t first, left, right;
         };
 
-        ListIndices mListIndices[kDictionaryMaxSize];
-        WFLZW::Byte mBytes[kDictionaryMaxSize];
+        struct PackedListIndices
+        {
+            PackedLink_t first, left, right;
+
+            PackedListIndices(WFLZW::Byte* bytes, std::size_t bitOffset):
+                first(bytes, bitOffset), left(bytes, bitOffset + kIndexBits),
+                right(bytes, bitOffset + 2 * kIndexBits) {}
+        };
+
+        using ListIndicesArray_t = typename std::conditional
+            <kBitPackedIndices,
+             WFLZW::BitPackedArray<PackedListIndices, 3 * kIndexBits, kDictionaryMaxSize>,
+             ListIndices[kDictionaryMaxSize]>::type;
+
+        ListIndicesArray_t mListIndices;
+        Symbol_t mBytes[kDictionaryMaxSize];
         unsigned mEntriesAmount;
+
+#ifdef WFLZW_COLLECT_STATS
+     public:
+        std::uint64_t mLookupsAmount = 0, mProbesAmount = 0;
+#endif
     };
 
     using Dictionary = typename
         std::conditional<kDictionaryType == WFLZW::DictionaryType::list,
                          DictionaryList, DictionaryTree>::type;
 
+    /* The code width grows from kMinBitSize (when the maximum input byte value
+       is 1) up to kMaxBitSize, one bit at a time. encodeBytes() runs a separate
+       loop for each width, with the width as a compile-time constant.
+    */
+    static const unsigned kMinBitSize = 2;
+    static const unsigned kMaxBitSize = WFLZW::bitSizeOf(kDictionaryMaxSize - 1);
+
+    /* The checkpoint consists of a fixed-size header (see finalizeEncoding())
+       followed by the prefix index (kCheckpointIndexBytes bytes) and the byte
+       (symbol) of each dictionary entry after the roots and the reserved codes.
+    */
+    static const unsigned kCheckpointHeaderSize = 32 + sizeof(Symbol_t);
+    static const unsigned kCheckpointIndexBytes = (kMaxBitSize + 7) / 8;
+
+    struct IdentityByteMap
+    {
+        Symbol_t operator()(Symbol_t byte) const { return byte; }
+    };
+
+    struct RemapperByteMap
+    {
+        const Symbol_t* encodeMap;
+        Symbol_t operator()(Symbol_t byte) const { return encodeMap[byte]; }
+    };
+
     Dictionary mDictionary;
     WFLZW::Byte mOutputBuffer[kOutputBufferSize];
-    unsigned mOutputBufferIndex, mOutputBufferBitOffset, mBitSize;
+    /* Codes are collected into mOutputBits, and moved to mOutputBuffer four
+       bytes at a time. (At most 31 bits are left pending, so a 32-bit code
+       always fits.)
+    */
+    std::uint64_t mOutputBits;
+    unsigned mOutputBitsAmount, mOutputBufferIndex, mBitSize;
+    // Bytes given to outputEncodedBytes() and taken as input in the current stream.
+    std::uint64_t mOutputBytesTotal, mInputBytesTotal;
     Index_t mIndex, mMaxOutputValueForCurrentBitSize;
-    WFLZW::Byte mMaxInputByteValue;
-    bool mDictionaryHasBeenReset;
+    Symbol_t mMaxInputByteValue;
+    bool mFlushEnabled;
+    CodeLog_t mCodeLog;
+#ifdef WFLZW_COLLECT_STATS
+    WFLZW::EncoderStats mStats;
+#endif
 
     void reset();
+
+    template<typename ByteMap_t>
+    WFLZW::EncodeStatus encodeBytesWithByteMap(const Symbol_t*, const std::size_t,
+                                               const ByteMap_t&);
+    template<unsigned kBitSize, typename ByteMap_t>
+    std::size_t encodeBytesWithCurrentBitSize(const Symbol_t*, const std::size_t,
+                                              const ByteMap_t&, std::true_type);
+    template<unsigned kBitSize, typename ByteMap_t>
+    std::size_t encodeBytesWithCurrentBitSize(const Symbol_t*, const std::size_t,
+                                              const ByteMap_t&, std::false_type);
+    template<unsigned kBitSize, typename ByteMap_t>
+    std::size_t encodeBytesWithBitSize(const Symbol_t*, const std::size_t, const ByteMap_t&);
+
+    unsigned firstEntryIndex() const { return mMaxInputByteValue + (mFlushEnabled ? 3U : 2U); }
+    void outputResetPointAt(std::uint64_t inputOffset);
+    void outputStringAndControlCode(Index_t);
     void outputIndex(Index_t);
+    template<unsigned kBitSize> void outputIndex(Index_t);
+    void outputPendingBytes(unsigned bytesAmount);
+    void outputPendingBits();
     void incrementOutputBufferIndex();
-    void outputByte(WFLZW::Byte, unsigned);
 };
 
 
 //============================================================================
 // Decoder
 //============================================================================
-template<unsigned kDictionaryMaxSize>
+// Symbol_t as with Encoder.
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
 class WFLZW::Decoder
 {
     static_assert(kDictionaryMaxSize > 1,
                   "WFLZW::Decoder kDictionaryMaxSize template parameter is too small");
+    static_assert(kDictionaryMaxSize <= 0x80000000U,
+                  "WFLZW::Decoder kDictionaryMaxSize template parameter is too large");
+    static_assert(std::is_same<Symbol_t, WFLZW::Byte>::value ||
+                  std::is_same<Symbol_t, std::uint16_t>::value,
+                  "WFLZW::Decoder Symbol_t must be WFLZW::Byte or std::uint16_t");
 
-    static const WFLZW::Byte kMaxInputByteValueDefault =
-        (kDictionaryMaxSize <= 257U ? WFLZW::Byte(kDictionaryMaxSize - 3) : WFLZW::Byte(255U));
+    static const unsigned kMaxSymbolValue = Symbol_t(~Symbol_t(0));
+    static const Symbol_t kMaxInputByteValueDefault =
+        (kDictionaryMaxSize <= kMaxSymbolValue + 2U ?
+         Symbol_t(kDictionaryMaxSize - 3) : Symbol_t(kMaxSymbolValue));
 
  public:
-    Decoder(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault);
+    Decoder(Symbol_t maxInputByteValue = kMaxInputByteValueDefault,
+            bool enableFlush = false);
 
-    void initialize(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault);
+    void initialize(Symbol_t maxInputByteValue = kMaxInputByteValueDefault,
+                    bool enableFlush = false);
 
-    WFLZW::Byte maxByteValue() const { return mMaxInputByteValue; }
+    Symbol_t maxByteValue() const { return mMaxInputByteValue; }
 
     WFLZW::DecodeStatus decodeBytes(const WFLZW::Byte*, const std::size_t amount);
     WFLZW::DecodeStatus decodeByte(WFLZW::Byte);
 
-    virtual void outputDecodedBytes(WFLZW::Byte*, unsigned) {}
+    /* For starting to decode at a reset point in the middle of a byte: takes
+       the bits of firstByte above the lowest bitOffset bits as the first
+       input. The input given to decodeBytes() continues from the next byte.
+    */
+    void startAtBitOffset(WFLZW::Byte firstByte, unsigned bitOffset);
 
+    virtual void outputDecodedBytes(Symbol_t*, unsigned) {}
 
- private:
+#ifdef WFLZW_COLLECT_STATS
+    const WFLZW::DecoderStats& stats() const { return mStats; }
+    void resetStats();
+#endif
+
+
+ protected:
     using Index_t = typename
         std::conditional<(kDictionaryMaxSize <= 0x10000U), std::uint16_t, std::uint32_t>::type;
-    static const Index_t kEmptyIndex = ~Index_t();
 
-    Index_t mPrefixIndices[kDictionaryMaxSize];
-    WFLZW::Byte mBytes[kDictionaryMaxSize];
-    WFLZW::Byte mDecodeBuffer[kDictionaryMaxSize];
-    unsigned mEntriesAmount;
+    /* Decoding one code at a time: readIndex() extracts the next code from
+       the input (returning false if more input is needed), and decodeIndex()
+       decodes it.
+    */
+    bool readIndex(const WFLZW::Byte*&, const WFLZW::Byte*, Index_t&);
+    WFLZW::DecodeStatus decodeIndex(Index_t);
+
+
+ private:
+    // With WFLZW_PACKED_INDICES, dictionaries with 24-bit indices store them in three bytes.
+    using IndexStorage_t = typename
+        std::conditional<(WFLZW::kUsePackedIndices && !WFLZW::kUseBitPackedIndices &&
+                          kDictionaryMaxSize > 0x10000U && kDictionaryMaxSize < 0x1000000U),
+                         WFLZW::PackedIndex24, Index_t>::type;
+
+    static const Index_t kEmptyIndex =
+        (std::is_same<IndexStorage_t, WFLZW::PackedIndex24>::value ?
+         Index_t(0xFFFFFFU) : Index_t(~Index_t()));
+
+    static const unsigned kMinBitSize = 2;
+    static const unsigned kMaxBitSize = WFLZW::bitSizeOf(kDictionaryMaxSize - 1);
+
+    // Needs to hold up to kMaxBitSize-1 pending bits plus one input byte.
+    using InputBuffer_t = typename
+        std::conditional<(kMaxBitSize + 7 <= 32), std::uint32_t, std::uint64_t>::type;
+
+    /* With WFLZW_BIT_PACKED_INDICES, dictionaries with 32-bit indices store
+       the prefixes in kMaxBitSize bits. Entry kDictionaryMaxSize-1 is never a
+       prefix, so the largest storable value is free for kEmptyIndex.
+    */
+    using PrefixIndicesArray_t = typename std::conditional
+        <(WFLZW::kUseBitPackedIndices && kDictionaryMaxSize > 0x10000U),
+         WFLZW::BitPackedArray<WFLZW::BitPackedIndex<kMaxBitSize, (~0U >> (32 - kMaxBitSize))>,
+                               kMaxBitSize, kDictionaryMaxSize>,
+         IndexStorage_t[kDictionaryMaxSize]>::type;
+
+    PrefixIndicesArray_t mPrefixIndices;
+    Symbol_t mBytes[kDictionaryMaxSize];
+    Symbol_t mDecodeBuffer[kDictionaryMaxSize];
+    unsigned mEntriesAmount, mFirstEntryIndex, mSyncIndex;
     unsigned mBitSize, mBitOffset;
     Index_t mOldIndex;
-    Index_t mInputBuffer, mMaxInputValueForCurrentBitSize;
-    WFLZW::Byte mMaxInputByteValue, mOldFirstByte;
+    Index_t mMaxInputValueForCurrentBitSize;
+    InputBuffer_t mInputBuffer;
+    Symbol_t mMaxInputByteValue, mOldFirstByte;
+#ifdef WFLZW_COLLECT_STATS
+    WFLZW::DecoderStats mStats;
+#endif
 
     void reset();
-    WFLZW::DecodeStatus decodeIndex(Index_t);
-    WFLZW::Byte extractAndOutputStringAt(Index_t);
-    void addToDictionary(Index_t, WFLZW::Byte);
+    template<unsigned kBitSize>
+    WFLZW::DecodeStatus decodeBytesWithCurrentBitSize(const WFLZW::Byte*&, const WFLZW::Byte*,
+                                                      std::true_type);
+    template<unsigned kBitSize>
+    WFLZW::DecodeStatus decodeBytesWithCurrentBitSize(const WFLZW::Byte*&, const WFLZW::Byte*,
+                                                      std::false_type);
+    template<unsigned kBitSize>
+    WFLZW::DecodeStatus decodeBytesWithBitSize(const WFLZW::Byte*&, const WFLZW::Byte*);
+    Symbol_t extractAndOutputStringAt(Index_t);
+    void addToDictionary(Index_t, Symbol_t);
 };
 
 
 //============================================================================
 // Byte remapper
 //============================================================================
-struct WFLZW::ByteRemapper
+/* Maps the byte values that appear in the input to consecutive values
+   starting from 0, so that the encoder can use a smaller maximum byte value
+   (and thus initial code width). With RootOrder::frequency the most common
+   bytes get the smallest values. With includeUnseenBytes all 256 values are
+   mapped (with frequency order the unseen ones last), so that the map can be
+   created from the start of the input only. Otherwise unseen bytes are
+   mapped to 255, which the encoder rejects as too large unless all 256
+   values were seen.
+
+   SymbolRemapper<std::uint16_t> does the same for 16-bit symbols. It takes
+   768 kB, so it's best not allocated on the stack.
+*/
+template<typename Symbol_t>
+struct WFLZW::SymbolRemapper
 {
-    WFLZW::Byte encodeMap[256] = {}, decodeMap[256] = {};
+    static const unsigned kSymbolsAmount = 1U << (8 * sizeof(Symbol_t));
+
+    Symbol_t encodeMap[kSymbolsAmount] = {}, decodeMap[kSymbolsAmount] = {};
     unsigned decodeMapSize = 0;
+    std::uint64_t byteCounts[kSymbolsAmount] = {};
 
-    void createEncodeMapFromInputBytes(const WFLZW::Byte* bytes, const std::size_t amount);
+    void createEncodeMapFromInputBytes(const Symbol_t* bytes, const std::size_t amount,
+                                       WFLZW::RootOrder = WFLZW::RootOrder::byteValue);
 
     void startEncodeMapCreation();
-    void addInputByteForEncodeMap(WFLZW::Byte byte);
-    void finalizeEncodeMapCreation();
+    void addInputByteForEncodeMap(Symbol_t byte);
+    void addInputBytesForEncodeMap(const Symbol_t* bytes, const std::size_t amount);
+    void finalizeEncodeMapCreation(WFLZW::RootOrder = WFLZW::RootOrder::byteValue,
+                                   bool includeUnseenBytes = false);
 
-    void decodeBytes(WFLZW::Byte* bytes, const std::size_t amount) const;
+    // The maximum byte value to give to the encoder and decoder.
+    Symbol_t maxByteValue() const
+    { return static_cast<Symbol_t>(decodeMapSize > 0 ? decodeMapSize - 1 : 0); }
+
+    void decodeBytes(Symbol_t* bytes, const std::size_t amount) const;
+
+ private:
+    void addInputBytesForEncodeMap(const Symbol_t*, const std::size_t, std::true_type);
+    void addInputBytesForEncodeMap(const Symbol_t*, const std::size_t, std::false_type);
 };
 
 
 //============================================================================
-// Implementations
+// Packed dictionary index
 //============================================================================
-inline void WFLZW::ByteRemapper::createEncodeMapFromInputBytes
-(const WFLZW::Byte* bytes, const std::size_t amount)
-{
-    startEncodeMapCreation();
-    for(std::size_t i = 0; i < amount; ++i)
-        addInputByteForEncodeMap(bytes[i]);
-    finalizeEncodeMapCreation();
-}
-
-inline void WFLZW::ByteRemapper::startEncodeMapCreation()
-{
-    *this = WFLZW::ByteRemapper();
-}
-
-inline void WFLZW::ByteRemapper::addInputByteForEncodeMap(WFLZW::Byte byte)
+/* A dictionary index stored in three bytes (little-endian), for dictionaries
+   of 65537 to 2^24-1 entries, which would otherwise use 32-bit indices. This
+   reduces the size of the encoder by 23% and the decoder by 17%, but reading
+   an index takes more instructions, which slows down dictionary walks, so
+   it's only used if WFLZW_PACKED_INDICES is defined.
+*/
+struct WFLZW::PackedIndex24
 {
-    encodeMap[byte] = 1;
-}
+    WFLZW::Byte mBytes[3];
 
-inline void WFLZW::ByteRemapper::finalizeEncodeMapCreation()
-{
-    for(unsigned i = 0; i < 256; ++i)
+    PackedIndex24& operator=(std::uint32_t value)
     {
-        if(encodeMap[i])
-        {
-            encodeMap[i] = static_cast<WFLZW::Byte>(decodeMapSize);
-            decodeMap[decodeMapSize++] = static_cast<WFLZW::Byte>(i);
-        }
+        mBytes[0] = static_cast<WFLZW::Byte>(value);
+        mBytes[1] = static_cast<WFLZW::Byte>(value >> 8);
+        mBytes[2] = static_cast<WFLZW::Byte>(value >> 16);
+        return *this;
     }
-}
 
-inline void WFLZW::ByteRemapper::decodeBytes(WFLZW::Byte* bytes, const std::size_t amount) const
-{
-    for(std::size_t i = 0; i < amount; ++i)
-        bytes[i] = decodeMap[bytes[i]];
-}
+    operator std::uint32_t() const
+    {
+        return std::uint32_t(mBytes[0]) | (std::uint32_t(mBytes[1]) << 8) |
+            (std::uint32_t(mBytes[2]) << 16);
+    }
+};
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::DictionaryList::initialize
-(WFLZW::Byte maxInputByteValue)
-{
-    const unsigned maxIndex = static_cast<unsigned>(maxInputByteValue) + 1;
-    mEntriesAmount = maxIndex + 1;
-    for(unsigned i = 0; i < maxIndex; ++i)
-        mListIndices[i].first = kEmptyIndex;
-}
+/* With WFLZW_BIT_PACKED_INDICES, dictionaries of more than 65536 entries
+   store their indices in exactly as many bits as the largest index needs
+   (17 bits with 131072 entries) instead, in a BitPackedArray of records of
+   one or more BitPackedIndex fields. This reduces the size of the encoder by
+   43% and the decoder by 31% with 131072 entries. An index is read with an
+   unaligned 64-bit load, a shift and a mask, and written with a
+   read-modify-write of the same 64 bits, which makes encoding about as much
+   slower as WFLZW_PACKED_INDICES does, and decoding somewhat slower still.
+   It takes precedence over WFLZW_PACKED_INDICES if both are defined.
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-typename WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::Index_t
-WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::DictionaryList::addIfNotExistent
-(const Index_t prefixIndex, const WFLZW::Byte byteValue)
+   A stored index can't represent the all-ones kEmptyIndex of 32-bit indices,
+   so it's stored as kStoredEmptyIndex, which must be a value that's never
+   otherwise stored.
+*/
+template<unsigned kIndexBits, std::uint32_t kStoredEmptyIndex>
+class WFLZW::BitPackedIndex
 {
-    if(prefixIndex == kEmptyIndex)
-        return static_cast<Index_t>(byteValue);
+ public:
+    BitPackedIndex(WFLZW::Byte* bytes, std::size_t bitOffset):
+        mBytes(bytes + bitOffset / 8), mShift(bitOffset % 8) {}
 
-    const Index_t listStartIndex = mListIndices[prefixIndex].first;
-    Index_t index = listStartIndex;
-    while(index != kEmptyIndex)
+    BitPackedIndex& operator=(std::uint32_t value)
     {
-        if(mBytes[index] == byteValue)
-            return index;
-        index = mListIndices[index].next;
+        const std::uint64_t storedValue = (value == ~0U ? kStoredEmptyIndex : value);
+        store((load() & ~(std::uint64_t(kMask) << mShift)) | (storedValue << mShift));
+        return *this;
     }
 
-    mBytes[mEntriesAmount] = byteValue;
-    mListIndices[mEntriesAmount].first = kEmptyIndex;
-    mListIndices[mEntriesAmount].next = listStartIndex;
-    mListIndices[prefixIndex].first = mEntriesAmount;
-    ++mEntriesAmount;
-
-    return kEmptyIndex;
-}
-
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::DictionaryTree::initialize
-(WFLZW::Byte maxInputByteValue)
-{
-    const unsigned maxIndex = static_cast<unsigned>(maxInputByteValue) + 1;
-    mEntriesAmount = maxIndex + 1;
-    for(unsigned i = 0; i < maxIndex; ++i)
-        mListIndices[i].first = kEmptyIndex;
-}
+    // Copies the stored index, not the location, like assigning an index would.
+    BitPackedIndex& operator=(const BitPackedIndex& rhs)
+    { return *this = static_cast<std::uint32_t>(rhs); }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-typename WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::Index_t
-WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::DictionaryTree::addIfNotExistent
-(const Index_t prefixIndex, const WFLZW::Byte byteValue)
-{
-    if(prefixIndex == kEmptyIndex)
-        return static_cast<Index_t>(byteValue);
+    BitPackedIndex(const BitPackedIndex&) = default;
 
-    Index_t index = mListIndices[prefixIndex].first, prevIndex = kEmptyIndex;
-    bool goRight;
-    WFLZW::Byte dirBitMask = byteValue;
-    while(index != kEmptyIndex)
+    operator std::uint32_t() const
     {
-        if(mBytes[index] == byteValue)
-            return index;
-        prevIndex = index;
-        goRight = (dirBitMask & 1);
-        dirBitMask >>= 1;
-        index = (goRight ? mListIndices[index].right : mListIndices[index].left);
+        const std::uint32_t value = static_cast<std::uint32_t>(load() >> mShift) & kMask;
+        return (value == kStoredEmptyIndex ? ~0U : value);
     }
 
-    mBytes[mEntriesAmount] = byteValue;
-    mListIndices[mEntriesAmount].first = kEmptyIndex;
-    mListIndices[mEntriesAmount].left = kEmptyIndex;
-    mListIndices[mEntriesAmount].right = kEmptyIndex;
+ private:
+    static_assert(kIndexBits >= 1 && kIndexBits <= 32, "Invalid WFLZW::BitPackedIndex size");
 
-    if(prevIndex == kEmptyIndex)
-        mListIndices[prefixIndex].first = mEntriesAmount;
-    else if(goRight)
-        mListIndices[prevIndex].right = mEntriesAmount;
-    else
-        mListIndices[prevIndex].left = mEntriesAmount;
+    static const std::uint32_t kMask = ~0U >> (32 - kIndexBits);
 
-    ++mEntriesAmount;
-    return kEmptyIndex;
-}
+    WFLZW::Byte* mBytes;
+    unsigned mShift;
+
+    // The bits are in little-endian order, so that the fields don't depend on
+    // the byte order of the 64-bit accesses.
+    std::uint64_t load() const
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, mBytes, sizeof(bits));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        bits = __builtin_bswap64(bits);
+#endif
+        return bits;
+    }
 
+    void store(std::uint64_t bits)
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        bits = __builtin_bswap64(bits);
+#endif
+        std::memcpy(mBytes, &bits, sizeof(bits));
+    }
+};
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::Encoder
-(WFLZW::Byte maxInputByteValue)
+template<typename Record_t, unsigned kRecordBits, unsigned kRecordsAmount>
+class WFLZW::BitPackedArray
 {
-    initialize(maxInputByteValue);
-}
+ public:
+    Record_t operator[](std::size_t index)
+    { return Record_t(mBytes, index * kRecordBits); }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::initialize
-(WFLZW::Byte maxInputByteValue)
-{
-    assert(static_cast<unsigned>(maxInputByteValue) + 2 < kDictionaryMaxSize);
-    mMaxInputByteValue = maxInputByteValue;
-    mOutputBufferIndex = 0;
-    mOutputBufferBitOffset = 0;
-    reset();
-}
+    const Record_t operator[](std::size_t index) const
+    { return Record_t(const_cast<WFLZW::Byte*>(mBytes), index * kRecordBits); }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::reset()
-{
-    mIndex = Dictionary::kEmptyIndex;
-    mDictionary.initialize(mMaxInputByteValue);
-    mDictionaryHasBeenReset = true;
+ private:
+    // The 64-bit accesses of the last record may extend up to 7 bytes past it.
+    WFLZW::Byte mBytes[(std::uint64_t(kRecordsAmount) * kRecordBits + 7) / 8 + 7];
+};
 
-    unsigned dictSize = mDictionary.size();
-    mBitSize = 1;
-    while((dictSize >>= 1)) ++mBitSize;
-    mMaxOutputValueForCurrentBitSize = (1U << mBitSize);
-}
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-WFLZW::EncodeStatus WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeByte
-(WFLZW::Byte byte)
+//============================================================================
+// Code entropy coding
+//============================================================================
+/* An optional second stage for the block format, which range codes the codes
+   of an LZW stream (created with the default maximum byte value and without
+   flushing) instead of writing them with a fixed number of bits. A code for
+   a single byte is coded with an adaptive model of the byte value. Any other
+   code is coded as its distance from the newest dictionary entry, because
+   recently added strings are the most likely ones to be used: the bit length
+   of the distance with an adaptive model, and the rest of the bits as such.
+*/
+namespace WFLZW
 {
-    if(byte > mMaxInputByteValue) return WFLZW::EncodeStatus::inputByteTooLarge;
+    class RangeEncoder
+    {
+     public:
+        RangeEncoder(WFLZW::Byte* output, std::size_t outputCapacity);
 
-    const Index_t existingIndex = mDictionary.addIfNotExistent(mIndex, byte);
-    mDictionaryHasBeenReset = false;
+        // total must be at most 65536, and bitsAmount at most 16.
+        void encode(unsigned cumulativeFrequency, unsigned frequency, unsigned total);
+        void encodeBits(unsigned value, unsigned bitsAmount);
+
+        // Returns the size of the output, or 0 if it didn't fit.
+        std::size_t finish();
+
+     private:
+        std::uint64_t mLow;
+        std::uint32_t mRange;
+        WFLZW::Byte* mOutput;
+        std::size_t mOutputCapacity, mOutputAmount, mPendingFFBytesAmount;
+        WFLZW::Byte mCache;
+        bool mHasCache;
+
+        void normalize();
+        void shiftLow();
+        void outputByte(WFLZW::Byte);
+    };
+
+    class RangeDecoder
+    {
+     public:
+        RangeDecoder(const WFLZW::Byte* input, std::size_t amount);
+
+        unsigned decodeFrequency(unsigned total);
+        void consume(unsigned cumulativeFrequency, unsigned frequency);
+        unsigned decodeBits(unsigned bitsAmount);
+
+        // Whether the decoder has read past the end of the input.
+        bool inputOverrun() const { return mInputIndex > mInputAmount + 4; }
+
+     private:
+        std::uint32_t mCode, mRange, mStep;
+        const WFLZW::Byte* mInput;
+        std::size_t mInputAmount, mInputIndex;
+
+        void normalize();
+        WFLZW::Byte inputByte()
+        { return (mInputIndex < mInputAmount ? mInput[mInputIndex++] : (++mInputIndex, 0)); }
+    };
+
+    template<unsigned kSymbolsAmount, unsigned kMaxTotal>
+    struct AdaptiveFrequencies
+    {
+        static const unsigned kIncrement = 32;
+
+        std::uint16_t frequencies[kSymbolsAmount];
+        unsigned total;
+
+        void initialize();
+        void encode(WFLZW::RangeEncoder&, unsigned symbol);
+        unsigned decode(WFLZW::RangeDecoder&);
+        void update(unsigned symbol);
+    };
+
+    // The models, and the dictionary size of the LZW stream being coded.
+    template<unsigned kDictionaryMaxSize>
+    class CodeEntropyModel
+    {
+     protected:
+        static const unsigned kMaxByteValue =
+            (kDictionaryMaxSize <= 257U ? kDictionaryMaxSize - 3 : 255U);
+        static const unsigned kEndIndex = kMaxByteValue + 1;
+        static const unsigned kFirstEntryIndex = kMaxByteValue + 2;
+        static const unsigned kMaxBitSize = WFLZW::bitSizeOf(kDictionaryMaxSize - 1);
+        // 0 for single bytes, else 1 + the bit length of the distance.
+        static const unsigned kCategoriesAmount = kMaxBitSize + 2;
+
+        WFLZW::AdaptiveFrequencies<kCategoriesAmount, (1U << 13)> mCategories;
+        WFLZW::AdaptiveFrequencies<16, (1U << 15)> mHighNibbles, mLowNibbles[16];
+        unsigned mEntriesAmount, mBitSize;
+        bool mHasPreviousCode;
+
+        void initialize();
+        void reset();
+        void advance();
+    };
+}
+
+template<unsigned kDictionaryMaxSize>
+class WFLZW::CodeEntropyEncoder: private WFLZW::CodeEntropyModel<kDictionaryMaxSize>
+{
+ public:
+    /* Returns the size of the output, or 0 if it didn't fit in outputCapacity
+       bytes or the input is not a complete LZW stream.
+    */
+    std::size_t encode(const WFLZW::Byte* lzwStream, std::size_t amount,
+                       WFLZW::Byte* output, std::size_t outputCapacity);
+};
+
+template<unsigned kDictionaryMaxSize>
+class WFLZW::CodeEntropyDecoder: private WFLZW::CodeEntropyModel<kDictionaryMaxSize>
+{
+ public:
+    /* Calls decodeIndex(code) for each code, until it returns something other
+       than DecodeStatus::inputContinues, and returns that.
+    */
+    template<typename DecodeIndex_t>
+    WFLZW::DecodeStatus decode(const WFLZW::Byte* input, std::size_t amount,
+                               DecodeIndex_t&& decodeIndex);
+};
+
+
+//============================================================================
+// Block encoder
+//============================================================================
+/* Block format: The input is split into blocks of at most kBlockSize bytes.
+   Each block starts with a 9-byte header: one byte for the block type,
+   followed by the uncompressed size and the payload size of the block, both
+   as 32-bit little-endian values. The payload of an LZW block is an
+   independent stream created by WFLZW::Encoder (using the default maximum
+   byte value), the payload of a stored block is the raw input bytes.
+   The payload of a filtered LZW block starts with the filter type and the
+   element size (one byte each), followed by the LZW stream of the filtered
+   input (see applyFilter()). A lone block type byte of zero marks the end of
+   the stream.
+
+   setFilter() takes effect from the next block that has no input yet. With a
+   filter the block is compressed only once it's complete, and blocks that
+   are stored anyway are stored unfiltered.
+
+   With setEntropyCoding(true) the LZW stream of each block is additionally
+   run through WFLZW::CodeEntropyEncoder, and the result is used if it's
+   smaller. The entropy-coded block types have the same payload as the plain
+   ones, except that the LZW stream is replaced by the entropy-coded one.
+*/
+template<unsigned kDictionaryMaxSize,
+         WFLZW::DictionaryType kDictionaryType = WFLZW::DictionaryType::tree,
+         unsigned kBlockSize = 65536>
+class WFLZW::BlockEncoder
+{
+    static_assert(kBlockSize >= 256,
+                  "WFLZW::BlockEncoder kBlockSize template parameter is too small");
+
+ public:
+    BlockEncoder();
+
+    void initialize();
+
+    void setFilter(WFLZW::Filter, unsigned elementSize = 1);
+    void setEntropyCoding(bool enable) { mEntropyCoding = enable; }
+
+    void encodeBytes(const WFLZW::Byte*, const std::size_t amount);
+    void encodeByte(WFLZW::Byte);
+    void finalizeEncoding();
+
+    virtual void outputEncodedBytes(const WFLZW::Byte*, unsigned) {}
+
+
+ private:
+    class LZWEncoder: public WFLZW::Encoder<kDictionaryMaxSize, kDictionaryType>
+    {
+     public:
+        BlockEncoder* mOwner;
+
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            mOwner->addCompressedBytes(bytes, amount);
+        }
+    };
+
+    static const unsigned kProbeInterval = kBlockSize / 8;
+    static const unsigned kFilterDescriptorSize = 2;
+
+    LZWEncoder mEncoder;
+    WFLZW::Byte mInputBuffer[kBlockSize];
+    WFLZW::Byte mCompressedBuffer[kBlockSize];
+    WFLZW::Byte mFilterBuffer[kBlockSize];
+    unsigned mInputAmount, mCompressedAmount;
+    bool mStoreBlock, mEntropyCoding;
+    WFLZW::Filter mFilter, mNextFilter;
+    unsigned mFilterElementSize, mNextFilterElementSize;
+
+    bool encodeInputBufferBytes(const WFLZW::Byte* buffer, unsigned startIndex, unsigned amount);
+    void addCompressedBytes(const WFLZW::Byte*, unsigned);
+    void outputBlock();
+    void outputBlockHeader(WFLZW::BlockType blockType, unsigned rawSize, unsigned payloadSize);
+};
+
+
+//============================================================================
+// Block decoder
+//============================================================================
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize = 65536>
+class WFLZW::BlockDecoder
+{
+ public:
+    BlockDecoder();
+
+    void initialize();
+
+    WFLZW::DecodeStatus decodeBytes(const WFLZW::Byte*, const std::size_t amount);
+    WFLZW::DecodeStatus decodeByte(WFLZW::Byte);
+
+    virtual void outputDecodedBytes(WFLZW::Byte*, unsigned) {}
+
+
+ private:
+    class LZWDecoder: public WFLZW::Decoder<kDictionaryMaxSize>
+    {
+     public:
+        BlockDecoder* mOwner;
+
+        virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
+        {
+            if(mOwner->isFilteredBlock())
+                mOwner->addFilteredBytes(bytes, amount);
+            else
+            {
+                mOwner->mBlockOutputAmount += amount;
+                mOwner->outputDecodedBytes(bytes, amount);
+            }
+        }
+
+        WFLZW::DecodeStatus decodeCode(unsigned code)
+        {
+            return this->decodeIndex
+                (static_cast<typename WFLZW::Decoder<kDictionaryMaxSize>::Index_t>(code));
+        }
+    };
+
+    static const unsigned kHeaderSize = 9;
+    static const unsigned kFilterDescriptorSize = 2;
+
+    LZWDecoder mDecoder;
+    WFLZW::Byte mBlockBuffer[kBlockSize];
+    WFLZW::Byte mFilterBuffer[kBlockSize];
+    WFLZW::Byte mHeader[kHeaderSize];
+    WFLZW::Byte mFilterDescriptor[kFilterDescriptorSize];
+    unsigned mHeaderAmount, mRawSize, mPayloadSize, mPayloadAmount, mBlockOutputAmount;
+    WFLZW::BlockType mBlockType;
+    WFLZW::DecodeStatus mStatus, mLZWStatus;
+
+    bool isFilteredBlock() const
+    { return (mBlockType == WFLZW::BlockType::filteredLZW ||
+              mBlockType == WFLZW::BlockType::filteredEntropyLZW); }
+    bool isEntropyCodedBlock() const
+    { return (mBlockType == WFLZW::BlockType::entropyLZW ||
+              mBlockType == WFLZW::BlockType::filteredEntropyLZW); }
+    unsigned filterDescriptorSize() const
+    { return (isFilteredBlock() ? kFilterDescriptorSize : 0); }
+
+    void addFilteredBytes(const WFLZW::Byte*, unsigned amount);
+    WFLZW::DecodeStatus decodeEntropyCodedPayload();
+
+    WFLZW::DecodeStatus startBlock();
+    WFLZW::DecodeStatus decodePayloadBytes(const WFLZW::Byte*, unsigned amount);
+    WFLZW::DecodeStatus endBlock();
+};
+
+
+//============================================================================
+// Batch encoder
+//============================================================================
+/* Compresses each input as an independent stream (with the default maximum
+   byte value). The streams are appended to the output one after another, and
+   stream i occupies the bytes from offsets[i] up to offsets[i+1].
+
+   With kDictionaryMaxSize 257 or less the default maximum byte value is less
+   than 255. If an input contains a larger byte, WFLZW::EncodeStatus::
+   inputByteTooLarge is returned, and offsets and output end where that
+   input would have started, so its index is offsets.size()-1.
+*/
+template<unsigned kDictionaryMaxSize,
+         WFLZW::DictionaryType kDictionaryType = WFLZW::DictionaryType::tree>
+class WFLZW::BatchEncoder
+{
+ public:
+    WFLZW::EncodeStatus encodeBatch(const WFLZW::ByteSpan* inputs, std::size_t inputsAmount,
+                                    std::vector<WFLZW::Byte>& output,
+                                    std::vector<std::size_t>& offsets);
+
+#ifdef WFLZW_USE_THREADS
+    static WFLZW::EncodeStatus encodeBatchInParallel
+    (const WFLZW::ByteSpan* inputs, std::size_t inputsAmount,
+     std::vector<WFLZW::Byte>& output, std::vector<std::size_t>& offsets,
+     unsigned threadsAmount);
+#endif
+
+
+ private:
+    class ArenaEncoder: public WFLZW::Encoder<kDictionaryMaxSize, kDictionaryType, 1024>
+    {
+     public:
+        std::vector<WFLZW::Byte>* mOutput;
+
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            mOutput->insert(mOutput->end(), bytes, bytes + amount);
+        }
+    };
+
+    ArenaEncoder mEncoder;
+};
+
+
+//============================================================================
+// Batch decoder
+//============================================================================
+template<unsigned kDictionaryMaxSize>
+class WFLZW::BatchDecoder
+{
+ public:
+    WFLZW::DecodeStatus decodeBatch(const WFLZW::ByteSpan* inputs, std::size_t inputsAmount,
+                                    std::vector<WFLZW::Byte>& output,
+                                    std::vector<std::size_t>& offsets);
+
+    WFLZW::DecodeStatus decodeBatch(const WFLZW::Byte* input, const std::size_t* inputOffsets,
+                                    std::size_t inputsAmount,
+                                    std::vector<WFLZW::Byte>& output,
+                                    std::vector<std::size_t>& offsets);
+
+#ifdef WFLZW_USE_THREADS
+    static WFLZW::DecodeStatus decodeBatchInParallel
+    (const WFLZW::ByteSpan* inputs, std::size_t inputsAmount,
+     std::vector<WFLZW::Byte>& output, std::vector<std::size_t>& offsets,
+     unsigned threadsAmount);
+#endif
+
+
+ private:
+    class ArenaDecoder: public WFLZW::Decoder<kDictionaryMaxSize>
+    {
+     public:
+        std::vector<WFLZW::Byte>* mOutput;
+
+        virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
+        {
+            mOutput->insert(mOutput->end(), bytes, bytes + amount);
+        }
+    };
+
+    ArenaDecoder mDecoder;
+
+    WFLZW::DecodeStatus decodeStream(const WFLZW::Byte*, std::size_t,
+                                     std::vector<WFLZW::Byte>&, std::vector<std::size_t>&);
+};
+
+
+//============================================================================
+// Decoder stream
+//============================================================================
+/* A pull-based decoder: the caller gives it input with setInput() and asks
+   for decoded bytes with decode(), which stops when either the input runs out
+   or the output space is full, even in the middle of a decoded string.
+*/
+template<unsigned kDictionaryMaxSize>
+class WFLZW::DecoderStream: private WFLZW::Decoder<kDictionaryMaxSize>
+{
+    using Base = WFLZW::Decoder<kDictionaryMaxSize>;
+
+    static const WFLZW::Byte kMaxInputByteValueDefault =
+        (kDictionaryMaxSize <= 257U ? WFLZW::Byte(kDictionaryMaxSize - 3) : WFLZW::Byte(255U));
+
+ public:
+    DecoderStream(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault,
+                  bool enableFlush = false);
+
+    void initialize(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault,
+                    bool enableFlush = false);
+
+    using Base::maxByteValue;
+
+    void setInput(const WFLZW::Byte*, std::size_t amount);
+    std::size_t remainingInputAmount() const { return mInputEnd - mInput; }
+
+    WFLZW::StreamStatus decode(WFLZW::Byte* output, std::size_t outputCapacity,
+                               std::size_t& outputAmount);
+
+
+ private:
+    const WFLZW::Byte *mInput, *mInputEnd;
+    const WFLZW::Byte *mPendingBytes, *mPendingBytesEnd;
+    WFLZW::StreamStatus mEndStatus;
+
+    virtual void outputDecodedBytes(WFLZW::Byte*, unsigned);
+};
+
+
+//============================================================================
+// Lookahead encoder
+//============================================================================
+/* An encoder whose output WFLZW::Decoder decodes as usual, but which parses
+   the input with one code of lookahead instead of greedily, as in the
+   flexible parsing of LZW-FP: of the kMaxCandidates longest strings in the
+   dictionary that match the input, it chooses the one that gives the longest
+   total length together with the longest match following it. Because the
+   decoder adds an entry for every code, a string shorter than the longest
+   match adds a duplicate entry, which wastes a code, so a shorter string is
+   chosen only if the total length is more than setMinLengthGain() bytes
+   longer (3 by default; less tends to make the output larger with big
+   dictionaries). With 65536 entries this makes text about 4-6% and binaries
+   0.5% smaller, but encoding is 5-6 times slower.
+
+   The input is collected into a window of kWindowSize bytes, and strings are
+   chosen while at least kLookaheadSize bytes of it remain (or all of it when
+   flushing or finalizing), so that matches are never cut short by the window
+   in practice. Checkpoints aren't supported.
+*/
+template<unsigned kDictionaryMaxSize,
+         WFLZW::DictionaryType kDictionaryType = WFLZW::DictionaryType::tree,
+         unsigned kOutputBufferSize = 256>
+class WFLZW::LookaheadEncoder:
+    private WFLZW::Encoder<kDictionaryMaxSize, kDictionaryType, kOutputBufferSize>
+{
+    using Base = WFLZW::Encoder<kDictionaryMaxSize, kDictionaryType, kOutputBufferSize>;
+
+    static const WFLZW::Byte kMaxInputByteValueDefault =
+        (kDictionaryMaxSize <= 257U ? WFLZW::Byte(kDictionaryMaxSize - 3) : WFLZW::Byte(255U));
+
+ public:
+    LookaheadEncoder(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault,
+                     bool enableFlush = false);
+
+    void initialize(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault,
+                    bool enableFlush = false);
+
+    using Base::maxByteValue;
+
+    WFLZW::EncodeStatus encodeBytes(const WFLZW::Byte*, const std::size_t amount);
+    WFLZW::EncodeStatus encodeBytes(const WFLZW::Byte*, const std::size_t amount,
+                                    const WFLZW::ByteRemapper&);
+    WFLZW::EncodeStatus encodeByte(WFLZW::Byte);
+    WFLZW::EncodeStatus encodeByte(WFLZW::Byte, const WFLZW::ByteRemapper&);
+    void flush();
+    void finalizeMessage();
+    void finalizeEncoding();
+
+    void setMinLengthGain(unsigned bytes) { mMinLengthGain = bytes; }
+
+    using Base::outputEncodedBytes;
+    using Base::outputResetPoint;
+
+#ifdef WFLZW_COLLECT_STATS
+    using Base::stats;
+    using Base::resetStats;
+#endif
+
+
+ private:
+    using Index_t = typename Base::Index_t;
+
+    static const unsigned kWindowSize = 8192, kLookaheadSize = 1024;
+    static const unsigned kMaxCandidates = 16;
+
+    WFLZW::Byte mWindow[kWindowSize];
+    unsigned mWindowSize, mMinLengthGain;
+
+    WFLZW::EncodeStatus addToWindow(const WFLZW::Byte*, const std::size_t, const WFLZW::Byte*);
+    void encodeWindow(bool toEnd);
+    unsigned matchLength(unsigned position, unsigned end) const;
+};
+
+
+//============================================================================
+// Classic LZW formats
+//============================================================================
+/* Encoding and decoding the LZW code streams of Unix compress (.Z files),
+   GIF and TIFF, for reading and writing those formats with the same
+   dictionary as WFLZW::Encoder. The layout is given by a WFLZW::ClassicFormat
+   (see unixCompressFormat(), gifFormat() and tiffFormat()), and kMaxBitSize
+   is the largest maxBitSize it can have: 16 for .Z files, 12 for GIF and
+   TIFF. Only the LZW data is handled: a GIF encoder writes the minimum code
+   size byte and splits the output into sub-blocks, and TIFF strips are
+   encoded one stream each.
+
+   The code width starts at minBitSize and grows by one bit when the next
+   free code doesn't fit, or with earlyChange (TIFF) one code earlier. When
+   the dictionary becomes full the encoder outputs the clear code, if the
+   format has one, and starts over; otherwise it keeps using the full
+   dictionary. (Unix compress instead clears when the compression ratio
+   drops, so the output isn't byte for byte the same as from compress for
+   inputs larger than the dictionary, but any decoder reads it.) With
+   codeGroups, after the clear code and each change of the code width the
+   output skips to the end of the current group of 8 codes, as in compress.
+
+   The decoder stops at the end code; a .Z file has none, so the status stays
+   inputContinues until the end of the input. It accepts a clear code
+   at any point, and a full dictionary without one (as GIF allows).
+*/
+template<unsigned kMaxBitSize = 16>
+class WFLZW::ClassicEncoder
+{
+    static_assert(kMaxBitSize >= 3 && kMaxBitSize <= 16,
+                  "WFLZW::ClassicEncoder kMaxBitSize template parameter is out of range");
+
+ public:
+    explicit ClassicEncoder(const WFLZW::ClassicFormat& = WFLZW::unixCompressFormat(kMaxBitSize));
+
+    void initialize(const WFLZW::ClassicFormat& = WFLZW::unixCompressFormat(kMaxBitSize));
+
+    WFLZW::EncodeStatus encodeBytes(const WFLZW::Byte*, const std::size_t amount);
+    WFLZW::EncodeStatus encodeByte(WFLZW::Byte);
+    void finalizeEncoding();
+
+    virtual void outputEncodedBytes(const WFLZW::Byte*, unsigned) {}
+
+
+ private:
+    using Dictionary = typename
+        WFLZW::Encoder<(1U << kMaxBitSize)>::DictionaryTree;
+    using Index_t = typename WFLZW::Encoder<(1U << kMaxBitSize)>::Index_t;
+
+    Dictionary mDictionary;
+    WFLZW::Byte mOutputBuffer[256];
+    std::uint64_t mOutputBits;
+    unsigned mOutputBitsAmount, mOutputBufferIndex, mBitSize;
+    unsigned mMaxEntriesAmount, mCodesInGroup;
+    Index_t mIndex;
+    WFLZW::ClassicFormat mFormat;
+
+    void reset();
+    void outputCode(unsigned);
+    void outputByte(WFLZW::Byte);
+    void skipToGroupEnd();
+    void updateBitSize(unsigned entriesAmount);
+};
+
+template<unsigned kMaxBitSize = 16>
+class WFLZW::ClassicDecoder
+{
+    static_assert(kMaxBitSize >= 3 && kMaxBitSize <= 16,
+                  "WFLZW::ClassicDecoder kMaxBitSize template parameter is out of range");
+
+ public:
+    explicit ClassicDecoder(const WFLZW::ClassicFormat& = WFLZW::unixCompressFormat(kMaxBitSize));
+
+    void initialize(const WFLZW::ClassicFormat& = WFLZW::unixCompressFormat(kMaxBitSize));
+
+    WFLZW::DecodeStatus decodeBytes(const WFLZW::Byte*, std::size_t amount);
+
+    virtual void outputDecodedBytes(WFLZW::Byte*, unsigned) {}
+
+
+ private:
+    static const unsigned kDictionaryMaxSize = 1U << kMaxBitSize;
+    static const unsigned kNoCode = ~0U;
+
+    std::uint16_t mPrefixIndices[kDictionaryMaxSize];
+    WFLZW::Byte mBytes[kDictionaryMaxSize];
+    WFLZW::Byte mDecodeBuffer[kDictionaryMaxSize];
+    std::uint64_t mInputBits;
+    unsigned mInputBitsAmount, mSkipBitsAmount, mBitSize, mEntriesAmount;
+    unsigned mCodesInGroup, mPrevCode, mHeaderBytesAmount;
+    WFLZW::Byte mHeader[3];
+    WFLZW::DecodeStatus mStatus;
+    WFLZW::ClassicFormat mFormat;
+
+    unsigned firstEntryIndex() const
+    { return mFormat.rootsAmount + mFormat.hasClearCode + mFormat.hasEndCode; }
+    void reset();
+    bool readHeader();
+    void skipToGroupEnd();
+    bool decodeCode(unsigned);
+    WFLZW::Byte* getString(unsigned code, WFLZW::Byte* end) const;
+};
+
+
+//============================================================================
+// Pattern searcher
+//============================================================================
+/* Finds the occurrences of a byte string in a stream of WFLZW::Encoder
+   without decompressing it. The searcher builds the same dictionary as
+   WFLZW::Decoder, but instead of extracting the string of each code it keeps
+   for every entry the state of a KMP automaton for the pattern after the
+   string (which takes one step from the state of the prefix when the entry
+   is added), the string length, its longest prefix that ends with an
+   occurrence, and its prefix of at most the pattern length.
+
+   A code whose string starts with no partial match pending thus takes
+   constant time, plus the time to report the occurrences in it. Otherwise
+   the first bytes of the string are matched one at a time until the state
+   is the same as if the string had been matched on its own, which happens
+   within the pattern length.
+
+   outputMatch() gets the offset of each occurrence in the decompressed data,
+   in increasing order. Occurrences can overlap, and they don't span the end
+   of a message of a session. The searcher takes about 16 bytes per
+   dictionary entry (24 with dictionaries of more than 65536 entries).
+*/
+template<unsigned kDictionaryMaxSize>
+class WFLZW::PatternSearcher
+{
+    static_assert(kDictionaryMaxSize > 1,
+                  "WFLZW::PatternSearcher kDictionaryMaxSize template parameter is too small");
+    static_assert(kDictionaryMaxSize <= 0x80000000U,
+                  "WFLZW::PatternSearcher kDictionaryMaxSize template parameter is too large");
+
+    static const WFLZW::Byte kMaxInputByteValueDefault =
+        (kDictionaryMaxSize <= 257U ? WFLZW::Byte(kDictionaryMaxSize - 3) : WFLZW::Byte(255U));
+
+ public:
+    // The pattern is at least one byte and less than 16 MB long.
+    PatternSearcher(const WFLZW::Byte* pattern, std::size_t patternLength,
+                    WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault,
+                    bool enableFlush = false);
+
+    void initialize(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault,
+                    bool enableFlush = false);
+
+    // Starts a new stream like initialize() with the current settings.
+    void setPattern(const WFLZW::Byte* pattern, std::size_t patternLength);
+
+    WFLZW::DecodeStatus searchBytes(const WFLZW::Byte*, const std::size_t amount);
+
+    std::uint64_t matchesAmount() const { return mMatchesAmount; }
+    std::uint64_t decompressedSize() const { return mOutputOffset; }
+
+    virtual void outputMatch(std::uint64_t) {}
+
+
+ private:
+    using Index_t = typename
+        std::conditional<(kDictionaryMaxSize <= 0x10000U), std::uint16_t, std::uint32_t>::type;
+
+    static const Index_t kEmptyIndex = Index_t(~Index_t());
+    static const unsigned kMinBitSize = 2;
+    static const unsigned kMaxBitSize = WFLZW::bitSizeOf(kDictionaryMaxSize - 1);
+
+    using InputBuffer_t = typename
+        std::conditional<(kMaxBitSize + 7 <= 32), std::uint32_t, std::uint64_t>::type;
+
+    // The fields used for each code are together, unlike in WFLZW::Decoder.
+    struct Entry
+    {
+        Index_t prefixIndex, headIndex, matchIndex;
+        WFLZW::Byte byte, firstByte;
+        std::uint32_t length, state;
+    };
+
+    Entry mEntries[kDictionaryMaxSize];
+    std::vector<std::uint32_t> mTransitions;
+    std::vector<WFLZW::Byte> mHeadBuffer;
+    std::vector<std::uint32_t> mMatchLengths;
+    std::uint64_t mOutputOffset, mMatchesAmount;
+    std::uint32_t mPatternLength, mState;
+    unsigned mEntriesAmount, mFirstEntryIndex, mSyncIndex;
+    unsigned mBitSize, mBitOffset;
+    Index_t mOldIndex;
+    Index_t mMaxInputValueForCurrentBitSize;
+    InputBuffer_t mInputBuffer;
+    WFLZW::Byte mMaxInputByteValue;
+
+    void createAutomaton(const WFLZW::Byte* pattern, std::size_t patternLength);
+    void reset();
+    WFLZW::DecodeStatus searchIndex(Index_t);
+    void searchString(Index_t);
+    void addToDictionary(Index_t, WFLZW::Byte);
+};
+
+
+//============================================================================
+// Verifying encoder
+//============================================================================
+/* An encoder that checks its output as it goes: every code is also given as
+   is (without packing it into bits and reading it back) to a shadow decoder,
+   which builds the dictionary like WFLZW::Decoder does, and compares the
+   string of each code with the input instead of extracting it. The input is
+   encoded kChunkSize bytes at a time, each chunk followed by decoding its
+   codes, so that the input of a chunk is still in the cache when it's
+   compared. This checks the dictionary handling of both sides, but not the
+   bit packing.
+
+   When a string doesn't match the input, or the input wasn't all decoded at
+   a flush or at the end of a message, the functions return
+   WFLZW::EncodeStatus::verificationFailed, and keep returning it without
+   encoding anything until initialize() is called. Checkpoints aren't
+   supported.
+*/
+template<unsigned kDictionaryMaxSize,
+         WFLZW::DictionaryType kDictionaryType = WFLZW::DictionaryType::tree,
+         unsigned kOutputBufferSize = 256>
+class WFLZW::VerifyingEncoder:
+    private WFLZW::Encoder<kDictionaryMaxSize, kDictionaryType, kOutputBufferSize, WFLZW::Byte, true>
+{
+    using Base = WFLZW::Encoder<kDictionaryMaxSize, kDictionaryType, kOutputBufferSize, WFLZW::Byte, true>;
+
+    static const WFLZW::Byte kMaxInputByteValueDefault =
+        (kDictionaryMaxSize <= 257U ? WFLZW::Byte(kDictionaryMaxSize - 3) : WFLZW::Byte(255U));
+
+ public:
+    VerifyingEncoder(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault,
+                     bool enableFlush = false);
+
+    void initialize(WFLZW::Byte maxInputByteValue = kMaxInputByteValueDefault,
+                    bool enableFlush = false);
+
+    using Base::maxByteValue;
+
+    WFLZW::EncodeStatus encodeBytes(const WFLZW::Byte*, const std::size_t amount);
+    WFLZW::EncodeStatus encodeBytes(const WFLZW::Byte*, const std::size_t amount,
+                                    const WFLZW::ByteRemapper&);
+    WFLZW::EncodeStatus encodeByte(WFLZW::Byte);
+    WFLZW::EncodeStatus encodeByte(WFLZW::Byte, const WFLZW::ByteRemapper&);
+    WFLZW::EncodeStatus flush();
+    WFLZW::EncodeStatus finalizeMessage();
+    WFLZW::EncodeStatus finalizeEncoding();
+
+    using Base::outputEncodedBytes;
+    using Base::outputResetPoint;
+
+#ifdef WFLZW_COLLECT_STATS
+    using Base::stats;
+    using Base::resetStats;
+#endif
+
+
+ protected:
+    using Index_t = typename Base::Index_t;
+
+    /* The codes output since the last verification. They are verified after
+       each chunk of input and when the finalizing functions are called, so
+       they can be inspected (or, for testing, altered) in outputEncodedBytes().
+    */
+    using Base::codeLog;
+
+
+ private:
+    static const unsigned kChunkSize = 16384;
+    static const std::uint32_t kEmptyIndex = ~std::uint32_t(0);
+
+    // The string of an entry is compared backwards from its last byte, so its length is stored.
+    struct ShadowEntry
+    {
+        std::uint32_t length;
+        Index_t prefixIndex;
+        WFLZW::Byte byte;
+    };
+
+    ShadowEntry mShadowEntries[kDictionaryMaxSize];
+    unsigned mShadowEntriesAmount, mFirstEntryIndex;
+    std::uint32_t mOldIndex;
+    WFLZW::Byte mOldFirstByte;
+    // The input that the codes output so far haven't covered yet.
+    std::vector<WFLZW::Byte> mInput;
+    bool mFailed;
+
+    void resetShadowDictionary();
+    WFLZW::EncodeStatus addInput(const WFLZW::Byte*, const std::size_t, const WFLZW::Byte*);
+    bool verifyCodes();
+    bool verifyCode(Index_t, const WFLZW::Byte*&, const WFLZW::Byte*);
+    WFLZW::EncodeStatus verifyAllInput();
+};
+
+
+//============================================================================
+// Large object allocation
+//============================================================================
+/* Encoders and decoders with dictionaries of 131072 entries or more take
+   megabytes of memory, which is accessed randomly, so with regular 4 kB pages
+   most accesses miss the TLB. If WFLZW_USE_HUGE_PAGES is defined (on a
+   system with mmap()), allocateLargeObjectMemory() allocates objects of at
+   least kLargeObjectMinSize bytes from 2 MB pages: explicit huge pages if any
+   have been reserved (/proc/sys/vm/nr_hugepages), else transparent huge pages
+   requested with madvise(). The memory is also touched right away, so that
+   it's placed in the NUMA node of the calling thread. Otherwise it's the same
+   as operator new.
+
+   makeLargeObject() is like std::make_unique() using that memory, and should
+   be called from the thread that will use the object.
+*/
+namespace WFLZW
+{
+    const std::size_t kHugePageSize = 2 * 1024 * 1024;
+    const std::size_t kLargeObjectMinSize = kHugePageSize / 2;
+}
+
+
+//============================================================================
+// Pre-filters
+//============================================================================
+/* Reversible transforms for arrays of fixed-size elements (such as integers
+   or pixels), which LZW by itself sees as nearly random bytes. The element
+   size is given in bytes.
+
+   - delta: Each byte is replaced by its difference to the byte elementSize
+     positions earlier (with elementSize 1 this is a plain byte delta). Good
+     for slowly changing samples and image rows.
+   - shuffle: The bytes are reordered so that the first bytes of all the
+     elements come first, then all the second bytes, and so on (like the
+     byte shuffle of Blosc). Good for integers and floats with mostly equal
+     high bytes. The remaining amount % elementSize bytes are copied as is.
+   - shuffleDelta: shuffle followed by a byte delta of the result. Good for
+     counters, timestamps and other increasing integers.
+
+   reverseFilter() restores the original data. The input and output must not
+   overlap. The loops are written so that compilers can vectorize them.
+*/
+
+
+//============================================================================
+// Implementations
+//============================================================================
+namespace WFLZW
+{
+    inline void writeUInt32LE(WFLZW::Byte* dest, std::uint32_t value)
+    {
+        dest[0] = static_cast<WFLZW::Byte>(value);
+        dest[1] = static_cast<WFLZW::Byte>(value >> 8);
+        dest[2] = static_cast<WFLZW::Byte>(value >> 16);
+        dest[3] = static_cast<WFLZW::Byte>(value >> 24);
+    }
+
+    inline std::uint32_t readUInt32LE(const WFLZW::Byte* src)
+    {
+        return (static_cast<std::uint32_t>(src[0]) |
+                (static_cast<std::uint32_t>(src[1]) << 8) |
+                (static_cast<std::uint32_t>(src[2]) << 16) |
+                (static_cast<std::uint32_t>(src[3]) << 24));
+    }
+
+    inline void writeUInt64LE(WFLZW::Byte* dest, std::uint64_t value)
+    {
+        WFLZW::writeUInt32LE(dest, static_cast<std::uint32_t>(value));
+        WFLZW::writeUInt32LE(dest + 4, static_cast<std::uint32_t>(value >> 32));
+    }
+
+    inline std::uint64_t readUInt64LE(const WFLZW::Byte* src)
+    {
+        return (WFLZW::readUInt32LE(src) |
+                (static_cast<std::uint64_t>(WFLZW::readUInt32LE(src + 4)) << 32));
+    }
+}
+
+inline void* WFLZW::allocateLargeObjectMemory(std::size_t size)
+{
+#ifdef WFLZW_USE_HUGE_PAGES
+    if(size >= WFLZW::kLargeObjectMinSize)
+    {
+        const std::size_t allocationSize =
+            (size + WFLZW::kHugePageSize - 1) / WFLZW::kHugePageSize * WFLZW::kHugePageSize;
+        const int kProtection = PROT_READ | PROT_WRITE;
+        const int kFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+        WFLZW::Byte* memory = static_cast<WFLZW::Byte*>(MAP_FAILED);
+
+#ifdef MAP_HUGETLB
+        memory = static_cast<WFLZW::Byte*>
+            (mmap(nullptr, allocationSize, kProtection, kFlags | MAP_HUGETLB, -1, 0));
+#endif
+        if(memory == MAP_FAILED)
+        {
+            // Transparent huge pages need 2 MB alignment, so the extra is unmapped.
+            WFLZW::Byte* const mapping = static_cast<WFLZW::Byte*>
+                (mmap(nullptr, allocationSize + WFLZW::kHugePageSize, kProtection, kFlags, -1, 0));
+            if(mapping == MAP_FAILED) throw std::bad_alloc();
+
+            const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(mapping);
+            const std::size_t headSize = (WFLZW::kHugePageSize - address % WFLZW::kHugePageSize) %
+                WFLZW::kHugePageSize;
+            memory = mapping + headSize;
+            if(headSize > 0) munmap(mapping, headSize);
+            munmap(memory + allocationSize, WFLZW::kHugePageSize - headSize);
+#ifdef MADV_HUGEPAGE
+            madvise(memory, allocationSize, MADV_HUGEPAGE);
+#endif
+        }
+
+        for(std::size_t i = 0; i < allocationSize; i += 4096)
+            memory[i] = 0;
+        return memory;
+    }
+#endif
+    return ::operator new(size);
+}
+
+inline void WFLZW::deallocateLargeObjectMemory(void* memory, std::size_t size)
+{
+#ifdef WFLZW_USE_HUGE_PAGES
+    if(size >= WFLZW::kLargeObjectMinSize)
+    {
+        munmap(memory, (size + WFLZW::kHugePageSize - 1) /
+               WFLZW::kHugePageSize * WFLZW::kHugePageSize);
+        return;
+    }
+#endif
+    (void)size;
+    ::operator delete(memory);
+}
+
+template<typename Object_t>
+void WFLZW::LargeObjectDeleter<Object_t>::operator()(Object_t* object) const
+{
+    object->~Object_t();
+    WFLZW::deallocateLargeObjectMemory(object, sizeof(Object_t));
+}
+
+template<typename Object_t, typename... Args_t>
+WFLZW::LargeObjectPtr<Object_t> WFLZW::makeLargeObject(Args_t&&... args)
+{
+    void* const memory = WFLZW::allocateLargeObjectMemory(sizeof(Object_t));
+    try
+    {
+        return WFLZW::LargeObjectPtr<Object_t>(new(memory) Object_t(std::forward<Args_t>(args)...));
+    }
+    catch(...)
+    {
+        WFLZW::deallocateLargeObjectMemory(memory, sizeof(Object_t));
+        throw;
+    }
+}
+
+namespace WFLZW
+{
+    template<unsigned kElementSize>
+    inline void shuffleBytes(const Byte* input, Byte* output, std::size_t elementsAmount,
+                             unsigned elementSize)
+    {
+        if(kElementSize) elementSize = kElementSize;
+        for(unsigned byteIndex = 0; byteIndex < elementSize; ++byteIndex)
+        {
+            Byte* plane = output + byteIndex * elementsAmount;
+            for(std::size_t i = 0; i < elementsAmount; ++i)
+                plane[i] = input[i * elementSize + byteIndex];
+        }
+    }
+
+    template<unsigned kElementSize>
+    inline void unshuffleBytes(const Byte* input, Byte* output, std::size_t elementsAmount,
+                               unsigned elementSize)
+    {
+        // With a constant element size writing whole elements at a time is faster.
+        if(kElementSize)
+            for(std::size_t i = 0; i < elementsAmount; ++i)
+                for(unsigned byteIndex = 0; byteIndex < kElementSize; ++byteIndex)
+                    output[i * kElementSize + byteIndex] = input[byteIndex * elementsAmount + i];
+        else
+            for(unsigned byteIndex = 0; byteIndex < elementSize; ++byteIndex)
+            {
+                const Byte* plane = input + byteIndex * elementsAmount;
+                for(std::size_t i = 0; i < elementsAmount; ++i)
+                    output[i * elementSize + byteIndex] = plane[i];
+            }
+    }
+
+    // Keeps the running sums in registers instead of reading them back from the output.
+    template<unsigned kElementSize>
+    inline void undeltaBytes(const Byte* input, Byte* output, std::size_t amount)
+    {
+        Byte sums[kElementSize] = {};
+        std::size_t i = 0;
+        for(; i + kElementSize <= amount; i += kElementSize)
+            for(unsigned byteIndex = 0; byteIndex < kElementSize; ++byteIndex)
+            {
+                sums[byteIndex] = static_cast<Byte>(sums[byteIndex] + input[i + byteIndex]);
+                output[i + byteIndex] = sums[byteIndex];
+            }
+        for(unsigned byteIndex = 0; byteIndex < kElementSize && i < amount; ++i, ++byteIndex)
+            output[i] = static_cast<Byte>(sums[byteIndex] + input[i]);
+    }
+
+    // The common element sizes get their own instances with a constant stride.
+    inline void shuffleOrUnshuffle(bool shuffle, unsigned elementSize, const Byte* input,
+                                   Byte* output, std::size_t amount)
+    {
+        const std::size_t elementsAmount = amount / elementSize;
+        const std::size_t shuffledAmount = elementsAmount * elementSize;
+        switch(shuffle ? elementSize : elementSize + 256)
+        {
+          case 1: case 256 + 1: std::memcpy(output, input, amount); return;
+          case 2: shuffleBytes<2>(input, output, elementsAmount, 2); break;
+          case 4: shuffleBytes<4>(input, output, elementsAmount, 4); break;
+          case 8: shuffleBytes<8>(input, output, elementsAmount, 8); break;
+          case 256 + 2: unshuffleBytes<2>(input, output, elementsAmount, 2); break;
+          case 256 + 4: unshuffleBytes<4>(input, output, elementsAmount, 4); break;
+          case 256 + 8: unshuffleBytes<8>(input, output, elementsAmount, 8); break;
+          default:
+              if(shuffle) shuffleBytes<0>(input, output, elementsAmount, elementSize);
+              else unshuffleBytes<0>(input, output, elementsAmount, elementSize);
+        }
+        std::memcpy(output + shuffledAmount, input + shuffledAmount, amount - shuffledAmount);
+    }
+}
+
+inline void WFLZW::applyFilter
+(WFLZW::Filter filter, unsigned elementSize, const WFLZW::Byte* input, WFLZW::Byte* output,
+ std::size_t amount)
+{
+    assert(elementSize > 0);
+    if(amount == 0) return;
+
+    switch(filter)
+    {
+      case WFLZW::Filter::none:
+          std::memcpy(output, input, amount);
+          break;
+
+      case WFLZW::Filter::delta:
+          std::memcpy(output, input, elementSize < amount ? elementSize : amount);
+          for(std::size_t i = elementSize; i < amount; ++i)
+              output[i] = static_cast<WFLZW::Byte>(input[i] - input[i - elementSize]);
+          break;
+
+      case WFLZW::Filter::shuffle:
+          WFLZW::shuffleOrUnshuffle(true, elementSize, input, output, amount);
+          break;
+
+      case WFLZW::Filter::shuffleDelta:
+          WFLZW::shuffleOrUnshuffle(true, elementSize, input, output, amount);
+          for(std::size_t i = amount; i > 1; --i)
+              output[i - 1] = static_cast<WFLZW::Byte>(output[i - 1] - output[i - 2]);
+          break;
+    }
+}
+
+inline void WFLZW::reverseFilter
+(WFLZW::Filter filter, unsigned elementSize, const WFLZW::Byte* input, WFLZW::Byte* output,
+ std::size_t amount)
+{
+    assert(elementSize > 0);
+    if(amount == 0) return;
+
+    switch(filter)
+    {
+      case WFLZW::Filter::none:
+          std::memcpy(output, input, amount);
+          break;
+
+      case WFLZW::Filter::delta:
+          switch(elementSize)
+          {
+            case 1: WFLZW::undeltaBytes<1>(input, output, amount); break;
+            case 2: WFLZW::undeltaBytes<2>(input, output, amount); break;
+            case 3: WFLZW::undeltaBytes<3>(input, output, amount); break;
+            case 4: WFLZW::undeltaBytes<4>(input, output, amount); break;
+            default:
+                std::memcpy(output, input, elementSize < amount ? elementSize : amount);
+                for(std::size_t i = elementSize; i < amount; ++i)
+                    output[i] = static_cast<WFLZW::Byte>(input[i] + output[i - elementSize]);
+          }
+          break;
+
+      case WFLZW::Filter::shuffle:
+          WFLZW::shuffleOrUnshuffle(false, elementSize, input, output, amount);
+          break;
+
+      case WFLZW::Filter::shuffleDelta:
+      {
+          // Undoes the delta while unshuffling, so that no third buffer is needed.
+          const std::size_t elementsAmount = amount / elementSize;
+          const std::size_t shuffledAmount = elementsAmount * elementSize;
+          WFLZW::Byte sum = 0;
+          for(unsigned byteIndex = 0; byteIndex < elementSize; ++byteIndex)
+          {
+              const WFLZW::Byte* plane = input + byteIndex * elementsAmount;
+              for(std::size_t i = 0; i < elementsAmount; ++i)
+              {
+                  sum = static_cast<WFLZW::Byte>(sum + plane[i]);
+                  output[i * elementSize + byteIndex] = sum;
+              }
+          }
+          for(std::size_t i = shuffledAmount; i < amount; ++i)
+          {
+              sum = static_cast<WFLZW::Byte>(sum + input[i]);
+              output[i] = sum;
+          }
+          break;
+      }
+    }
+}
+
+template<typename Symbol_t>
+void WFLZW::SymbolRemapper<Symbol_t>::createEncodeMapFromInputBytes
+(const Symbol_t* bytes, const std::size_t amount, WFLZW::RootOrder order)
+{
+    startEncodeMapCreation();
+    addInputBytesForEncodeMap(bytes, amount);
+    finalizeEncodeMapCreation(order);
+}
+
+template<typename Symbol_t>
+void WFLZW::SymbolRemapper<Symbol_t>::startEncodeMapCreation()
+{
+    std::memset(encodeMap, 0, sizeof(encodeMap));
+    std::memset(decodeMap, 0, sizeof(decodeMap));
+    decodeMapSize = 0;
+    std::memset(byteCounts, 0, sizeof(byteCounts));
+}
+
+template<typename Symbol_t>
+void WFLZW::SymbolRemapper<Symbol_t>::addInputByteForEncodeMap(Symbol_t byte)
+{
+    ++byteCounts[byte];
+}
+
+template<typename Symbol_t>
+void WFLZW::SymbolRemapper<Symbol_t>::addInputBytesForEncodeMap
+(const Symbol_t* bytes, const std::size_t amount)
+{
+    addInputBytesForEncodeMap(bytes, amount, std::integral_constant<bool, sizeof(Symbol_t) == 1>());
+}
+
+/* Counts into four separate tables, so that runs of the same byte don't make
+   each increment wait for the previous one.
+*/
+template<typename Symbol_t>
+void WFLZW::SymbolRemapper<Symbol_t>::addInputBytesForEncodeMap
+(const Symbol_t* bytes, const std::size_t amount, std::true_type)
+{
+    std::uint32_t counts[4][256];
+    std::size_t index = 0;
+
+    while(index < amount)
+    {
+        // Up to 2^32-1 bytes per round, so that no count can overflow.
+        const std::size_t roundEnd = index + std::min(amount - index, std::size_t(0xFFFFFFFCU));
+        std::memset(counts, 0, sizeof(counts));
+        for(; index + 4 <= roundEnd; index += 4)
+        {
+            ++counts[0][bytes[index]];
+            ++counts[1][bytes[index + 1]];
+            ++counts[2][bytes[index + 2]];
+            ++counts[3][bytes[index + 3]];
+        }
+        for(; index < roundEnd; ++index)
+            ++counts[0][bytes[index]];
+
+        for(unsigned i = 0; i < 256; ++i)
+            byteCounts[i] += std::uint64_t(counts[0][i]) + counts[1][i] + counts[2][i] + counts[3][i];
+    }
+}
+
+// With 16-bit symbols four tables would take 1 MB, and runs matter less.
+template<typename Symbol_t>
+void WFLZW::SymbolRemapper<Symbol_t>::addInputBytesForEncodeMap
+(const Symbol_t* bytes, const std::size_t amount, std::false_type)
+{
+    for(std::size_t index = 0; index < amount; ++index)
+        ++byteCounts[bytes[index]];
+}
+
+template<typename Symbol_t>
+void WFLZW::SymbolRemapper<Symbol_t>::finalizeEncodeMapCreation
+(WFLZW::RootOrder order, bool includeUnseenBytes)
+{
+    decodeMapSize = 0;
+    for(unsigned i = 0; i < kSymbolsAmount; ++i)
+        if(byteCounts[i] > 0 || includeUnseenBytes)
+            decodeMap[decodeMapSize++] = static_cast<Symbol_t>(i);
+
+    if(order == WFLZW::RootOrder::frequency)
+        std::stable_sort(decodeMap, decodeMap + decodeMapSize,
+                         [this](Symbol_t byte1, Symbol_t byte2)
+                         { return byteCounts[byte1] > byteCounts[byte2]; });
+
+    std::memset(encodeMap, 255, sizeof(encodeMap));
+    for(unsigned i = 0; i < decodeMapSize; ++i)
+        encodeMap[decodeMap[i]] = static_cast<Symbol_t>(i);
+}
+
+template<typename Symbol_t>
+void WFLZW::SymbolRemapper<Symbol_t>::decodeBytes(Symbol_t* bytes, const std::size_t amount) const
+{
+    for(std::size_t i = 0; i < amount; ++i)
+        bytes[i] = decodeMap[bytes[i]];
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryList::initialize
+(Symbol_t maxInputByteValue, unsigned reservedCodesAmount)
+{
+    const unsigned maxIndex = static_cast<unsigned>(maxInputByteValue) + 1;
+    mEntriesAmount = maxIndex + reservedCodesAmount;
+    for(unsigned i = 0; i < maxIndex; ++i)
+        mListIndices[i].first = kEmptyIndex;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+typename WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::Index_t
+WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryList::addIfNotExistent
+(const Index_t prefixIndex, const Symbol_t byteValue)
+{
+    if(prefixIndex == kEmptyIndex)
+        return static_cast<Index_t>(byteValue);
+
+    WFLZW_STATS(++mLookupsAmount);
+    const Index_t listStartIndex = mListIndices[prefixIndex].first;
+    Index_t index = listStartIndex;
+    while(index != kEmptyIndex)
+    {
+        WFLZW_STATS(++mProbesAmount);
+        if(mBytes[index] == byteValue)
+            return index;
+        index = mListIndices[index].next;
+    }
+
+    mBytes[mEntriesAmount] = byteValue;
+    mListIndices[mEntriesAmount].first = kEmptyIndex;
+    mListIndices[mEntriesAmount].next = listStartIndex;
+    mListIndices[prefixIndex].first = mEntriesAmount;
+    ++mEntriesAmount;
+
+    return kEmptyIndex;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryTree::initialize
+(Symbol_t maxInputByteValue, unsigned reservedCodesAmount)
+{
+    const unsigned maxIndex = static_cast<unsigned>(maxInputByteValue) + 1;
+    mEntriesAmount = maxIndex + reservedCodesAmount;
+    for(unsigned i = 0; i < maxIndex; ++i)
+        mListIndices[i].first = kEmptyIndex;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+typename WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::Index_t
+WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryTree::addIfNotExistent
+(const Index_t prefixIndex, const Symbol_t byteValue)
+{
+    if(prefixIndex == kEmptyIndex)
+        return static_cast<Index_t>(byteValue);
+
+    WFLZW_STATS(++mLookupsAmount);
+    Index_t index = mListIndices[prefixIndex].first, prevIndex = kEmptyIndex;
+    bool goRight;
+    Symbol_t dirBitMask = byteValue;
+    while(index != kEmptyIndex)
+    {
+        WFLZW_STATS(++mProbesAmount);
+        if(mBytes[index] == byteValue)
+            return index;
+        prevIndex = index;
+        goRight = (dirBitMask & 1);
+        dirBitMask >>= 1;
+        index = (goRight ? mListIndices[index].right : mListIndices[index].left);
+    }
+
+    mBytes[mEntriesAmount] = byteValue;
+    mListIndices[mEntriesAmount].first = kEmptyIndex;
+    mListIndices[mEntriesAmount].left = kEmptyIndex;
+    mListIndices[mEntriesAmount].right = kEmptyIndex;
+
+    if(prevIndex == kEmptyIndex)
+        mListIndices[prefixIndex].first = mEntriesAmount;
+    else if(goRight)
+        mListIndices[prevIndex].right = mEntriesAmount;
+    else
+        mListIndices[prevIndex].left = mEntriesAmount;
+
+    ++mEntriesAmount;
+    return kEmptyIndex;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+typename WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::Index_t
+WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryList::find
+(const Index_t prefixIndex, const Symbol_t byteValue) const
+{
+    Index_t index = mListIndices[prefixIndex].first;
+    while(index != kEmptyIndex && mBytes[index] != byteValue)
+        index = mListIndices[index].next;
+    return index;
+}
+
+// An entry that isn't in the list of its prefix, so it's never found.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryList::addUnreachable
+(const Symbol_t byteValue)
+{
+    mBytes[mEntriesAmount] = byteValue;
+    mListIndices[mEntriesAmount].first = kEmptyIndex;
+    ++mEntriesAmount;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+typename WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::Index_t
+WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryTree::find
+(const Index_t prefixIndex, const Symbol_t byteValue) const
+{
+    Index_t index = mListIndices[prefixIndex].first;
+    Symbol_t dirBitMask = byteValue;
+    while(index != kEmptyIndex && mBytes[index] != byteValue)
+    {
+        index = ((dirBitMask & 1) ? mListIndices[index].right : mListIndices[index].left);
+        dirBitMask >>= 1;
+    }
+    return index;
+}
+
+// An entry that isn't in the tree of its prefix, so it's never found.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryTree::addUnreachable
+(const Symbol_t byteValue)
+{
+    mBytes[mEntriesAmount] = byteValue;
+    mListIndices[mEntriesAmount].first = kEmptyIndex;
+    ++mEntriesAmount;
+}
+
+// All the entries in the list of an entry have it as their prefix.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryList::getPrefixIndices
+(unsigned rootsAmount, unsigned firstEntryIndex, std::vector<Index_t>& prefixIndices) const
+{
+    prefixIndices.assign(mEntriesAmount, Index_t(kEmptyIndex));
+    for(unsigned index = 0; index < mEntriesAmount; ++index)
+    {
+        if(index == rootsAmount) index = firstEntryIndex;
+        if(index >= mEntriesAmount) break;
+
+        for(Index_t entryIndex = mListIndices[index].first; entryIndex != kEmptyIndex;
+            entryIndex = mListIndices[entryIndex].next)
+            prefixIndices[entryIndex] = static_cast<Index_t>(index);
+    }
+}
+
+/* Every link points to an entry added later than the entry it's in, so going
+   through the entries in order, the prefix of each entry is known before its
+   links are followed. The root of a tree has the tree owner as prefix, and
+   the other entries have the same prefix as their parent.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::DictionaryTree::getPrefixIndices
+(unsigned rootsAmount, unsigned firstEntryIndex, std::vector<Index_t>& prefixIndices) const
+{
+    prefixIndices.assign(mEntriesAmount, Index_t(kEmptyIndex));
+    for(unsigned index = 0; index < mEntriesAmount; ++index)
+    {
+        if(index == rootsAmount) index = firstEntryIndex;
+        if(index >= mEntriesAmount) break;
+
+        const Index_t firstIndex = mListIndices[index].first;
+        if(firstIndex != kEmptyIndex) prefixIndices[firstIndex] = static_cast<Index_t>(index);
+        if(index >= firstEntryIndex)
+        {
+            const Index_t leftIndex = mListIndices[index].left;
+            const Index_t rightIndex = mListIndices[index].right;
+            if(leftIndex != kEmptyIndex) prefixIndices[leftIndex] = prefixIndices[index];
+            if(rightIndex != kEmptyIndex) prefixIndices[rightIndex] = prefixIndices[index];
+        }
+    }
+}
+
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::Encoder
+(Symbol_t maxInputByteValue, bool enableFlush)
+{
+    WFLZW_STATS(resetStats());
+    initialize(maxInputByteValue, enableFlush);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::initialize
+(Symbol_t maxInputByteValue, bool enableFlush)
+{
+    assert(static_cast<unsigned>(maxInputByteValue) + 2 + enableFlush < kDictionaryMaxSize);
+    mMaxInputByteValue = maxInputByteValue;
+    mFlushEnabled = enableFlush;
+    mOutputBits = 0;
+    mOutputBitsAmount = 0;
+    mOutputBufferIndex = 0;
+    mOutputBytesTotal = 0;
+    mInputBytesTotal = 0;
+    reset();
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::reset()
+{
+    mIndex = Dictionary::kEmptyIndex;
+    mDictionary.initialize(mMaxInputByteValue, mFlushEnabled ? 2 : 1);
+    mBitSize = WFLZW::bitSizeOf(mDictionary.size());
+    mMaxOutputValueForCurrentBitSize = (1U << mBitSize);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+WFLZW::EncodeStatus WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::encodeByte
+(Symbol_t byte)
+{
+    if(byte > mMaxInputByteValue) return WFLZW::EncodeStatus::inputByteTooLarge;
+    WFLZW_STATS(++mStats.inputBytes);
+    ++mInputBytesTotal;
+
+    const Index_t existingIndex = mDictionary.addIfNotExistent(mIndex, byte);
 
     if(existingIndex != Dictionary::kEmptyIndex)
     {
-        mIndex = existingIndex;
+        mIndex = existingIndex;
+    }
+    else
+    {
+        outputIndex(mIndex);
+        mIndex = static_cast<Index_t>(byte);
+
+        if(mDictionary.isFull())
+        {
+            outputIndex(mIndex);
+            reset();
+            outputResetPointAt(mInputBytesTotal);
+            WFLZW_STATS(++mStats.dictionaryResets);
+        }
+        else if(mDictionary.size() == mMaxOutputValueForCurrentBitSize)
+        {
+            ++mBitSize;
+            mMaxOutputValueForCurrentBitSize = (1U << mBitSize);
+        }
+    }
+
+    return WFLZW::EncodeStatus::ok;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+WFLZW::EncodeStatus WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::encodeByte
+(Symbol_t byte, const WFLZW::SymbolRemapper<Symbol_t>& remapper)
+{
+    return encodeByte(remapper.encodeMap[byte]);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+WFLZW::EncodeStatus WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::encodeBytes
+(const Symbol_t* bytes, const std::size_t amount)
+{
+    return encodeBytesWithByteMap(bytes, amount, IdentityByteMap());
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+WFLZW::EncodeStatus WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::encodeBytes
+(const Symbol_t* bytes, const std::size_t amount, const WFLZW::SymbolRemapper<Symbol_t>& remapper)
+{
+    return encodeBytesWithByteMap(bytes, amount, RemapperByteMap { remapper.encodeMap });
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+template<typename ByteMap_t>
+WFLZW::EncodeStatus
+WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::encodeBytesWithByteMap
+(const Symbol_t* bytes, const std::size_t amount, const ByteMap_t& byteMap)
+{
+    std::size_t index = 0;
+    while(index < amount)
+    {
+        const std::size_t bytesConsumed = encodeBytesWithCurrentBitSize<kMinBitSize>
+            (bytes + index, amount - index, byteMap,
+             std::integral_constant<bool, (kMinBitSize < kMaxBitSize)>());
+        index += bytesConsumed;
+
+        // Only a dictionary reset leaves the current string empty after consuming bytes.
+        if(bytesConsumed > 0 && mIndex == Dictionary::kEmptyIndex)
+            outputResetPointAt(mInputBytesTotal + index);
+
+        if(index < amount && byteMap(bytes[index]) > mMaxInputByteValue)
+        {
+            WFLZW_STATS(mStats.inputBytes += index);
+            mInputBytesTotal += index;
+            return WFLZW::EncodeStatus::inputByteTooLarge;
+        }
+    }
+    WFLZW_STATS(mStats.inputBytes += amount);
+    mInputBytesTotal += amount;
+    return WFLZW::EncodeStatus::ok;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+template<unsigned kBitSize, typename ByteMap_t>
+std::size_t
+WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::encodeBytesWithCurrentBitSize
+(const Symbol_t* bytes, const std::size_t amount, const ByteMap_t& byteMap, std::true_type)
+{
+    if(mBitSize == kBitSize)
+        return encodeBytesWithBitSize<kBitSize>(bytes, amount, byteMap);
+    return encodeBytesWithCurrentBitSize<kBitSize + 1>
+        (bytes, amount, byteMap, std::integral_constant<bool, (kBitSize + 1 < kMaxBitSize)>());
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+template<unsigned kBitSize, typename ByteMap_t>
+std::size_t
+WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::encodeBytesWithCurrentBitSize
+(const Symbol_t* bytes, const std::size_t amount, const ByteMap_t& byteMap, std::false_type)
+{
+    return encodeBytesWithBitSize<kBitSize>(bytes, amount, byteMap);
+}
+
+/* Encodes bytes until the input ends, a byte that's too large is encountered
+   or the code width changes. Returns the amount of bytes consumed.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+template<unsigned kBitSize, typename ByteMap_t>
+std::size_t WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::encodeBytesWithBitSize
+(const Symbol_t* bytes, const std::size_t amount, const ByteMap_t& byteMap)
+{
+    const Symbol_t maxInputByteValue = mMaxInputByteValue;
+    Index_t index = mIndex;
+
+    for(std::size_t i = 0; i < amount; ++i)
+    {
+        const Symbol_t byte = byteMap(bytes[i]);
+        if(byte > maxInputByteValue)
+        {
+            mIndex = index;
+            return i;
+        }
+
+        const Index_t existingIndex = mDictionary.addIfNotExistent(index, byte);
+
+        if(existingIndex != Dictionary::kEmptyIndex)
+        {
+            index = existingIndex;
+            continue;
+        }
+
+        outputIndex<kBitSize>(index);
+        index = static_cast<Index_t>(byte);
+
+        if(mDictionary.isFull())
+        {
+            outputIndex<kBitSize>(index);
+            reset();
+            WFLZW_STATS(++mStats.dictionaryResets);
+            return i + 1;
+        }
+        else if(mDictionary.size() == (1U << kBitSize))
+        {
+            mIndex = index;
+            mBitSize = kBitSize + 1;
+            mMaxOutputValueForCurrentBitSize = (1U << mBitSize);
+            return i + 1;
+        }
+    }
+
+    mIndex = index;
+    return amount;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+bool WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::findString
+(Index_t prefixIndex, Symbol_t byte, Index_t& index) const
+{
+    const Index_t existingIndex = mDictionary.find(prefixIndex, byte);
+    if(existingIndex == Dictionary::kEmptyIndex) return false;
+    index = existingIndex;
+    return true;
+}
+
+// The same steps as encodeByte() takes when the current string can't be extended.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+bool WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::outputString
+(Index_t index, unsigned length, Symbol_t nextByte)
+{
+    assert(mIndex == Dictionary::kEmptyIndex);
+    WFLZW_STATS(mStats.inputBytes += length);
+    mInputBytesTotal += length;
+
+    if(mDictionary.addIfNotExistent(index, nextByte) != Dictionary::kEmptyIndex)
+        mDictionary.addUnreachable(nextByte);
+    outputIndex(index);
+
+    if(mDictionary.isFull())
+    {
+        WFLZW_STATS(++mStats.inputBytes);
+        ++mInputBytesTotal;
+        outputIndex(static_cast<Index_t>(nextByte));
+        reset();
+        outputResetPointAt(mInputBytesTotal);
+        WFLZW_STATS(++mStats.dictionaryResets);
+        return true;
+    }
+
+    if(mDictionary.size() == mMaxOutputValueForCurrentBitSize)
+    {
+        ++mBitSize;
+        mMaxOutputValueForCurrentBitSize = (1U << mBitSize);
+    }
+    return false;
+}
+
+/* Outputs the current string without extending it, followed by the sync code
+   (maxInputByteValue+2) and padding up to the next byte boundary, and sends
+   everything to outputEncodedBytes(). The dictionary is kept.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::flush()
+{
+    assert(mFlushEnabled);
+    outputStringAndControlCode(static_cast<Index_t>(mMaxInputByteValue) + 2);
+}
+
+/* The same as finalizeEncoding(), but the dictionary isn't reset. The decoder
+   stops at the end code, and continues from the next byte boundary with the
+   dictionary it has.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::finalizeMessage()
+{
+    outputStringAndControlCode(static_cast<Index_t>(mMaxInputByteValue) + 1);
+    WFLZW_STATS(++mStats.streamsFinalized);
+}
+
+/* Used for the sync and end codes. The code width has to follow the decoder
+   also for the end code: a decoder continuing a session reads the next
+   message with it, and otherwise an end code that ends exactly at a byte
+   boundary would be missing its last bit.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::outputStringAndControlCode
+(Index_t controlCode)
+{
+    if(mIndex != Dictionary::kEmptyIndex)
+    {
+        outputIndex(mIndex);
+        mIndex = Dictionary::kEmptyIndex;
+
+        // No dictionary entry was added for the code above, so the decoder,
+        // which is normally one entry behind, is now level with the encoder
+        // and will increase the code width one entry earlier than usual.
+        if(mDictionary.size() == mMaxOutputValueForCurrentBitSize - 1U &&
+           mDictionary.size() < kDictionaryMaxSize - 1)
+        {
+            ++mBitSize;
+            mMaxOutputValueForCurrentBitSize = (1U << mBitSize);
+        }
+    }
+
+    outputIndex(controlCode);
+    outputPendingBits();
+
+    if(mOutputBufferIndex > 0)
+    {
+        outputEncodedBytes(mOutputBuffer, mOutputBufferIndex);
+        WFLZW_STATS(++mStats.outputCallbacks);
+        mOutputBytesTotal += mOutputBufferIndex;
+        mOutputBufferIndex = 0;
+    }
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::finalizeEncoding()
+{
+    outputStringAndControlCode(static_cast<Index_t>(mMaxInputByteValue) + 1);
+    mOutputBytesTotal = 0;
+    mInputBytesTotal = 0;
+    reset();
+    WFLZW_STATS(++mStats.streamsFinalized);
+}
+
+/* Checkpoint header, with all values little-endian:
+     0: kDictionaryMaxSize (4 bytes)
+     4: maxInputByteValue, flush enabled, code width, pending bits amount and
+        the pending bits (1 byte each)
+     9: current string index, or 0xFFFFFFFF if none (4 bytes)
+    13: dictionary size (4 bytes)
+    17: stream size up to the pending bits (8 bytes)
+    25: input bytes in the stream so far (8 bytes)
+    33: with 16-bit symbols, the high byte of maxInputByteValue
+   The pending bits are those of the last, incomplete byte of the stream.
+   The symbols of the entries take sizeof(Symbol_t) bytes.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::finalizeEncoding
+(std::vector<WFLZW::Byte>& checkpoint)
+{
+    outputPendingBytes(mOutputBitsAmount / 8);
+
+    std::vector<Index_t> prefixIndices;
+    mDictionary.getPrefixIndices(mMaxInputByteValue + 1U, firstEntryIndex(), prefixIndices);
+    const unsigned entriesAmount = mDictionary.size();
+
+    checkpoint.resize(kCheckpointHeaderSize + (entriesAmount - firstEntryIndex()) *
+                      (kCheckpointIndexBytes + sizeof(Symbol_t)));
+    WFLZW::Byte* dest = checkpoint.data();
+    WFLZW::writeUInt32LE(dest, kDictionaryMaxSize);
+    dest[4] = static_cast<WFLZW::Byte>(mMaxInputByteValue);
+    if(sizeof(Symbol_t) > 1)
+        dest[33] = static_cast<WFLZW::Byte>(mMaxInputByteValue >> 8);
+    dest[5] = mFlushEnabled;
+    dest[6] = static_cast<WFLZW::Byte>(mBitSize);
+    dest[7] = static_cast<WFLZW::Byte>(mOutputBitsAmount);
+    dest[8] = static_cast<WFLZW::Byte>(mOutputBits);
+    WFLZW::writeUInt32LE(dest + 9, mIndex == Dictionary::kEmptyIndex ? ~0U : unsigned(mIndex));
+    WFLZW::writeUInt32LE(dest + 13, entriesAmount);
+    WFLZW::writeUInt64LE(dest + 17, mOutputBytesTotal + mOutputBufferIndex);
+    WFLZW::writeUInt64LE(dest + 25, mInputBytesTotal);
+    dest += kCheckpointHeaderSize;
+
+    for(unsigned index = firstEntryIndex(); index < entriesAmount; ++index)
+    {
+        for(unsigned i = 0; i < kCheckpointIndexBytes; ++i)
+            *dest++ = static_cast<WFLZW::Byte>(prefixIndices[index] >> (i * 8));
+        const unsigned byte = mDictionary.byteAt(static_cast<Index_t>(index));
+        for(unsigned i = 0; i < sizeof(Symbol_t); ++i)
+            *dest++ = static_cast<WFLZW::Byte>(byte >> (i * 8));
+    }
+
+    finalizeEncoding();
+}
+
+/* Entries are added to the dictionary in their original order, which
+   rebuilds exactly the same lists or trees. Everything is validated so that
+   the encoder never indexes out of bounds or outputs codes that don't fit
+   the code width, whatever the checkpoint contains.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+bool WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::resumeEncoding
+(const WFLZW::Byte* checkpoint, std::size_t checkpointSize, std::uint64_t& streamSize)
+{
+    const unsigned maxInputByteValue = (checkpointSize < kCheckpointHeaderSize ? 0 :
+                                        sizeof(Symbol_t) > 1 ? checkpoint[4] | checkpoint[33] << 8 :
+                                        checkpoint[4]);
+    if(checkpointSize < kCheckpointHeaderSize ||
+       WFLZW::readUInt32LE(checkpoint) != kDictionaryMaxSize ||
+       checkpoint[5] > 1 ||
+       maxInputByteValue + 2 + checkpoint[5] >= kDictionaryMaxSize)
+    {
+        initialize();
+        return false;
+    }
+
+    initialize(static_cast<Symbol_t>(maxInputByteValue), checkpoint[5] != 0);
+    const unsigned bitSize = checkpoint[6], pendingBitsAmount = checkpoint[7];
+    const unsigned index = WFLZW::readUInt32LE(checkpoint + 9);
+    const unsigned entriesAmount = WFLZW::readUInt32LE(checkpoint + 13);
+    const unsigned minBitSize = WFLZW::bitSizeOf(entriesAmount);
+
+    if(entriesAmount < firstEntryIndex() || entriesAmount >= kDictionaryMaxSize ||
+       checkpointSize != kCheckpointHeaderSize + std::size_t(entriesAmount - firstEntryIndex()) *
+       (kCheckpointIndexBytes + sizeof(Symbol_t)) ||
+       bitSize < minBitSize || bitSize > minBitSize + 1 || bitSize > kMaxBitSize ||
+       pendingBitsAmount >= 8 || (checkpoint[8] >> pendingBitsAmount) != 0 ||
+       (index != ~0U && (index >= entriesAmount ||
+                         (index > mMaxInputByteValue && index < firstEntryIndex()))))
+    {
+        initialize();
+        return false;
+    }
+
+    const WFLZW::Byte* src = checkpoint + kCheckpointHeaderSize;
+    for(unsigned entryIndex = firstEntryIndex(); entryIndex < entriesAmount; ++entryIndex)
+    {
+        unsigned prefixIndex = 0;
+        for(unsigned i = 0; i < kCheckpointIndexBytes; ++i)
+            prefixIndex |= static_cast<unsigned>(*src++) << (i * 8);
+        unsigned byte = 0;
+        for(unsigned i = 0; i < sizeof(Symbol_t); ++i)
+            byte |= static_cast<unsigned>(*src++) << (i * 8);
+
+        if((prefixIndex > mMaxInputByteValue &&
+            (prefixIndex < firstEntryIndex() || prefixIndex >= entryIndex)) ||
+           byte > mMaxInputByteValue ||
+           mDictionary.addIfNotExistent(static_cast<Index_t>(prefixIndex),
+                                        static_cast<Symbol_t>(byte)) !=
+           Dictionary::kEmptyIndex)
+        {
+            initialize();
+            return false;
+        }
+    }
+
+    mIndex = (index == ~0U ? Dictionary::kEmptyIndex : static_cast<Index_t>(index));
+    mBitSize = bitSize;
+    mMaxOutputValueForCurrentBitSize = (1U << mBitSize);
+    mOutputBits = checkpoint[8];
+    mOutputBitsAmount = pendingBitsAmount;
+    mOutputBytesTotal = WFLZW::readUInt64LE(checkpoint + 17);
+    mInputBytesTotal = WFLZW::readUInt64LE(checkpoint + 25);
+    streamSize = mOutputBytesTotal;
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::incrementOutputBufferIndex()
+{
+    if(++mOutputBufferIndex == kOutputBufferSize)
+    {
+        outputEncodedBytes(mOutputBuffer, kOutputBufferSize);
+        WFLZW_STATS(++mStats.outputCallbacks);
+        mOutputBytesTotal += kOutputBufferSize;
+        mOutputBufferIndex = 0;
+    }
+}
+
+// The next code, which starts a new segment, will be written at the current output position.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::outputResetPointAt
+(std::uint64_t inputOffset)
+{
+    const std::uint64_t bitOffset =
+        (mOutputBytesTotal + mOutputBufferIndex) * 8 + mOutputBitsAmount;
+    outputResetPoint(WFLZW::ResetPoint { bitOffset, inputOffset });
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::outputPendingBytes
+(unsigned bytesAmount)
+{
+    if(mOutputBufferIndex + bytesAmount < kOutputBufferSize)
+    {
+        for(unsigned i = 0; i < bytesAmount; ++i)
+            mOutputBuffer[mOutputBufferIndex + i] = static_cast<WFLZW::Byte>(mOutputBits >> (i * 8));
+        mOutputBufferIndex += bytesAmount;
+    }
+    else
+    {
+        for(unsigned i = 0; i < bytesAmount; ++i)
+        {
+            mOutputBuffer[mOutputBufferIndex] = static_cast<WFLZW::Byte>(mOutputBits >> (i * 8));
+            incrementOutputBufferIndex();
+        }
+    }
+
+    mOutputBits >>= bytesAmount * 8;
+    mOutputBitsAmount -= bytesAmount * 8;
+}
+
+// Outputs all the pending bits, padding the last byte with zeros.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::outputPendingBits()
+{
+    mOutputBitsAmount = (mOutputBitsAmount + 7) / 8 * 8;
+    outputPendingBytes(mOutputBitsAmount / 8);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::outputIndex
+(Index_t index)
+{
+    WFLZW_STATS(++mStats.codesPerBitSize[mBitSize]);
+    mCodeLog.push_back(index);
+    mOutputBits |= static_cast<std::uint64_t>(index) << mOutputBitsAmount;
+    if((mOutputBitsAmount += mBitSize) >= 32)
+        outputPendingBytes(4);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+template<unsigned kBitSize>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::outputIndex
+(Index_t index)
+{
+    WFLZW_STATS(++mStats.codesPerBitSize[kBitSize]);
+    mCodeLog.push_back(index);
+    mOutputBits |= static_cast<std::uint64_t>(index) << mOutputBitsAmount;
+    if((mOutputBitsAmount += kBitSize) >= 32)
+        outputPendingBytes(4);
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::Decoder
+(Symbol_t maxInputByteValue, bool enableFlush)
+{
+    WFLZW_STATS(resetStats());
+    initialize(maxInputByteValue, enableFlush);
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+void WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::initialize
+(Symbol_t maxInputByteValue, bool enableFlush)
+{
+    assert(static_cast<unsigned>(maxInputByteValue) + 2 + enableFlush < kDictionaryMaxSize);
+    mMaxInputByteValue = maxInputByteValue;
+    mFirstEntryIndex = static_cast<unsigned>(maxInputByteValue) + 2 + enableFlush;
+    mSyncIndex = (enableFlush ? static_cast<unsigned>(maxInputByteValue) + 2 : kDictionaryMaxSize);
+    mBitOffset = 0;
+    mInputBuffer = 0;
+    const unsigned maxIndex = static_cast<unsigned>(maxInputByteValue) + 1;
+    for(unsigned i = 0; i < maxIndex; ++i)
+    {
+        mPrefixIndices[i] = kEmptyIndex;
+        mBytes[i] = static_cast<Symbol_t>(i);
+    }
+
+    reset();
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+void WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::reset()
+{
+    mEntriesAmount = mFirstEntryIndex;
+    mOldIndex = kEmptyIndex;
+    mBitSize = WFLZW::bitSizeOf(mEntriesAmount);
+    mMaxInputValueForCurrentBitSize = (1U << mBitSize) - 1;
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+WFLZW::DecodeStatus WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::decodeBytes
+(const WFLZW::Byte* bytes, const std::size_t amount)
+{
+    const WFLZW::Byte* const bytesEnd = bytes + amount;
+    while(true)
+    {
+        const WFLZW::DecodeStatus status = decodeBytesWithCurrentBitSize<kMinBitSize>
+            (bytes, bytesEnd, std::integral_constant<bool, (kMinBitSize < kMaxBitSize)>());
+
+        if(status != WFLZW::DecodeStatus::inputContinues) return status;
+        if(bytes == bytesEnd && mBitOffset < mBitSize) return status;
+    }
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+WFLZW::DecodeStatus WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::decodeByte
+(WFLZW::Byte byte)
+{
+    return decodeBytes(&byte, 1);
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+void WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::startAtBitOffset
+(WFLZW::Byte firstByte, unsigned bitOffset)
+{
+    assert(bitOffset < 8);
+    mInputBuffer = static_cast<InputBuffer_t>(firstByte >> bitOffset);
+    mBitOffset = 8 - bitOffset;
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+template<unsigned kBitSize>
+WFLZW::DecodeStatus WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::decodeBytesWithCurrentBitSize
+(const WFLZW::Byte*& bytes, const WFLZW::Byte* bytesEnd, std::true_type)
+{
+    if(mBitSize == kBitSize)
+        return decodeBytesWithBitSize<kBitSize>(bytes, bytesEnd);
+    return decodeBytesWithCurrentBitSize<kBitSize + 1>
+        (bytes, bytesEnd, std::integral_constant<bool, (kBitSize + 1 < kMaxBitSize)>());
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+template<unsigned kBitSize>
+WFLZW::DecodeStatus WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::decodeBytesWithCurrentBitSize
+(const WFLZW::Byte*& bytes, const WFLZW::Byte* bytesEnd, std::false_type)
+{
+    return decodeBytesWithBitSize<kBitSize>(bytes, bytesEnd);
+}
+
+/* Decodes codes until the input ends, the decoding ends or the code width
+   changes. Input bytes are only consumed when more bits are needed, so any
+   bits left in mInputBuffer belong to the next code.
+*/
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+template<unsigned kBitSize>
+WFLZW::DecodeStatus WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::decodeBytesWithBitSize
+(const WFLZW::Byte*& bytes, const WFLZW::Byte* bytesEnd)
+{
+    const InputBuffer_t kIndexMask = (InputBuffer_t(1) << kBitSize) - 1;
+
+    while(true)
+    {
+        while(mBitOffset < kBitSize)
+        {
+            if(bytes == bytesEnd) return WFLZW::DecodeStatus::inputContinues;
+            mInputBuffer |= (static_cast<InputBuffer_t>(*bytes++) << mBitOffset);
+            mBitOffset += 8;
+        }
+
+        const Index_t index = static_cast<Index_t>(mInputBuffer & kIndexMask);
+        mInputBuffer >>= kBitSize;
+        mBitOffset -= kBitSize;
+
+        const WFLZW::DecodeStatus status = decodeIndex(index);
+        if(status != WFLZW::DecodeStatus::inputContinues || mBitSize != kBitSize)
+            return status;
+    }
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+bool WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::readIndex
+(const WFLZW::Byte*& bytes, const WFLZW::Byte* bytesEnd, Index_t& index)
+{
+    while(mBitOffset < mBitSize)
+    {
+        if(bytes == bytesEnd) return false;
+        mInputBuffer |= (static_cast<InputBuffer_t>(*bytes++) << mBitOffset);
+        mBitOffset += 8;
+    }
+
+    index = static_cast<Index_t>(mInputBuffer & ((InputBuffer_t(1) << mBitSize) - 1));
+    mInputBuffer >>= mBitSize;
+    mBitOffset -= mBitSize;
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+Symbol_t WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::extractAndOutputStringAt(Index_t index)
+{
+    Symbol_t* endOfBuffer = mDecodeBuffer + kDictionaryMaxSize;
+    Symbol_t* decodedString = endOfBuffer;
+
+    while(index != kEmptyIndex)
+    {
+        *(--decodedString) = mBytes[index];
+        index = mPrefixIndices[index];
+    }
+
+    const Symbol_t firstByte = *decodedString;
+    outputDecodedBytes(decodedString, endOfBuffer - decodedString);
+#ifdef WFLZW_COLLECT_STATS
+    const std::uint64_t chainLength = endOfBuffer - decodedString;
+    ++mStats.outputCallbacks;
+    mStats.chainLengthTotal += chainLength;
+    if(chainLength > mStats.longestChain) mStats.longestChain = chainLength;
+#endif
+    return firstByte;
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+void WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::addToDictionary
+(Index_t prefixIndex, Symbol_t byteValue)
+{
+    mPrefixIndices[mEntriesAmount] = prefixIndex;
+    mBytes[mEntriesAmount] = byteValue;
+    ++mEntriesAmount;
+}
+
+/* Any code is validated before it's used, so that corrupted or malicious
+   input can't make the decoder read or write out of bounds: mEntriesAmount is
+   always less than kDictionaryMaxSize, so the first test also rejects codes
+   that don't fit the dictionary, and a code that's not yet in the dictionary
+   is only valid when it's the entry that's being added (the KwKwK case),
+   which requires a previous code. The latter is checked only in that branch,
+   so valid input costs no additional tests.
+*/
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+WFLZW::DecodeStatus WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::decodeIndex(Index_t index)
+{
+    WFLZW_STATS(++mStats.codesPerBitSize[mBitSize]);
+
+    if(index > mEntriesAmount)
+        return WFLZW::DecodeStatus::inputError;
+
+    if(index == static_cast<Index_t>(mMaxInputByteValue) + 1)
+    {
+        // The next message of a session, if any, starts at the next byte boundary.
+        mInputBuffer = 0;
+        mBitOffset = 0;
+        mOldIndex = kEmptyIndex;
+        return WFLZW::DecodeStatus::inputDone;
+    }
+
+    if(index == mSyncIndex)
+    {
+        // The next code starts a new string, at the next byte boundary.
+        const unsigned paddingBits = mBitOffset % 8;
+        mInputBuffer >>= paddingBits;
+        mBitOffset -= paddingBits;
+        mOldIndex = kEmptyIndex;
+        return WFLZW::DecodeStatus::inputContinues;
+    }
+
+    if(index < mEntriesAmount)
+    {
+        mOldFirstByte = extractAndOutputStringAt(index);
+        if(mOldIndex != kEmptyIndex)
+            addToDictionary(mOldIndex, mOldFirstByte);
+        mOldIndex = index;
+    }
+    else
+    {
+        if(mOldIndex == kEmptyIndex)
+            return WFLZW::DecodeStatus::inputError;
+
+        const Index_t newIndex = static_cast<Index_t>(mEntriesAmount);
+        addToDictionary(mOldIndex, mOldFirstByte);
+        mOldFirstByte = extractAndOutputStringAt(newIndex);
+        mOldIndex = newIndex;
+    }
+
+    if(mEntriesAmount == kDictionaryMaxSize)
+    {
+        reset();
+        WFLZW_STATS(++mStats.dictionaryResets);
+    }
+    else if(mEntriesAmount == mMaxInputValueForCurrentBitSize &&
+            mEntriesAmount < kDictionaryMaxSize - 1)
+    {
+        ++mBitSize;
+        mMaxInputValueForCurrentBitSize = (1U << mBitSize) - 1;
+    }
+
+    return WFLZW::DecodeStatus::inputContinues;
+}
+
+#ifdef WFLZW_COLLECT_STATS
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+WFLZW::EncoderStats WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::stats() const
+{
+    WFLZW::EncoderStats result = mStats;
+    result.dictionaryLookups = mDictionary.mLookupsAmount;
+    result.dictionaryProbes = mDictionary.mProbesAmount;
+    return result;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize,
+         typename Symbol_t, bool kLogCodes>
+void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize, Symbol_t, kLogCodes>::resetStats()
+{
+    std::memset(&mStats, 0, sizeof(mStats));
+    mDictionary.mLookupsAmount = mDictionary.mProbesAmount = 0;
+}
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t>
+void WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>::resetStats()
+{
+    std::memset(&mStats, 0, sizeof(mStats));
+}
+
+inline std::uint64_t WFLZW::EncoderStats::codes() const
+{
+    std::uint64_t result = 0;
+    for(std::uint64_t amount: codesPerBitSize) result += amount;
+    return result;
+}
+
+// The end code of each stream is not a match, so it's excluded.
+inline double WFLZW::EncoderStats::averageMatchLength() const
+{
+    const std::uint64_t matches = codes() - streamsFinalized;
+    return matches ? double(inputBytes) / double(matches) : 0.0;
+}
+
+inline double WFLZW::EncoderStats::averageProbeDepth() const
+{
+    return dictionaryLookups ? double(dictionaryProbes) / double(dictionaryLookups) : 0.0;
+}
+
+inline std::uint64_t WFLZW::DecoderStats::codes() const
+{
+    std::uint64_t result = 0;
+    for(std::uint64_t amount: codesPerBitSize) result += amount;
+    return result;
+}
+
+inline double WFLZW::DecoderStats::averageChainLength() const
+{
+    return outputCallbacks ? double(chainLengthTotal) / double(outputCallbacks) : 0.0;
+}
+#endif
+
+/* The range coder is the one used by LZMA: mLow has 32 bits plus a carry bit,
+   and the top byte of mLow is held back (in mCache, followed by any 0xFF
+   bytes) until it's known whether a carry will propagate to it.
+*/
+inline WFLZW::RangeEncoder::RangeEncoder(WFLZW::Byte* output, std::size_t outputCapacity):
+    mLow(0), mRange(0xFFFFFFFFU), mOutput(output), mOutputCapacity(outputCapacity),
+    mOutputAmount(0), mPendingFFBytesAmount(0), mCache(0), mHasCache(false)
+{}
+
+inline void WFLZW::RangeEncoder::encode
+(unsigned cumulativeFrequency, unsigned frequency, unsigned total)
+{
+    const std::uint32_t step = mRange / total;
+    mLow += static_cast<std::uint64_t>(step) * cumulativeFrequency;
+    mRange = step * frequency;
+    normalize();
+}
+
+inline void WFLZW::RangeEncoder::encodeBits(unsigned value, unsigned bitsAmount)
+{
+    const std::uint32_t step = mRange >> bitsAmount;
+    mLow += static_cast<std::uint64_t>(step) * value;
+    mRange = step;
+    normalize();
+}
+
+inline std::size_t WFLZW::RangeEncoder::finish()
+{
+    for(unsigned i = 0; i < 5; ++i) shiftLow();
+    return (mOutputAmount <= mOutputCapacity ? mOutputAmount : 0);
+}
+
+inline void WFLZW::RangeEncoder::normalize()
+{
+    while(mRange < (1U << 24))
+    {
+        mRange <<= 8;
+        shiftLow();
+    }
+}
+
+inline void WFLZW::RangeEncoder::shiftLow()
+{
+    if(mLow < 0xFF000000U || mLow > 0xFFFFFFFFU)
+    {
+        const WFLZW::Byte carry = static_cast<WFLZW::Byte>(mLow >> 32);
+        if(mHasCache) outputByte(static_cast<WFLZW::Byte>(mCache + carry));
+        for(; mPendingFFBytesAmount > 0; --mPendingFFBytesAmount)
+            outputByte(static_cast<WFLZW::Byte>(0xFF + carry));
+        mCache = static_cast<WFLZW::Byte>(mLow >> 24);
+        mHasCache = true;
+    }
+    else
+        ++mPendingFFBytesAmount;
+
+    mLow = (mLow & 0x00FFFFFFU) << 8;
+}
+
+inline void WFLZW::RangeEncoder::outputByte(WFLZW::Byte byte)
+{
+    if(mOutputAmount < mOutputCapacity) mOutput[mOutputAmount] = byte;
+    ++mOutputAmount;
+}
+
+inline WFLZW::RangeDecoder::RangeDecoder(const WFLZW::Byte* input, std::size_t amount):
+    mCode(0), mRange(0xFFFFFFFFU), mStep(1), mInput(input), mInputAmount(amount), mInputIndex(0)
+{
+    for(unsigned i = 0; i < 4; ++i)
+        mCode = (mCode << 8) | inputByte();
+}
+
+// Corrupted input may give a code that's out of range, so the result is clamped.
+inline unsigned WFLZW::RangeDecoder::decodeFrequency(unsigned total)
+{
+    mStep = mRange / total;
+    const std::uint32_t value = mCode / mStep;
+    return (value < total ? value : total - 1);
+}
+
+inline void WFLZW::RangeDecoder::consume(unsigned cumulativeFrequency, unsigned frequency)
+{
+    mCode -= mStep * cumulativeFrequency;
+    mRange = mStep * frequency;
+    normalize();
+}
+
+inline unsigned WFLZW::RangeDecoder::decodeBits(unsigned bitsAmount)
+{
+    mStep = mRange >> bitsAmount;
+    std::uint32_t value = mCode / mStep;
+    if(value >= (1U << bitsAmount)) value = (1U << bitsAmount) - 1;
+    mCode -= mStep * value;
+    mRange = mStep;
+    normalize();
+    return value;
+}
+
+inline void WFLZW::RangeDecoder::normalize()
+{
+    while(mRange < (1U << 24))
+    {
+        mCode = (mCode << 8) | inputByte();
+        mRange <<= 8;
+    }
+}
+
+template<unsigned kSymbolsAmount, unsigned kMaxTotal>
+void WFLZW::AdaptiveFrequencies<kSymbolsAmount, kMaxTotal>::initialize()
+{
+    for(std::uint16_t& frequency: frequencies) frequency = 1;
+    total = kSymbolsAmount;
+}
+
+template<unsigned kSymbolsAmount, unsigned kMaxTotal>
+void WFLZW::AdaptiveFrequencies<kSymbolsAmount, kMaxTotal>::encode
+(WFLZW::RangeEncoder& encoder, unsigned symbol)
+{
+    unsigned cumulativeFrequency = 0;
+    for(unsigned i = 0; i < symbol; ++i) cumulativeFrequency += frequencies[i];
+    encoder.encode(cumulativeFrequency, frequencies[symbol], total);
+    update(symbol);
+}
+
+template<unsigned kSymbolsAmount, unsigned kMaxTotal>
+unsigned WFLZW::AdaptiveFrequencies<kSymbolsAmount, kMaxTotal>::decode
+(WFLZW::RangeDecoder& decoder)
+{
+    const unsigned target = decoder.decodeFrequency(total);
+    unsigned symbol = 0, cumulativeFrequency = 0;
+    while(cumulativeFrequency + frequencies[symbol] <= target)
+        cumulativeFrequency += frequencies[symbol++];
+    decoder.consume(cumulativeFrequency, frequencies[symbol]);
+    update(symbol);
+    return symbol;
+}
+
+template<unsigned kSymbolsAmount, unsigned kMaxTotal>
+void WFLZW::AdaptiveFrequencies<kSymbolsAmount, kMaxTotal>::update(unsigned symbol)
+{
+    frequencies[symbol] += kIncrement;
+    total += kIncrement;
+    if(total > kMaxTotal)
+    {
+        total = 0;
+        for(std::uint16_t& frequency: frequencies)
+        {
+            frequency = static_cast<std::uint16_t>((frequency + 1) / 2);
+            total += frequency;
+        }
+    }
+}
+
+template<unsigned kDictionaryMaxSize>
+void WFLZW::CodeEntropyModel<kDictionaryMaxSize>::initialize()
+{
+    mCategories.initialize();
+    mHighNibbles.initialize();
+    for(auto& lowNibbles: mLowNibbles) lowNibbles.initialize();
+    reset();
+}
+
+template<unsigned kDictionaryMaxSize>
+void WFLZW::CodeEntropyModel<kDictionaryMaxSize>::reset()
+{
+    mEntriesAmount = kFirstEntryIndex;
+    mBitSize = WFLZW::bitSizeOf(mEntriesAmount);
+    mHasPreviousCode = false;
+}
+
+// Follows the dictionary size and code width the same way as WFLZW::Decoder.
+template<unsigned kDictionaryMaxSize>
+void WFLZW::CodeEntropyModel<kDictionaryMaxSize>::advance()
+{
+    if(mHasPreviousCode) ++mEntriesAmount;
+    mHasPreviousCode = true;
+
+    if(mEntriesAmount == kDictionaryMaxSize)
+        reset();
+    else if(mEntriesAmount == (1U << mBitSize) - 1 && mEntriesAmount < kDictionaryMaxSize - 1)
+        ++mBitSize;
+}
+
+template<unsigned kDictionaryMaxSize>
+std::size_t WFLZW::CodeEntropyEncoder<kDictionaryMaxSize>::encode
+(const WFLZW::Byte* lzwStream, std::size_t amount, WFLZW::Byte* output, std::size_t outputCapacity)
+{
+    WFLZW::RangeEncoder encoder(output, outputCapacity);
+    std::uint64_t inputBits = 0;
+    unsigned inputBitsAmount = 0;
+    this->initialize();
+
+    while(true)
+    {
+        while(inputBitsAmount < this->mBitSize)
+        {
+            if(amount == 0) return 0;
+            inputBits |= static_cast<std::uint64_t>(*lzwStream++) << inputBitsAmount;
+            inputBitsAmount += 8;
+            --amount;
+        }
+
+        const unsigned code = static_cast<unsigned>(inputBits & ((1U << this->mBitSize) - 1));
+        inputBits >>= this->mBitSize;
+        inputBitsAmount -= this->mBitSize;
+
+        if(code <= this->kMaxByteValue)
+        {
+            this->mCategories.encode(encoder, 0);
+            this->mHighNibbles.encode(encoder, code >> 4);
+            this->mLowNibbles[code >> 4].encode(encoder, code & 15);
+        }
+        else
+        {
+            if(code > this->mEntriesAmount) return 0;
+            const unsigned distance = this->mEntriesAmount - code;
+            const unsigned distanceBitSize = (distance ? WFLZW::bitSizeOf(distance) : 0);
+            this->mCategories.encode(encoder, 1 + distanceBitSize);
+
+            // The highest bit of the distance is implied by its bit size.
+            for(unsigned bitsLeft = (distanceBitSize > 0 ? distanceBitSize - 1 : 0);
+                bitsLeft > 0;)
+            {
+                const unsigned bitsAmount = (bitsLeft < 16 ? bitsLeft : 16);
+                bitsLeft -= bitsAmount;
+                encoder.encodeBits((distance >> bitsLeft) & ((1U << bitsAmount) - 1), bitsAmount);
+            }
+
+            if(code == this->kEndIndex) return encoder.finish();
+        }
+
+        this->advance();
+    }
+}
+
+template<unsigned kDictionaryMaxSize>
+template<typename DecodeIndex_t>
+WFLZW::DecodeStatus WFLZW::CodeEntropyDecoder<kDictionaryMaxSize>::decode
+(const WFLZW::Byte* input, std::size_t amount, DecodeIndex_t&& decodeIndex)
+{
+    WFLZW::RangeDecoder decoder(input, amount);
+    this->initialize();
+
+    while(!decoder.inputOverrun())
+    {
+        unsigned code;
+        const unsigned category = this->mCategories.decode(decoder);
+        if(category == 0)
+        {
+            const unsigned highNibble = this->mHighNibbles.decode(decoder);
+            code = (highNibble << 4) | this->mLowNibbles[highNibble].decode(decoder);
+        }
+        else
+        {
+            const unsigned distanceBitSize = category - 1;
+            unsigned distance = (distanceBitSize > 0 ? 1 : 0);
+            for(unsigned bitsLeft = (distanceBitSize > 0 ? distanceBitSize - 1 : 0);
+                bitsLeft > 0;)
+            {
+                const unsigned bitsAmount = (bitsLeft < 16 ? bitsLeft : 16);
+                bitsLeft -= bitsAmount;
+                distance = (distance << bitsAmount) | decoder.decodeBits(bitsAmount);
+            }
+
+            if(distance > this->mEntriesAmount) return WFLZW::DecodeStatus::inputError;
+            code = this->mEntriesAmount - distance;
+        }
+
+        const WFLZW::DecodeStatus status = decodeIndex(code);
+        if(status != WFLZW::DecodeStatus::inputContinues) return status;
+        this->advance();
+    }
+
+    return WFLZW::DecodeStatus::inputError;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::BlockEncoder()
+{
+    mEncoder.mOwner = this;
+    mEntropyCoding = false;
+    mNextFilter = WFLZW::Filter::none;
+    mNextFilterElementSize = 1;
+    initialize();
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+void WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::initialize()
+{
+    mEncoder.initialize();
+    mInputAmount = 0;
+    mCompressedAmount = 0;
+    mStoreBlock = false;
+    mFilter = mNextFilter;
+    mFilterElementSize = mNextFilterElementSize;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+void WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::setFilter
+(WFLZW::Filter filter, unsigned elementSize)
+{
+    assert(elementSize >= 1 && elementSize <= 255);
+    mNextFilter = filter;
+    mNextFilterElementSize = elementSize;
+
+    if(mInputAmount == 0)
+    {
+        mFilter = filter;
+        mFilterElementSize = elementSize;
+    }
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+void WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::encodeBytes
+(const WFLZW::Byte* bytes, const std::size_t amount)
+{
+    std::size_t bytesLeft = amount;
+    while(bytesLeft > 0)
+    {
+        const unsigned spaceLeft = kBlockSize - mInputAmount;
+        const unsigned amountToCopy =
+            (bytesLeft < spaceLeft ? static_cast<unsigned>(bytesLeft) : spaceLeft);
+
+        std::memcpy(mInputBuffer + mInputAmount, bytes, amountToCopy);
+        if(!mStoreBlock && mFilter == WFLZW::Filter::none)
+            encodeInputBufferBytes(mInputBuffer, mInputAmount, amountToCopy);
+        mInputAmount += amountToCopy;
+        bytes += amountToCopy;
+        bytesLeft -= amountToCopy;
+
+        if(mInputAmount == kBlockSize) outputBlock();
+    }
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+void WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::encodeByte(WFLZW::Byte byte)
+{
+    encodeBytes(&byte, 1);
+}
+
+/* The data is given to the LZW encoder in pieces ending at multiples of
+   kProbeInterval. If at any of these points the compressed data is not
+   smaller than the input so far, the block is deemed incompressible and
+   the rest of it is not run through the encoder at all. The same happens if
+   a byte is larger than the encoder accepts (maxInputByteValue is less than
+   255 with kDictionaryMaxSize 257 or less), so such blocks are stored, and in
+   that case false is returned.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+bool WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::encodeInputBufferBytes
+(const WFLZW::Byte* buffer, unsigned startIndex, unsigned amount)
+{
+    const unsigned endIndex = startIndex + amount;
+    while(startIndex < endIndex && !mStoreBlock)
+    {
+        const unsigned probeIndex = (startIndex / kProbeInterval + 1) * kProbeInterval;
+        const unsigned pieceEndIndex = (probeIndex < endIndex ? probeIndex : endIndex);
+
+        if(mEncoder.encodeBytes(buffer + startIndex, pieceEndIndex - startIndex) !=
+           WFLZW::EncodeStatus::ok)
+        {
+            mStoreBlock = true;
+            return false;
+        }
+
+        if(pieceEndIndex == probeIndex && mCompressedAmount >= probeIndex)
+            mStoreBlock = true;
+        startIndex = pieceEndIndex;
+    }
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+void WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::addCompressedBytes
+(const WFLZW::Byte* bytes, unsigned amount)
+{
+    if(mStoreBlock) return;
+
+    if(amount >= kBlockSize - mCompressedAmount)
+    {
+        mStoreBlock = true;
+        return;
+    }
+
+    std::memcpy(mCompressedBuffer + mCompressedAmount, bytes, amount);
+    mCompressedAmount += amount;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+void WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::outputBlockHeader
+(WFLZW::BlockType blockType, unsigned rawSize, unsigned payloadSize)
+{
+    WFLZW::Byte header[9];
+    header[0] = static_cast<WFLZW::Byte>(blockType);
+    WFLZW::writeUInt32LE(header + 1, rawSize);
+    WFLZW::writeUInt32LE(header + 5, payloadSize);
+    outputEncodedBytes(header, 9);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+void WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::outputBlock()
+{
+    if(mFilter != WFLZW::Filter::none)
+    {
+        WFLZW::applyFilter(mFilter, mFilterElementSize, mInputBuffer, mFilterBuffer, mInputAmount);
+        mCompressedBuffer[0] = static_cast<WFLZW::Byte>(mFilter);
+        mCompressedBuffer[1] = static_cast<WFLZW::Byte>(mFilterElementSize);
+        mCompressedAmount = kFilterDescriptorSize;
+
+        /* The filtered bytes can have any value even if the input doesn't, so
+           with a small dictionary the block is compressed unfiltered instead
+           if the encoder rejects them.
+        */
+        if(!encodeInputBufferBytes(mFilterBuffer, 0, mInputAmount))
+        {
+            mEncoder.initialize();
+            mCompressedAmount = 0;
+            mStoreBlock = false;
+            mFilter = WFLZW::Filter::none;
+            encodeInputBufferBytes(mInputBuffer, 0, mInputAmount);
+        }
+    }
+
+    if(!mStoreBlock)
+    {
+        mEncoder.finalizeEncoding();
+        if(mCompressedAmount >= mInputAmount) mStoreBlock = true;
+    }
+
+    if(mStoreBlock)
+    {
+        outputBlockHeader(WFLZW::BlockType::stored, mInputAmount, mInputAmount);
+        outputEncodedBytes(mInputBuffer, mInputAmount);
+    }
+    else
+    {
+        const unsigned descriptorSize =
+            (mFilter == WFLZW::Filter::none ? 0 : kFilterDescriptorSize);
+        WFLZW::BlockType blockType = (mFilter == WFLZW::Filter::none ?
+                                      WFLZW::BlockType::lzw : WFLZW::BlockType::filteredLZW);
+        const WFLZW::Byte* payload = mCompressedBuffer;
+        unsigned payloadSize = mCompressedAmount;
+
+        // The filter buffer is free at this point, so the entropy-coded payload is built there.
+        if(mEntropyCoding)
+        {
+            const std::size_t entropyCodedSize = WFLZW::CodeEntropyEncoder<kDictionaryMaxSize>()
+                .encode(mCompressedBuffer + descriptorSize, mCompressedAmount - descriptorSize,
+                        mFilterBuffer + descriptorSize, mCompressedAmount - descriptorSize - 1);
+            if(entropyCodedSize > 0)
+            {
+                std::memcpy(mFilterBuffer, mCompressedBuffer, descriptorSize);
+                payload = mFilterBuffer;
+                payloadSize = descriptorSize + static_cast<unsigned>(entropyCodedSize);
+                blockType = (mFilter == WFLZW::Filter::none ?
+                             WFLZW::BlockType::entropyLZW : WFLZW::BlockType::filteredEntropyLZW);
+            }
+        }
+
+        outputBlockHeader(blockType, mInputAmount, payloadSize);
+        outputEncodedBytes(payload, payloadSize);
+    }
+
+    initialize();
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kBlockSize>
+void WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, kBlockSize>::finalizeEncoding()
+{
+    if(mInputAmount > 0) outputBlock();
+
+    const WFLZW::Byte endBlockType = static_cast<WFLZW::Byte>(WFLZW::BlockType::end);
+    outputEncodedBytes(&endBlockType, 1);
+    initialize();
+}
+
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+WFLZW::BlockDecoder<kDictionaryMaxSize, kBlockSize>::BlockDecoder()
+{
+    mDecoder.mOwner = this;
+    initialize();
+}
+
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+void WFLZW::BlockDecoder<kDictionaryMaxSize, kBlockSize>::initialize()
+{
+    mHeaderAmount = 0;
+    mStatus = WFLZW::DecodeStatus::inputContinues;
+}
+
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+WFLZW::DecodeStatus WFLZW::BlockDecoder<kDictionaryMaxSize, kBlockSize>::decodeBytes
+(const WFLZW::Byte* bytes, const std::size_t amount)
+{
+    std::size_t bytesLeft = amount;
+    while(bytesLeft > 0 && mStatus == WFLZW::DecodeStatus::inputContinues)
+    {
+        if(mHeaderAmount < kHeaderSize)
+        {
+            mHeader[mHeaderAmount++] = *bytes++;
+            --bytesLeft;
+            if(mHeaderAmount == 1 &&
+               static_cast<WFLZW::BlockType>(mHeader[0]) == WFLZW::BlockType::end)
+                mStatus = WFLZW::DecodeStatus::inputDone;
+            else if(mHeaderAmount == kHeaderSize)
+                mStatus = startBlock();
+        }
+        else
+        {
+            const unsigned payloadLeft = mPayloadSize - mPayloadAmount;
+            const unsigned amountToDecode =
+                (bytesLeft < payloadLeft ? static_cast<unsigned>(bytesLeft) : payloadLeft);
+            mStatus = decodePayloadBytes(bytes, amountToDecode);
+            bytes += amountToDecode;
+            bytesLeft -= amountToDecode;
+        }
+
+        if(mStatus == WFLZW::DecodeStatus::inputContinues &&
+           mHeaderAmount == kHeaderSize && mPayloadAmount == mPayloadSize)
+            mStatus = endBlock();
+    }
+
+    return mStatus;
+}
+
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+WFLZW::DecodeStatus WFLZW::BlockDecoder<kDictionaryMaxSize, kBlockSize>::decodeByte
+(WFLZW::Byte byte)
+{
+    return decodeBytes(&byte, 1);
+}
+
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+WFLZW::DecodeStatus WFLZW::BlockDecoder<kDictionaryMaxSize, kBlockSize>::startBlock()
+{
+    mBlockType = static_cast<WFLZW::BlockType>(mHeader[0]);
+    mRawSize = WFLZW::readUInt32LE(mHeader + 1);
+    mPayloadSize = WFLZW::readUInt32LE(mHeader + 5);
+    mPayloadAmount = 0;
+    mBlockOutputAmount = 0;
+
+    if(mRawSize > kBlockSize || mPayloadSize > kBlockSize)
+        return WFLZW::DecodeStatus::inputError;
+
+    switch(mBlockType)
+    {
+      case WFLZW::BlockType::stored:
+          if(mPayloadSize != mRawSize) return WFLZW::DecodeStatus::inputError;
+          break;
+
+      case WFLZW::BlockType::filteredLZW:
+      case WFLZW::BlockType::filteredEntropyLZW:
+          if(mPayloadSize < kFilterDescriptorSize) return WFLZW::DecodeStatus::inputError;
+          // Fallthrough
+      case WFLZW::BlockType::lzw:
+      case WFLZW::BlockType::entropyLZW:
+          mDecoder.initialize();
+          mLZWStatus = WFLZW::DecodeStatus::inputContinues;
+          break;
+
+      default:
+          return WFLZW::DecodeStatus::inputError;
+    }
+
+    return WFLZW::DecodeStatus::inputContinues;
+}
+
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+WFLZW::DecodeStatus WFLZW::BlockDecoder<kDictionaryMaxSize, kBlockSize>::decodePayloadBytes
+(const WFLZW::Byte* bytes, unsigned amount)
+{
+    if(isFilteredBlock() && mPayloadAmount < kFilterDescriptorSize)
+    {
+        while(amount > 0 && mPayloadAmount < kFilterDescriptorSize)
+        {
+            mFilterDescriptor[mPayloadAmount++] = *bytes++;
+            --amount;
+        }
+
+        if(mPayloadAmount == kFilterDescriptorSize &&
+           (mFilterDescriptor[0] == static_cast<WFLZW::Byte>(WFLZW::Filter::none) ||
+            mFilterDescriptor[0] > static_cast<WFLZW::Byte>(WFLZW::Filter::shuffleDelta) ||
+            mFilterDescriptor[1] == 0))
+            return WFLZW::DecodeStatus::inputError;
+    }
+
+    mPayloadAmount += amount;
+
+    if(mBlockType == WFLZW::BlockType::stored)
+    {
+        std::memcpy(mBlockBuffer, bytes, amount);
+        mBlockOutputAmount += amount;
+        outputDecodedBytes(mBlockBuffer, amount);
+    }
+    else if(isEntropyCodedBlock())
+    {
+        // Decoded at the end of the block. The filter buffer is not needed before that.
+        std::memcpy(mFilterBuffer + (mPayloadAmount - amount - filterDescriptorSize()),
+                    bytes, amount);
+    }
+    else if(mLZWStatus == WFLZW::DecodeStatus::inputContinues)
+    {
+        mLZWStatus = mDecoder.decodeBytes(bytes, amount);
+        if(mLZWStatus == WFLZW::DecodeStatus::inputError || mBlockOutputAmount > mRawSize)
+            return WFLZW::DecodeStatus::inputError;
+    }
+
+    return WFLZW::DecodeStatus::inputContinues;
+}
+
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+WFLZW::DecodeStatus WFLZW::BlockDecoder<kDictionaryMaxSize, kBlockSize>::endBlock()
+{
+    mHeaderAmount = 0;
+
+    if(isEntropyCodedBlock())
+        mLZWStatus = decodeEntropyCodedPayload();
+
+    if(mBlockOutputAmount != mRawSize ||
+       (mBlockType != WFLZW::BlockType::stored && mLZWStatus != WFLZW::DecodeStatus::inputDone))
+        return WFLZW::DecodeStatus::inputError;
+
+    if(isFilteredBlock() && mRawSize > 0)
+    {
+        WFLZW::reverseFilter(static_cast<WFLZW::Filter>(mFilterDescriptor[0]),
+                             mFilterDescriptor[1], mBlockBuffer, mFilterBuffer, mRawSize);
+        outputDecodedBytes(mFilterBuffer, mRawSize);
+    }
+
+    return WFLZW::DecodeStatus::inputContinues;
+}
+
+// Collects the decoded bytes of a filtered block, to be unfiltered at the end of the block.
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+void WFLZW::BlockDecoder<kDictionaryMaxSize, kBlockSize>::addFilteredBytes
+(const WFLZW::Byte* bytes, unsigned amount)
+{
+    if(mBlockOutputAmount <= mRawSize && amount <= mRawSize - mBlockOutputAmount)
+    {
+        std::memcpy(mBlockBuffer + mBlockOutputAmount, bytes, amount);
+        mBlockOutputAmount += amount;
+    }
+    else
+        mBlockOutputAmount = mRawSize + 1;
+}
+
+template<unsigned kDictionaryMaxSize, unsigned kBlockSize>
+WFLZW::DecodeStatus WFLZW::BlockDecoder<kDictionaryMaxSize, kBlockSize>::decodeEntropyCodedPayload()
+{
+    return WFLZW::CodeEntropyDecoder<kDictionaryMaxSize>().decode
+        (mFilterBuffer, mPayloadSize - filterDescriptorSize(), [this](unsigned code)
+         {
+             const WFLZW::DecodeStatus status = mDecoder.decodeCode(code);
+             return (mBlockOutputAmount > mRawSize ? WFLZW::DecodeStatus::inputError : status);
+         });
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType>
+WFLZW::EncodeStatus WFLZW::BatchEncoder<kDictionaryMaxSize, kDictType>::encodeBatch
+(const WFLZW::ByteSpan* inputs, std::size_t inputsAmount,
+ std::vector<WFLZW::Byte>& output, std::vector<std::size_t>& offsets)
+{
+    mEncoder.mOutput = &output;
+    mEncoder.initialize();
+    offsets.clear();
+    offsets.reserve(inputsAmount + 1);
+    offsets.push_back(output.size());
+
+    // finalizeEncoding() leaves the encoder ready for the next stream.
+    for(std::size_t i = 0; i < inputsAmount; ++i)
+    {
+        if(mEncoder.encodeBytes(inputs[i].data, inputs[i].size) != WFLZW::EncodeStatus::ok)
+        {
+            output.resize(offsets.back());
+            return WFLZW::EncodeStatus::inputByteTooLarge;
+        }
+        mEncoder.finalizeEncoding();
+        offsets.push_back(output.size());
+    }
+    return WFLZW::EncodeStatus::ok;
+}
+
+#ifdef WFLZW_USE_THREADS
+/* The inputs are split into consecutive ranges of roughly equal total size,
+   one for each thread, and each thread compresses its range into its own
+   output array. These are then concatenated, up to the first range that
+   failed.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType>
+WFLZW::EncodeStatus WFLZW::BatchEncoder<kDictionaryMaxSize, kDictType>::encodeBatchInParallel
+(const WFLZW::ByteSpan* inputs, std::size_t inputsAmount,
+ std::vector<WFLZW::Byte>& output, std::vector<std::size_t>& offsets, unsigned threadsAmount)
+{
+    if(threadsAmount < 1) threadsAmount = 1;
+
+    std::size_t totalSize = 0;
+    for(std::size_t i = 0; i < inputsAmount; ++i)
+        totalSize += inputs[i].size;
+
+    std::vector<std::size_t> rangeStarts(1, 0);
+    for(std::size_t i = 0, sizeSoFar = 0; i + 1 < inputsAmount; ++i)
+    {
+        sizeSoFar += inputs[i].size;
+        if(rangeStarts.size() < threadsAmount &&
+           sizeSoFar >= totalSize / threadsAmount * rangeStarts.size())
+            rangeStarts.push_back(i + 1);
+    }
+    rangeStarts.push_back(inputsAmount);
+
+    const std::size_t rangesAmount = rangeStarts.size() - 1;
+    std::vector<std::vector<WFLZW::Byte>> rangeOutputs(rangesAmount);
+    std::vector<std::vector<std::size_t>> rangeOffsets(rangesAmount);
+    std::vector<WFLZW::EncodeStatus> rangeStatuses(rangesAmount);
+    std::vector<std::thread> threads;
+
+    for(std::size_t range = 0; range < rangesAmount; ++range)
+        threads.emplace_back
+            ([&, range]()
+             {
+                 WFLZW::LargeObjectPtr<BatchEncoder> encoder =
+                     WFLZW::makeLargeObject<BatchEncoder>();
+                 rangeStatuses[range] =
+                     encoder->encodeBatch(inputs + rangeStarts[range],
+                                          rangeStarts[range + 1] - rangeStarts[range],
+                                          rangeOutputs[range], rangeOffsets[range]);
+             });
+
+    for(auto& thread: threads)
+        thread.join();
+
+    offsets.clear();
+    offsets.reserve(inputsAmount + 1);
+    offsets.push_back(output.size());
+    for(std::size_t range = 0; range < rangesAmount; ++range)
+    {
+        const std::size_t rangeStartOffset = output.size();
+        for(std::size_t i = 1; i < rangeOffsets[range].size(); ++i)
+            offsets.push_back(rangeStartOffset + rangeOffsets[range][i]);
+        output.insert(output.end(), rangeOutputs[range].begin(), rangeOutputs[range].end());
+
+        if(rangeStatuses[range] != WFLZW::EncodeStatus::ok)
+            return rangeStatuses[range];
+    }
+    return WFLZW::EncodeStatus::ok;
+}
+#endif
+
+template<unsigned kDictionaryMaxSize>
+WFLZW::DecodeStatus WFLZW::BatchDecoder<kDictionaryMaxSize>::decodeStream
+(const WFLZW::Byte* input, std::size_t inputSize,
+ std::vector<WFLZW::Byte>& output, std::vector<std::size_t>& offsets)
+{
+    mDecoder.initialize();
+    const WFLZW::DecodeStatus status = mDecoder.decodeBytes(input, inputSize);
+    offsets.push_back(output.size());
+    return (status == WFLZW::DecodeStatus::inputDone ? status : WFLZW::DecodeStatus::inputError);
+}
+
+template<unsigned kDictionaryMaxSize>
+WFLZW::DecodeStatus WFLZW::BatchDecoder<kDictionaryMaxSize>::decodeBatch
+(const WFLZW::ByteSpan* inputs, std::size_t inputsAmount,
+ std::vector<WFLZW::Byte>& output, std::vector<std::size_t>& offsets)
+{
+    mDecoder.mOutput = &output;
+    offsets.clear();
+    offsets.reserve(inputsAmount + 1);
+    offsets.push_back(output.size());
+
+    for(std::size_t i = 0; i < inputsAmount; ++i)
+        if(decodeStream(inputs[i].data, inputs[i].size, output, offsets) !=
+           WFLZW::DecodeStatus::inputDone)
+            return WFLZW::DecodeStatus::inputError;
+
+    return WFLZW::DecodeStatus::inputDone;
+}
+
+template<unsigned kDictionaryMaxSize>
+WFLZW::DecodeStatus WFLZW::BatchDecoder<kDictionaryMaxSize>::decodeBatch
+(const WFLZW::Byte* input, const std::size_t* inputOffsets, std::size_t inputsAmount,
+ std::vector<WFLZW::Byte>& output, std::vector<std::size_t>& offsets)
+{
+    mDecoder.mOutput = &output;
+    offsets.clear();
+    offsets.reserve(inputsAmount + 1);
+    offsets.push_back(output.size());
+
+    for(std::size_t i = 0; i < inputsAmount; ++i)
+        if(decodeStream(input + inputOffsets[i], inputOffsets[i + 1] - inputOffsets[i],
+                        output, offsets) != WFLZW::DecodeStatus::inputDone)
+            return WFLZW::DecodeStatus::inputError;
+
+    return WFLZW::DecodeStatus::inputDone;
+}
+
+#ifdef WFLZW_USE_THREADS
+template<unsigned kDictionaryMaxSize>
+WFLZW::DecodeStatus WFLZW::BatchDecoder<kDictionaryMaxSize>::decodeBatchInParallel
+(const WFLZW::ByteSpan* inputs, std::size_t inputsAmount,
+ std::vector<WFLZW::Byte>& output, std::vector<std::size_t>& offsets, unsigned threadsAmount)
+{
+    if(threadsAmount < 1) threadsAmount = 1;
+    if(threadsAmount > inputsAmount && inputsAmount > 0)
+        threadsAmount = static_cast<unsigned>(inputsAmount);
+
+    std::vector<std::vector<WFLZW::Byte>> rangeOutputs(threadsAmount);
+    std::vector<std::vector<std::size_t>> rangeOffsets(threadsAmount);
+    std::vector<WFLZW::DecodeStatus> rangeStatuses(threadsAmount);
+    std::vector<std::thread> threads;
+
+    for(unsigned range = 0; range < threadsAmount; ++range)
+        threads.emplace_back
+            ([&, range]()
+             {
+                 const std::size_t startIndex = inputsAmount * range / threadsAmount;
+                 const std::size_t endIndex = inputsAmount * (range + 1) / threadsAmount;
+                 WFLZW::LargeObjectPtr<BatchDecoder> decoder =
+                     WFLZW::makeLargeObject<BatchDecoder>();
+                 rangeStatuses[range] =
+                     decoder->decodeBatch(inputs + startIndex, endIndex - startIndex,
+                                          rangeOutputs[range], rangeOffsets[range]);
+             });
+
+    for(auto& thread: threads)
+        thread.join();
+
+    offsets.clear();
+    offsets.reserve(inputsAmount + 1);
+    offsets.push_back(output.size());
+    for(unsigned range = 0; range < threadsAmount; ++range)
+    {
+        if(rangeStatuses[range] != WFLZW::DecodeStatus::inputDone)
+            return WFLZW::DecodeStatus::inputError;
+
+        const std::size_t rangeStartOffset = output.size();
+        for(std::size_t i = 1; i < rangeOffsets[range].size(); ++i)
+            offsets.push_back(rangeStartOffset + rangeOffsets[range][i]);
+        output.insert(output.end(), rangeOutputs[range].begin(), rangeOutputs[range].end());
+    }
+
+    return WFLZW::DecodeStatus::inputDone;
+}
+#endif
+
+
+/* Each input byte produces at most one code, plus the end code, and no code
+   is wider than the maximum width.
+*/
+template<unsigned kDictionaryMaxSize>
+constexpr std::size_t WFLZW::compressedSizeBound(std::size_t inputSize)
+{
+    return ((inputSize + 1) * WFLZW::bitSizeOf(kDictionaryMaxSize - 1) + 7) / 8;
+}
+
+namespace WFLZW
+{
+    /* The output is resized once to the maximum possible compressed size, the
+       encoder copies its output buffer directly into it, and it's then shrunk
+       to the actual size.
+    */
+    template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, typename Container_t>
+    WFLZW::EncodeStatus compressInto(const WFLZW::Byte* input, std::size_t inputSize,
+                                     Container_t& output,
+                                     std::vector<WFLZW::ResetPoint>* resetPoints = nullptr)
+    {
+        class DirectEncoder: public WFLZW::Encoder<kDictionaryMaxSize, kDictType, 1024>
+        {
+         public:
+            WFLZW::Byte* mDestination;
+            std::vector<WFLZW::ResetPoint>* mResetPoints;
+
+            virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+            {
+                std::memcpy(mDestination, bytes, amount);
+                mDestination += amount;
+            }
+
+            virtual void outputResetPoint(const WFLZW::ResetPoint& resetPoint)
+            {
+                if(mResetPoints) mResetPoints->push_back(resetPoint);
+            }
+        };
+
+        const std::size_t startSize = output.size();
+        output.resize(startSize + WFLZW::compressedSizeBound<kDictionaryMaxSize>(inputSize));
+        WFLZW::Byte* const destinationStart = reinterpret_cast<WFLZW::Byte*>(&output[0]) + startSize;
+
+        std::unique_ptr<DirectEncoder> encoder(new DirectEncoder);
+        encoder->mDestination = destinationStart;
+        encoder->mResetPoints = resetPoints;
+        const WFLZW::EncodeStatus status = encoder->encodeBytes(input, inputSize);
+        encoder->finalizeEncoding();
+
+        output.resize(startSize + (encoder->mDestination - destinationStart));
+        return status;
+    }
+
+    /* The output is resized to the size hint (or to an estimate), and only
+       grown if the decoded data doesn't fit.
+    */
+    template<unsigned kDictionaryMaxSize, typename Container_t>
+    WFLZW::DecodeStatus decompressInto(const WFLZW::Byte* input, std::size_t inputSize,
+                                       Container_t& output, std::size_t sizeHint)
+    {
+        class DirectDecoder: public WFLZW::Decoder<kDictionaryMaxSize>
+        {
+         public:
+            Container_t* mOutput;
+            std::size_t mOutputSize;
+
+            virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
+            {
+                if(mOutput->size() - mOutputSize < amount)
+                    mOutput->resize(mOutputSize + amount > mOutput->size() * 2 ?
+                                    mOutputSize + amount : mOutput->size() * 2);
+                std::memcpy(&(*mOutput)[mOutputSize], bytes, amount);
+                mOutputSize += amount;
+            }
+        };
+
+        std::unique_ptr<DirectDecoder> decoder(new DirectDecoder);
+        decoder->mOutput = &output;
+        decoder->mOutputSize = output.size();
+        output.resize(output.size() + (sizeHint > 0 ? sizeHint : inputSize * 2));
+
+        const WFLZW::DecodeStatus status = decoder->decodeBytes(input, inputSize);
+        output.resize(decoder->mOutputSize);
+        return (status == WFLZW::DecodeStatus::inputDone ? status : WFLZW::DecodeStatus::inputError);
     }
-    else
+
+    /* Decodes one segment of a stream compressed with the default maximum
+       byte value: the first segment starts at the beginning of the stream,
+       and the others at the reset points. All segments but the last end at
+       the next reset point, where the decoder has just reset its dictionary.
+       The partial byte at the end of a segment holds fewer bits than one
+       code, so decoding more bytes than the reset points promise means that
+       they don't match the stream.
+    */
+    template<unsigned kDictionaryMaxSize>
+    class SegmentDecoder: public WFLZW::Decoder<kDictionaryMaxSize>
     {
-        outputIndex(mIndex);
-        mIndex = static_cast<Index_t>(byte);
+     public:
+        WFLZW::DecodeStatus decodeSegment
+        (const WFLZW::Byte* input, std::size_t inputSize,
+         const std::vector<WFLZW::ResetPoint>& resetPoints, std::size_t segmentIndex,
+         std::vector<WFLZW::Byte>& output)
+        {
+            if(segmentIndex > resetPoints.size()) return WFLZW::DecodeStatus::inputError;
 
-        if(mDictionary.isFull())
+            const WFLZW::ResetPoint start =
+                (segmentIndex > 0 ? resetPoints[segmentIndex - 1] : WFLZW::ResetPoint { 0, 0 });
+            const bool isLastSegment = (segmentIndex == resetPoints.size());
+            const std::uint64_t endBitOffset =
+                (isLastSegment ? std::uint64_t(inputSize) * 8 : resetPoints[segmentIndex].bitOffset);
+            const std::uint64_t endByteOffset =
+                (isLastSegment ? ~std::uint64_t(0) : resetPoints[segmentIndex].byteOffset);
+
+            if(endBitOffset < start.bitOffset || endBitOffset > std::uint64_t(inputSize) * 8 ||
+               endByteOffset < start.byteOffset)
+                return WFLZW::DecodeStatus::inputError;
+
+            const std::size_t startIndex = static_cast<std::size_t>(start.bitOffset / 8);
+            const std::size_t endIndex = static_cast<std::size_t>((endBitOffset + 7) / 8);
+            this->initialize();
+            mOutput = &output;
+            mBytesLeft = endByteOffset - start.byteOffset;
+            mOverflow = false;
+
+            WFLZW::DecodeStatus status = WFLZW::DecodeStatus::inputContinues;
+            if(startIndex < endIndex)
+            {
+                this->startAtBitOffset(input[startIndex], start.bitOffset % 8);
+                status = this->decodeBytes(input + startIndex + 1, endIndex - startIndex - 1);
+            }
+
+            if(isLastSegment)
+                return (status == WFLZW::DecodeStatus::inputDone ?
+                        status : WFLZW::DecodeStatus::inputError);
+            return (status != WFLZW::DecodeStatus::inputError && mBytesLeft == 0 && !mOverflow ?
+                    WFLZW::DecodeStatus::inputDone : WFLZW::DecodeStatus::inputError);
+        }
+
+        virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
         {
-            outputIndex(mIndex);
-            reset();
+            unsigned outputAmount = amount;
+            if(outputAmount > mBytesLeft)
+            {
+                outputAmount = static_cast<unsigned>(mBytesLeft);
+                mOverflow = true;
+            }
+            mOutput->insert(mOutput->end(), bytes, bytes + outputAmount);
+            mBytesLeft -= outputAmount;
         }
-        else if(mDictionary.size() == mMaxOutputValueForCurrentBitSize)
+
+     private:
+        std::vector<WFLZW::Byte>* mOutput;
+        std::uint64_t mBytesLeft;
+        bool mOverflow;
+    };
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType>
+WFLZW::EncodeStatus WFLZW::compress
+(const WFLZW::Byte* input, std::size_t inputSize, std::vector<WFLZW::Byte>& output)
+{
+    return WFLZW::compressInto<kDictionaryMaxSize, kDictType>(input, inputSize, output);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType>
+WFLZW::EncodeStatus WFLZW::compress
+(const WFLZW::Byte* input, std::size_t inputSize, std::string& output)
+{
+    return WFLZW::compressInto<kDictionaryMaxSize, kDictType>(input, inputSize, output);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType>
+std::vector<WFLZW::Byte> WFLZW::compress(const WFLZW::Byte* input, std::size_t inputSize)
+{
+    std::vector<WFLZW::Byte> output;
+    if(WFLZW::compressInto<kDictionaryMaxSize, kDictType>(input, inputSize, output) !=
+       WFLZW::EncodeStatus::ok)
+        output.clear();
+    return output;
+}
+
+template<unsigned kDictionaryMaxSize>
+WFLZW::DecodeStatus WFLZW::decompress
+(const WFLZW::Byte* input, std::size_t inputSize, std::vector<WFLZW::Byte>& output,
+ std::size_t sizeHint)
+{
+    return WFLZW::decompressInto<kDictionaryMaxSize>(input, inputSize, output, sizeHint);
+}
+
+template<unsigned kDictionaryMaxSize>
+WFLZW::DecodeStatus WFLZW::decompress
+(const WFLZW::Byte* input, std::size_t inputSize, std::string& output, std::size_t sizeHint)
+{
+    return WFLZW::decompressInto<kDictionaryMaxSize>(input, inputSize, output, sizeHint);
+}
+
+template<unsigned kDictionaryMaxSize>
+std::vector<WFLZW::Byte> WFLZW::decompress
+(const WFLZW::Byte* input, std::size_t inputSize, std::size_t sizeHint)
+{
+    std::vector<WFLZW::Byte> output;
+    if(WFLZW::decompressInto<kDictionaryMaxSize>(input, inputSize, output, sizeHint) !=
+       WFLZW::DecodeStatus::inputDone)
+        output.clear();
+    return output;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType>
+WFLZW::EncodeStatus WFLZW::compress
+(const WFLZW::Byte* input, std::size_t inputSize, std::vector<WFLZW::Byte>& output,
+ std::vector<WFLZW::ResetPoint>& resetPoints)
+{
+    resetPoints.clear();
+    return WFLZW::compressInto<kDictionaryMaxSize, kDictType>
+        (input, inputSize, output, &resetPoints);
+}
+
+template<unsigned kDictionaryMaxSize>
+WFLZW::DecodeStatus WFLZW::decompressSegment
+(const WFLZW::Byte* input, std::size_t inputSize,
+ const std::vector<WFLZW::ResetPoint>& resetPoints, std::size_t segmentIndex,
+ std::vector<WFLZW::Byte>& output)
+{
+    std::unique_ptr<WFLZW::SegmentDecoder<kDictionaryMaxSize>> decoder
+        (new WFLZW::SegmentDecoder<kDictionaryMaxSize>);
+    return decoder->decodeSegment(input, inputSize, resetPoints, segmentIndex, output);
+}
+
+#ifdef WFLZW_USE_THREADS
+/* Like WFLZW::BatchDecoder::decodeBatchInParallel(), each thread decodes a
+   range of consecutive segments into its own array. The reset points may come
+   from an untrusted index, so they are checked before any thread is started,
+   and the array is reserved only up to a multiple of the compressed size of
+   the range (it grows as usual if the data compresses better than that). An
+   exception in a thread is rethrown in the calling thread.
+*/
+template<unsigned kDictionaryMaxSize>
+WFLZW::DecodeStatus WFLZW::decompressInParallel
+(const WFLZW::Byte* input, std::size_t inputSize,
+ const std::vector<WFLZW::ResetPoint>& resetPoints, std::vector<WFLZW::Byte>& output,
+ unsigned threadsAmount)
+{
+    const std::uint64_t inputBits = std::uint64_t(inputSize) * 8;
+    for(std::size_t i = 0; i < resetPoints.size(); ++i)
+        if(resetPoints[i].bitOffset > inputBits ||
+           (i > 0 && (resetPoints[i].bitOffset <= resetPoints[i - 1].bitOffset ||
+                      resetPoints[i].byteOffset <= resetPoints[i - 1].byteOffset)))
+            return WFLZW::DecodeStatus::inputError;
+
+    const std::uint64_t kMaxReservedExpansion = 16;
+    const std::size_t segmentsAmount = resetPoints.size() + 1;
+    if(threadsAmount < 1) threadsAmount = 1;
+    if(threadsAmount > segmentsAmount) threadsAmount = static_cast<unsigned>(segmentsAmount);
+
+    std::vector<std::vector<WFLZW::Byte>> rangeOutputs(threadsAmount);
+    std::vector<WFLZW::DecodeStatus> rangeStatuses(threadsAmount);
+    std::vector<std::exception_ptr> rangeExceptions(threadsAmount);
+    std::vector<std::thread> threads;
+
+    for(unsigned range = 0; range < threadsAmount; ++range)
+        threads.emplace_back
+            ([&, range]()
+             {
+                 const std::size_t startIndex = segmentsAmount * range / threadsAmount;
+                 const std::size_t endIndex = segmentsAmount * (range + 1) / threadsAmount;
+                 rangeStatuses[range] = WFLZW::DecodeStatus::inputError;
+
+                 try
+                 {
+                     WFLZW::LargeObjectPtr<WFLZW::SegmentDecoder<kDictionaryMaxSize>> decoder =
+                         WFLZW::makeLargeObject<WFLZW::SegmentDecoder<kDictionaryMaxSize>>();
+
+                     if(endIndex < segmentsAmount)
+                     {
+                         const WFLZW::ResetPoint start =
+                             (startIndex > 0 ? resetPoints[startIndex - 1] :
+                              WFLZW::ResetPoint { 0, 0 });
+                         const std::uint64_t decodedSize =
+                             resetPoints[endIndex - 1].byteOffset - start.byteOffset;
+                         const std::uint64_t maxReservedSize =
+                             (resetPoints[endIndex - 1].bitOffset - start.bitOffset) / 8 *
+                             kMaxReservedExpansion;
+                         rangeOutputs[range].reserve(static_cast<std::size_t>
+                             (decodedSize < maxReservedSize ? decodedSize : maxReservedSize));
+                     }
+
+                     for(std::size_t i = startIndex; i < endIndex; ++i)
+                         if(decoder->decodeSegment(input, inputSize, resetPoints, i,
+                                                   rangeOutputs[range]) !=
+                            WFLZW::DecodeStatus::inputDone)
+                             return;
+                     rangeStatuses[range] = WFLZW::DecodeStatus::inputDone;
+                 }
+                 catch(...)
+                 {
+                     rangeExceptions[range] = std::current_exception();
+                 }
+             });
+
+    for(auto& thread: threads)
+        thread.join();
+
+    for(unsigned range = 0; range < threadsAmount; ++range)
+        if(rangeExceptions[range]) std::rethrow_exception(rangeExceptions[range]);
+
+    for(unsigned range = 0; range < threadsAmount; ++range)
+    {
+        if(rangeStatuses[range] != WFLZW::DecodeStatus::inputDone)
+            return WFLZW::DecodeStatus::inputError;
+        output.insert(output.end(), rangeOutputs[range].begin(), rangeOutputs[range].end());
+    }
+
+    return WFLZW::DecodeStatus::inputDone;
+}
+#endif
+
+inline void WFLZW::writeResetPoints
+(const std::vector<WFLZW::ResetPoint>& resetPoints, std::vector<WFLZW::Byte>& output)
+{
+    for(const WFLZW::ResetPoint& resetPoint: resetPoints)
+    {
+        WFLZW::Byte bytes[16];
+        WFLZW::writeUInt64LE(bytes, resetPoint.bitOffset);
+        WFLZW::writeUInt64LE(bytes + 8, resetPoint.byteOffset);
+        output.insert(output.end(), bytes, bytes + 16);
+    }
+}
+
+inline bool WFLZW::readResetPoints
+(const WFLZW::Byte* input, std::size_t inputSize, std::vector<WFLZW::ResetPoint>& resetPoints)
+{
+    resetPoints.clear();
+    if(inputSize % 16 != 0) return false;
+
+    for(std::size_t i = 0; i < inputSize; i += 16)
+    {
+        const WFLZW::ResetPoint resetPoint =
+        { WFLZW::readUInt64LE(input + i), WFLZW::readUInt64LE(input + i + 8) };
+        if(!resetPoints.empty() && (resetPoint.bitOffset <= resetPoints.back().bitOffset ||
+                                    resetPoint.byteOffset <= resetPoints.back().byteOffset))
+            return false;
+        resetPoints.push_back(resetPoint);
+    }
+    return true;
+}
+
+
+template<unsigned kDictionaryMaxSize>
+WFLZW::DecoderStream<kDictionaryMaxSize>::DecoderStream
+(WFLZW::Byte maxInputByteValue, bool enableFlush)
+{
+    initialize(maxInputByteValue, enableFlush);
+}
+
+template<unsigned kDictionaryMaxSize>
+void WFLZW::DecoderStream<kDictionaryMaxSize>::initialize
+(WFLZW::Byte maxInputByteValue, bool enableFlush)
+{
+    Base::initialize(maxInputByteValue, enableFlush);
+    mInput = mInputEnd = nullptr;
+    mPendingBytes = mPendingBytesEnd = nullptr;
+    mEndStatus = WFLZW::StreamStatus::inputNeeded;
+}
+
+template<unsigned kDictionaryMaxSize>
+void WFLZW::DecoderStream<kDictionaryMaxSize>::setInput
+(const WFLZW::Byte* bytes, std::size_t amount)
+{
+    mInput = bytes;
+    mInputEnd = bytes + amount;
+}
+
+// Called by decodeIndex(). The string stays in the decode buffer until the next code.
+template<unsigned kDictionaryMaxSize>
+void WFLZW::DecoderStream<kDictionaryMaxSize>::outputDecodedBytes
+(WFLZW::Byte* bytes, unsigned amount)
+{
+    mPendingBytes = bytes;
+    mPendingBytesEnd = bytes + amount;
+}
+
+template<unsigned kDictionaryMaxSize>
+WFLZW::StreamStatus WFLZW::DecoderStream<kDictionaryMaxSize>::decode
+(WFLZW::Byte* output, std::size_t outputCapacity, std::size_t& outputAmount)
+{
+    outputAmount = 0;
+
+    while(true)
+    {
+        const std::size_t pendingAmount = mPendingBytesEnd - mPendingBytes;
+        if(pendingAmount > 0)
         {
-            ++mBitSize;
-            mMaxOutputValueForCurrentBitSize = (1U << mBitSize);
+            const std::size_t amount = (pendingAmount < outputCapacity - outputAmount ?
+                                        pendingAmount : outputCapacity - outputAmount);
+            std::memcpy(output + outputAmount, mPendingBytes, amount);
+            mPendingBytes += amount;
+            outputAmount += amount;
+            if(outputAmount == outputCapacity && mPendingBytes != mPendingBytesEnd)
+                return WFLZW::StreamStatus::outputFull;
+        }
+
+        if(mEndStatus != WFLZW::StreamStatus::inputNeeded)
+            return mEndStatus;
+        if(outputAmount == outputCapacity)
+            return WFLZW::StreamStatus::outputFull;
+
+        typename Base::Index_t index;
+        if(!Base::readIndex(mInput, mInputEnd, index))
+            return WFLZW::StreamStatus::inputNeeded;
+
+        const WFLZW::DecodeStatus status = Base::decodeIndex(index);
+        if(status == WFLZW::DecodeStatus::inputDone)
+            mEndStatus = WFLZW::StreamStatus::done;
+        else if(status == WFLZW::DecodeStatus::inputError)
+            mEndStatus = WFLZW::StreamStatus::inputError;
+    }
+}
+
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::LookaheadEncoder
+(WFLZW::Byte maxInputByteValue, bool enableFlush):
+    Base(maxInputByteValue, enableFlush), mWindowSize(0), mMinLengthGain(3)
+{}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+void WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::initialize
+(WFLZW::Byte maxInputByteValue, bool enableFlush)
+{
+    Base::initialize(maxInputByteValue, enableFlush);
+    mWindowSize = 0;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeBytes
+(const WFLZW::Byte* bytes, const std::size_t amount)
+{
+    return addToWindow(bytes, amount, nullptr);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeBytes
+(const WFLZW::Byte* bytes, const std::size_t amount, const WFLZW::ByteRemapper& remapper)
+{
+    return addToWindow(bytes, amount, remapper.encodeMap);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeByte
+(WFLZW::Byte byte)
+{
+    return addToWindow(&byte, 1, nullptr);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeByte
+(WFLZW::Byte byte, const WFLZW::ByteRemapper& remapper)
+{
+    return addToWindow(&byte, 1, remapper.encodeMap);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+void WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::flush()
+{
+    encodeWindow(true);
+    Base::flush();
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+void WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::finalizeMessage()
+{
+    encodeWindow(true);
+    Base::finalizeMessage();
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+void WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::finalizeEncoding()
+{
+    encodeWindow(true);
+    Base::finalizeEncoding();
+}
+
+// The bytes are mapped with encodeMap if it's not null.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::addToWindow
+(const WFLZW::Byte* bytes, const std::size_t amount, const WFLZW::Byte* encodeMap)
+{
+    const WFLZW::Byte maxInputByteValue = Base::maxByteValue();
+
+    for(std::size_t i = 0; i < amount; ++i)
+    {
+        const WFLZW::Byte byte = (encodeMap ? encodeMap[bytes[i]] : bytes[i]);
+        if(byte > maxInputByteValue)
+            return WFLZW::EncodeStatus::inputByteTooLarge;
+
+        mWindow[mWindowSize] = byte;
+        if(++mWindowSize == kWindowSize)
+            encodeWindow(false);
+    }
+
+    return WFLZW::EncodeStatus::ok;
+}
+
+// The length of the longest string in the dictionary matching the window at position.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+unsigned WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::matchLength
+(unsigned position, unsigned end) const
+{
+    Index_t index = static_cast<Index_t>(mWindow[position]);
+    unsigned length = 1;
+    while(position + length < end && Base::findString(index, mWindow[position + length], index))
+        ++length;
+    return length;
+}
+
+/* Encodes the window up to its last kLookaheadSize bytes, or all of it with
+   toEnd, in which case the last string is left as the current string of the
+   encoder, to be output by flushing or finalizing. Otherwise every string is
+   followed by at least one byte in the window.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+void WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeWindow
+(bool toEnd)
+{
+    const unsigned end = (toEnd ? mWindowSize : mWindowSize - 1);
+    const unsigned stopPosition = (toEnd ? mWindowSize : mWindowSize - kLookaheadSize);
+    unsigned position = 0;
+
+    while(position < stopPosition)
+    {
+        const unsigned longestLength = matchLength(position, end);
+        const unsigned minCandidateLength =
+            (longestLength > kMaxCandidates ? longestLength - kMaxCandidates + 1 : 1);
+        unsigned length = longestLength;
+        unsigned bestTotalLength = longestLength + mMinLengthGain +
+            (position + longestLength < end ? matchLength(position + longestLength, end) : 0);
+
+        for(unsigned candidateLength = longestLength - 1; candidateLength >= minCandidateLength;
+            --candidateLength)
+        {
+            const unsigned totalLength =
+                candidateLength + matchLength(position + candidateLength, end);
+            if(totalLength > bestTotalLength)
+            {
+                bestTotalLength = totalLength;
+                length = candidateLength;
+            }
+        }
+
+        if(position + length == mWindowSize)
+        {
+            // Becomes the current string, as it's a match.
+            Base::encodeBytes(mWindow + position, length);
+            position += length;
+            break;
+        }
+
+        Index_t index = static_cast<Index_t>(mWindow[position]);
+        for(unsigned i = 1; i < length; ++i)
+            Base::findString(index, mWindow[position + i], index);
+
+        const bool dictionaryReset = Base::outputString(index, length, mWindow[position + length]);
+        position += length + dictionaryReset;
+    }
+
+    mWindowSize -= position;
+    std::memmove(mWindow, mWindow + position, mWindowSize);
+}
+
+
+inline WFLZW::ClassicFormat WFLZW::unixCompressFormat(unsigned maxBitSize)
+{
+    // Block mode (with the clear code), as compress writes by default.
+    return { WFLZW::BitOrder::lsbFirst, 256, 9, maxBitSize,
+             true, false, false, false, true, true };
+}
+
+inline WFLZW::ClassicFormat WFLZW::gifFormat(unsigned minCodeSize)
+{
+    return { WFLZW::BitOrder::lsbFirst, 1U << minCodeSize, minCodeSize + 1, 12,
+             true, true, true, false, false, false };
+}
+
+inline WFLZW::ClassicFormat WFLZW::tiffFormat()
+{
+    return { WFLZW::BitOrder::msbFirst, 256, 9, 12,
+             true, true, true, true, false, false };
+}
+
+template<unsigned kMaxBitSize>
+WFLZW::ClassicEncoder<kMaxBitSize>::ClassicEncoder(const WFLZW::ClassicFormat& format)
+{
+    initialize(format);
+}
+
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicEncoder<kMaxBitSize>::initialize(const WFLZW::ClassicFormat& format)
+{
+    mFormat = format;
+    if(mFormat.maxBitSize > kMaxBitSize)
+        mFormat.maxBitSize = kMaxBitSize;
+
+    /* With early change the dictionary is cleared two entries before it's
+       full, as libtiff does, because some decoders would otherwise grow the
+       code width past maxBitSize.
+    */
+    mMaxEntriesAmount = 1U << mFormat.maxBitSize;
+    if(mFormat.hasClearCode && mFormat.earlyChange)
+        mMaxEntriesAmount -= 2;
+
+    mOutputBits = 0;
+    mOutputBitsAmount = mOutputBufferIndex = mCodesInGroup = 0;
+    mIndex = Dictionary::kEmptyIndex;
+
+    if(mFormat.compressHeader)
+    {
+        outputByte(0x1F);
+        outputByte(0x9D);
+        outputByte(static_cast<WFLZW::Byte>(mFormat.maxBitSize |
+                                            (mFormat.hasClearCode ? 0x80U : 0U)));
+    }
+
+    reset();
+    if(mFormat.hasClearCode && mFormat.clearCodeFirst)
+        outputCode(mFormat.rootsAmount);
+}
+
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicEncoder<kMaxBitSize>::reset()
+{
+    mDictionary.initialize(static_cast<WFLZW::Byte>(mFormat.rootsAmount - 1),
+                           mFormat.hasClearCode + mFormat.hasEndCode);
+    mBitSize = mFormat.minBitSize;
+}
+
+template<unsigned kMaxBitSize>
+WFLZW::EncodeStatus WFLZW::ClassicEncoder<kMaxBitSize>::encodeBytes
+(const WFLZW::Byte* bytes, const std::size_t amount)
+{
+    for(std::size_t i = 0; i < amount; ++i)
+        if(encodeByte(bytes[i]) != WFLZW::EncodeStatus::ok)
+            return WFLZW::EncodeStatus::inputByteTooLarge;
+    return WFLZW::EncodeStatus::ok;
+}
+
+template<unsigned kMaxBitSize>
+WFLZW::EncodeStatus WFLZW::ClassicEncoder<kMaxBitSize>::encodeByte(WFLZW::Byte byte)
+{
+    if(byte >= mFormat.rootsAmount)
+        return WFLZW::EncodeStatus::inputByteTooLarge;
+
+    if(mIndex == Dictionary::kEmptyIndex)
+    {
+        mIndex = byte;
+        return WFLZW::EncodeStatus::ok;
+    }
+
+    // Without a clear code a full dictionary stays as it is.
+    const Index_t index = (mDictionary.size() < mMaxEntriesAmount ?
+                           mDictionary.addIfNotExistent(mIndex, byte) :
+                           mDictionary.find(mIndex, byte));
+    if(index != Dictionary::kEmptyIndex)
+    {
+        mIndex = index;
+        return WFLZW::EncodeStatus::ok;
+    }
+
+    outputCode(mIndex);
+    mIndex = byte;
+
+    if(mFormat.hasClearCode && mDictionary.size() == mMaxEntriesAmount)
+    {
+        outputCode(mFormat.rootsAmount);
+        skipToGroupEnd();
+        reset();
+    }
+    else
+        updateBitSize(mDictionary.size());
+
+    return WFLZW::EncodeStatus::ok;
+}
+
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicEncoder<kMaxBitSize>::finalizeEncoding()
+{
+    if(mIndex != Dictionary::kEmptyIndex)
+    {
+        outputCode(mIndex);
+        // The decoder adds an entry for the last code, which can widen the end code.
+        if(mFormat.hasEndCode)
+            updateBitSize(mDictionary.size() + 1);
+    }
+
+    if(mFormat.hasEndCode)
+        outputCode(mFormat.rootsAmount + mFormat.hasClearCode);
+
+    if(mOutputBitsAmount > 0)
+        outputByte(static_cast<WFLZW::Byte>(mFormat.bitOrder == WFLZW::BitOrder::lsbFirst ?
+                                            mOutputBits : mOutputBits << (8 - mOutputBitsAmount)));
+    if(mOutputBufferIndex > 0)
+        outputEncodedBytes(mOutputBuffer, mOutputBufferIndex);
+
+    initialize(mFormat);
+}
+
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicEncoder<kMaxBitSize>::outputCode(unsigned code)
+{
+    if(mFormat.bitOrder == WFLZW::BitOrder::lsbFirst)
+    {
+        mOutputBits |= static_cast<std::uint64_t>(code) << mOutputBitsAmount;
+        mOutputBitsAmount += mBitSize;
+        for(; mOutputBitsAmount >= 8; mOutputBitsAmount -= 8, mOutputBits >>= 8)
+            outputByte(static_cast<WFLZW::Byte>(mOutputBits));
+    }
+    else
+    {
+        mOutputBits = (mOutputBits << mBitSize) | code;
+        mOutputBitsAmount += mBitSize;
+        while(mOutputBitsAmount >= 8)
+        {
+            mOutputBitsAmount -= 8;
+            outputByte(static_cast<WFLZW::Byte>(mOutputBits >> mOutputBitsAmount));
         }
     }
-
-    return WFLZW::EncodeStatus::ok;
+
+    if(++mCodesInGroup == 8)
+        mCodesInGroup = 0;
+}
+
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicEncoder<kMaxBitSize>::outputByte(WFLZW::Byte byte)
+{
+    mOutputBuffer[mOutputBufferIndex] = byte;
+    if(++mOutputBufferIndex == sizeof(mOutputBuffer))
+    {
+        outputEncodedBytes(mOutputBuffer, mOutputBufferIndex);
+        mOutputBufferIndex = 0;
+    }
 }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-WFLZW::EncodeStatus WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeByte
-(WFLZW::Byte byte, const WFLZW::ByteRemapper& remapper)
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicEncoder<kMaxBitSize>::skipToGroupEnd()
 {
-    return encodeByte(remapper.encodeMap[byte]);
+    if(mFormat.codeGroups)
+        while(mCodesInGroup != 0)
+            outputCode(0);
 }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-WFLZW::EncodeStatus WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeBytes
-(const WFLZW::Byte* bytes, const std::size_t amount)
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicEncoder<kMaxBitSize>::updateBitSize(unsigned entriesAmount)
 {
-    for(std::size_t i = 0; i < amount; ++i)
-        if(encodeByte(bytes[i]) == WFLZW::EncodeStatus::inputByteTooLarge)
-            return WFLZW::EncodeStatus::inputByteTooLarge;
-    return WFLZW::EncodeStatus::ok;
+    if(mBitSize < mFormat.maxBitSize &&
+       entriesAmount + mFormat.earlyChange > (1U << mBitSize))
+    {
+        skipToGroupEnd();
+        ++mBitSize;
+    }
 }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-WFLZW::EncodeStatus WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeBytes
-(const WFLZW::Byte* bytes, const std::size_t amount, const WFLZW::ByteRemapper& remapper)
+template<unsigned kMaxBitSize>
+WFLZW::ClassicDecoder<kMaxBitSize>::ClassicDecoder(const WFLZW::ClassicFormat& format)
 {
-    for(std::size_t i = 0; i < amount; ++i)
-        if(encodeByte(remapper.encodeMap[bytes[i]]) == WFLZW::EncodeStatus::inputByteTooLarge)
-            return WFLZW::EncodeStatus::inputByteTooLarge;
-    return WFLZW::EncodeStatus::ok;
+    initialize(format);
 }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::finalizeEncoding()
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicDecoder<kMaxBitSize>::initialize(const WFLZW::ClassicFormat& format)
 {
-    if(!mDictionaryHasBeenReset)
-        outputIndex(mIndex);
-    outputIndex(static_cast<Index_t>(mMaxInputByteValue) + 1);
+    mFormat = format;
+    if(mFormat.maxBitSize > kMaxBitSize)
+        mFormat.maxBitSize = kMaxBitSize;
 
-    if(mOutputBufferIndex > 0 || mOutputBufferBitOffset > 0)
-    {
-        outputEncodedBytes(mOutputBuffer, mOutputBufferIndex + (mOutputBufferBitOffset > 0));
-        mOutputBufferIndex = 0;
-        mOutputBufferBitOffset = 0;
-        reset();
-    }
+    mInputBits = 0;
+    mInputBitsAmount = mSkipBitsAmount = mCodesInGroup = mHeaderBytesAmount = 0;
+    mStatus = WFLZW::DecodeStatus::inputContinues;
+    reset();
 }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::incrementOutputBufferIndex()
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicDecoder<kMaxBitSize>::reset()
 {
-    if(++mOutputBufferIndex == kOutputBufferSize)
-    {
-        outputEncodedBytes(mOutputBuffer, kOutputBufferSize);
-        mOutputBufferIndex = 0;
-    }
+    mEntriesAmount = firstEntryIndex();
+    mBitSize = mFormat.minBitSize;
+    mPrevCode = kNoCode;
 }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::outputByte
-(WFLZW::Byte byte, unsigned bits)
+// The flags byte of the header gives the maximum code width and whether the clear code is used.
+template<unsigned kMaxBitSize>
+bool WFLZW::ClassicDecoder<kMaxBitSize>::readHeader()
+{
+    const unsigned maxBitSize = mHeader[2] & 0x1FU;
+    if(mHeader[0] != 0x1F || mHeader[1] != 0x9D || maxBitSize < mFormat.minBitSize ||
+       maxBitSize > kMaxBitSize)
+        return false;
+
+    mFormat.maxBitSize = maxBitSize;
+    mFormat.hasClearCode = ((mHeader[2] & 0x80U) != 0);
+    reset();
+    return true;
+}
+
+template<unsigned kMaxBitSize>
+WFLZW::DecodeStatus WFLZW::ClassicDecoder<kMaxBitSize>::decodeBytes
+(const WFLZW::Byte* bytes, std::size_t amount)
 {
-    if(mOutputBufferBitOffset == 0)
+    if(mStatus != WFLZW::DecodeStatus::inputContinues)
+        return mStatus;
+
+    std::size_t i = 0;
+    if(mFormat.compressHeader && mHeaderBytesAmount < 3)
     {
-        mOutputBuffer[mOutputBufferIndex] = byte;
-        if(bits == 8) incrementOutputBufferIndex();
-        else mOutputBufferBitOffset += bits;
+        while(mHeaderBytesAmount < 3 && i < amount)
+            mHeader[mHeaderBytesAmount++] = bytes[i++];
+        if(mHeaderBytesAmount == 3 && !readHeader())
+            return mStatus = WFLZW::DecodeStatus::inputError;
     }
-    else if(mOutputBufferBitOffset + bits <= 8)
+
+    const bool lsbFirst = (mFormat.bitOrder == WFLZW::BitOrder::lsbFirst);
+
+    for(; i < amount; ++i)
     {
-        mOutputBuffer[mOutputBufferIndex] |= (byte << mOutputBufferBitOffset);
-        if((mOutputBufferBitOffset += bits) == 8)
+        if(lsbFirst)
+            mInputBits |= static_cast<std::uint64_t>(bytes[i]) << mInputBitsAmount;
+        else
+            mInputBits = (mInputBits << 8) | bytes[i];
+        mInputBitsAmount += 8;
+
+        while(true)
         {
-            incrementOutputBufferIndex();
-            mOutputBufferBitOffset = 0;
+            if(mSkipBitsAmount > 0)
+            {
+                const unsigned skipAmount = std::min(mSkipBitsAmount, mInputBitsAmount);
+                if(lsbFirst) mInputBits >>= skipAmount;
+                mInputBitsAmount -= skipAmount;
+                mSkipBitsAmount -= skipAmount;
+                if(mSkipBitsAmount > 0) break;
+            }
+
+            if(mInputBitsAmount < mBitSize) break;
+
+            const unsigned mask = (1U << mBitSize) - 1;
+            unsigned code;
+            mInputBitsAmount -= mBitSize;
+            if(lsbFirst)
+            {
+                code = static_cast<unsigned>(mInputBits) & mask;
+                mInputBits >>= mBitSize;
+            }
+            else
+                code = static_cast<unsigned>(mInputBits >> mInputBitsAmount) & mask;
+
+            if(++mCodesInGroup == 8)
+                mCodesInGroup = 0;
+            if(!decodeCode(code))
+                return mStatus;
         }
     }
-    else
+
+    return mStatus;
+}
+
+template<unsigned kMaxBitSize>
+void WFLZW::ClassicDecoder<kMaxBitSize>::skipToGroupEnd()
+{
+    if(mFormat.codeGroups && mCodesInGroup != 0)
     {
-        mOutputBuffer[mOutputBufferIndex] |= (byte << mOutputBufferBitOffset);
-        incrementOutputBufferIndex();
-        const unsigned bitsInPreviousOutputByte = 8 - mOutputBufferBitOffset;
-        mOutputBuffer[mOutputBufferIndex] = (byte >> bitsInPreviousOutputByte);
-        mOutputBufferBitOffset = (bits - bitsInPreviousOutputByte);
+        mSkipBitsAmount = (8 - mCodesInGroup) * mBitSize;
+        mCodesInGroup = 0;
     }
 }
 
-template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
-void WFLZW::Encoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::outputIndex
-(Index_t index)
+// Returns false at the end code or on invalid input, with mStatus set accordingly.
+template<unsigned kMaxBitSize>
+bool WFLZW::ClassicDecoder<kMaxBitSize>::decodeCode(unsigned code)
 {
-    if(mBitSize <= 8)
+    if(mFormat.hasClearCode && code == mFormat.rootsAmount)
+    {
+        skipToGroupEnd();
+        reset();
+        return true;
+    }
+
+    if(mFormat.hasEndCode && code == mFormat.rootsAmount + mFormat.hasClearCode)
     {
-        outputByte(static_cast<WFLZW::Byte>(index), mBitSize);
+        mStatus = WFLZW::DecodeStatus::inputDone;
+        return false;
     }
-    else if(sizeof(Index_t) == 2)
+
+    WFLZW::Byte* const end = mDecodeBuffer + kDictionaryMaxSize;
+    WFLZW::Byte* start;
+    const bool dictionaryFull = (mEntriesAmount == (1U << mFormat.maxBitSize));
+
+    if(mPrevCode == kNoCode)
     {
-        outputByte(static_cast<WFLZW::Byte>(index), 8);
-        outputByte(static_cast<WFLZW::Byte>(index >> 8), mBitSize - 8);
+        if(code >= mFormat.rootsAmount)
+        {
+            mStatus = WFLZW::DecodeStatus::inputError;
+            return false;
+        }
+        start = end - 1;
+        *start = static_cast<WFLZW::Byte>(code);
     }
-    else
+    else if(code < mEntriesAmount)
     {
-        unsigned bitSize = mBitSize;
-        while(bitSize > 8)
+        start = getString(code, end);
+        if(!dictionaryFull)
         {
-            outputByte(static_cast<WFLZW::Byte>(index), 8);
-            index >>= 8;
-            bitSize -= 8;
+            mPrefixIndices[mEntriesAmount] = static_cast<std::uint16_t>(mPrevCode);
+            mBytes[mEntriesAmount++] = *start;
         }
-        outputByte(static_cast<WFLZW::Byte>(index), bitSize);
     }
+    else if(code == mEntriesAmount && !dictionaryFull)
+    {
+        // The string of the previous code followed by its own first byte.
+        start = getString(mPrevCode, end - 1);
+        end[-1] = *start;
+        mPrefixIndices[mEntriesAmount] = static_cast<std::uint16_t>(mPrevCode);
+        mBytes[mEntriesAmount++] = *start;
+    }
+    else
+    {
+        mStatus = WFLZW::DecodeStatus::inputError;
+        return false;
+    }
+
+    mPrevCode = code;
+    outputDecodedBytes(start, static_cast<unsigned>(end - start));
+
+    if(mBitSize < mFormat.maxBitSize &&
+       mEntriesAmount + 1 + mFormat.earlyChange > (1U << mBitSize))
+    {
+        skipToGroupEnd();
+        ++mBitSize;
+    }
+
+    return true;
+}
+
+// Writes the string of code so that it ends at end, returning its start.
+template<unsigned kMaxBitSize>
+WFLZW::Byte* WFLZW::ClassicDecoder<kMaxBitSize>::getString(unsigned code, WFLZW::Byte* end) const
+{
+    const unsigned firstIndex = firstEntryIndex();
+    while(code >= firstIndex)
+    {
+        *--end = mBytes[code];
+        code = mPrefixIndices[code];
+    }
+    *--end = static_cast<WFLZW::Byte>(code);
+    return end;
 }
 
+
 template<unsigned kDictionaryMaxSize>
-WFLZW::Decoder<kDictionaryMaxSize>::Decoder
-(WFLZW::Byte maxInputByteValue)
+WFLZW::PatternSearcher<kDictionaryMaxSize>::PatternSearcher
+(const WFLZW::Byte* pattern, std::size_t patternLength,
+ WFLZW::Byte maxInputByteValue, bool enableFlush)
 {
-    initialize(maxInputByteValue);
+    createAutomaton(pattern, patternLength);
+    initialize(maxInputByteValue, enableFlush);
 }
 
 template<unsigned kDictionaryMaxSize>
-void WFLZW::Decoder<kDictionaryMaxSize>::initialize
-(WFLZW::Byte maxInputByteValue)
+void WFLZW::PatternSearcher<kDictionaryMaxSize>::initialize
+(WFLZW::Byte maxInputByteValue, bool enableFlush)
 {
-    assert(static_cast<unsigned>(maxInputByteValue) + 2 < kDictionaryMaxSize);
+    assert(static_cast<unsigned>(maxInputByteValue) + 2 + enableFlush < kDictionaryMaxSize);
     mMaxInputByteValue = maxInputByteValue;
+    mFirstEntryIndex = static_cast<unsigned>(maxInputByteValue) + 2 + enableFlush;
+    mSyncIndex = (enableFlush ? static_cast<unsigned>(maxInputByteValue) + 2 : kDictionaryMaxSize);
     mBitOffset = 0;
+    mInputBuffer = 0;
+    mOutputOffset = mMatchesAmount = 0;
+    mState = 0;
+
     const unsigned maxIndex = static_cast<unsigned>(maxInputByteValue) + 1;
     for(unsigned i = 0; i < maxIndex; ++i)
     {
-        mPrefixIndices[i] = kEmptyIndex;
-        mBytes[i] = static_cast<WFLZW::Byte>(i);
+        Entry& entry = mEntries[i];
+        entry.prefixIndex = kEmptyIndex;
+        entry.headIndex = static_cast<Index_t>(i);
+        entry.byte = entry.firstByte = static_cast<WFLZW::Byte>(i);
+        entry.length = 1;
+        entry.state = mTransitions[i];
+        entry.matchIndex = (entry.state == mPatternLength ? static_cast<Index_t>(i) : kEmptyIndex);
     }
 
     reset();
 }
 
 template<unsigned kDictionaryMaxSize>
-void WFLZW::Decoder<kDictionaryMaxSize>::reset()
+void WFLZW::PatternSearcher<kDictionaryMaxSize>::setPattern
+(const WFLZW::Byte* pattern, std::size_t patternLength)
 {
-    mEntriesAmount = static_cast<unsigned>(mMaxInputByteValue) + 2;
-    mOldIndex = kEmptyIndex;
+    createAutomaton(pattern, patternLength);
+    initialize(mMaxInputByteValue, mSyncIndex < kDictionaryMaxSize);
+}
+
+/* The automaton state is the length of the longest suffix of the data so far
+   that is a prefix of the pattern. The transitions of the full match state
+   are those of the longest proper border of the pattern.
+*/
+template<unsigned kDictionaryMaxSize>
+void WFLZW::PatternSearcher<kDictionaryMaxSize>::createAutomaton
+(const WFLZW::Byte* pattern, std::size_t patternLength)
+{
+    assert(patternLength > 0 && patternLength < 0x1000000U);
+    mPatternLength = static_cast<std::uint32_t>(patternLength);
+    mTransitions.assign((patternLength + 1) * 256, 0);
+    mHeadBuffer.resize(patternLength);
 
-    unsigned dictSize = mEntriesAmount;
-    mBitSize = 1;
-    while((dictSize >>= 1)) ++mBitSize;
+    mTransitions[pattern[0]] = 1;
+    std::uint32_t borderState = 0;
+    for(std::uint32_t state = 1; state <= mPatternLength; ++state)
+    {
+        std::memcpy(&mTransitions[state * 256], &mTransitions[borderState * 256],
+                    256 * sizeof(std::uint32_t));
+        if(state < mPatternLength)
+        {
+            mTransitions[state * 256 + pattern[state]] = state + 1;
+            borderState = mTransitions[borderState * 256 + pattern[state]];
+        }
+    }
+}
+
+template<unsigned kDictionaryMaxSize>
+void WFLZW::PatternSearcher<kDictionaryMaxSize>::reset()
+{
+    mEntriesAmount = mFirstEntryIndex;
+    mOldIndex = kEmptyIndex;
+    mBitSize = WFLZW::bitSizeOf(mEntriesAmount);
     mMaxInputValueForCurrentBitSize = (1U << mBitSize) - 1;
 }
 
 template<unsigned kDictionaryMaxSize>
-WFLZW::DecodeStatus WFLZW::Decoder<kDictionaryMaxSize>::decodeBytes
+WFLZW::DecodeStatus WFLZW::PatternSearcher<kDictionaryMaxSize>::searchBytes
 (const WFLZW::Byte* bytes, const std::size_t amount)
 {
-    WFLZW::DecodeStatus status = WFLZW::DecodeStatus::inputContinues;
-    for(std::size_t i = 0; i < amount && status == WFLZW::DecodeStatus::inputContinues; ++i)
-        status = decodeByte(bytes[i]);
+    const WFLZW::Byte* const bytesEnd = bytes + amount;
+    while(true)
+    {
+        while(mBitOffset < mBitSize)
+        {
+            if(bytes == bytesEnd) return WFLZW::DecodeStatus::inputContinues;
+            mInputBuffer |= (static_cast<InputBuffer_t>(*bytes++) << mBitOffset);
+            mBitOffset += 8;
+        }
 
-    return status;
+        const Index_t index =
+            static_cast<Index_t>(mInputBuffer & ((InputBuffer_t(1) << mBitSize) - 1));
+        mInputBuffer >>= mBitSize;
+        mBitOffset -= mBitSize;
+
+        const WFLZW::DecodeStatus status = searchIndex(index);
+        if(status != WFLZW::DecodeStatus::inputContinues) return status;
+    }
 }
 
+// The same as WFLZW::Decoder::decodeIndex(), except for the string handling.
 template<unsigned kDictionaryMaxSize>
-WFLZW::DecodeStatus WFLZW::Decoder<kDictionaryMaxSize>::decodeByte
-(WFLZW::Byte byte)
+WFLZW::DecodeStatus WFLZW::PatternSearcher<kDictionaryMaxSize>::searchIndex(Index_t index)
 {
-    const Index_t value = static_cast<Index_t>(byte);
-
-    if(mBitOffset == 0) mInputBuffer = value;
-    else mInputBuffer |= (value << mBitOffset);
-
-    const unsigned newBitOffset = mBitOffset + 8;
+    if(index > mEntriesAmount)
+        return WFLZW::DecodeStatus::inputError;
 
-    const unsigned kIndexBits = sizeof(Index_t) * 8;
-    const unsigned extraBitsAmount = (newBitOffset > kIndexBits ? newBitOffset - kIndexBits : 0);
-    const Index_t extraBits =
-        (newBitOffset > kIndexBits ? value >> (kIndexBits - mBitOffset) : 0);
+    if(index == static_cast<Index_t>(mMaxInputByteValue) + 1)
+    {
+        mInputBuffer = 0;
+        mBitOffset = 0;
+        mOldIndex = kEmptyIndex;
+        mState = 0;
+        return WFLZW::DecodeStatus::inputDone;
+    }
 
-    mBitOffset += 8;
+    if(index == mSyncIndex)
+    {
+        const unsigned paddingBits = mBitOffset % 8;
+        mInputBuffer >>= paddingBits;
+        mBitOffset -= paddingBits;
+        mOldIndex = kEmptyIndex;
+        return WFLZW::DecodeStatus::inputContinues;
+    }
 
-    while(mBitOffset >= mBitSize)
+    if(index < mEntriesAmount)
     {
-        const Index_t index = (mInputBuffer & static_cast<Index_t>((1U << mBitSize) - 1));
-        mBitOffset -= mBitSize;
-        mInputBuffer >>= mBitSize;
-        if(extraBitsAmount > 0)
-        {
-            if(mBitOffset == extraBitsAmount)
-                mInputBuffer = extraBits;
-            else if(mBitOffset > extraBitsAmount)
-                mInputBuffer |= (extraBits << (mBitOffset - extraBitsAmount));
-            else
-                mInputBuffer |= (extraBits >> (extraBitsAmount - mBitOffset));
-        }
+        if(mOldIndex != kEmptyIndex)
+            addToDictionary(mOldIndex, mEntries[index].firstByte);
+    }
+    else
+    {
+        if(mOldIndex == kEmptyIndex)
+            return WFLZW::DecodeStatus::inputError;
+        addToDictionary(mOldIndex, mEntries[mOldIndex].firstByte);
+    }
+    searchString(index);
+    mOldIndex = index;
 
-        const WFLZW::DecodeStatus status = decodeIndex(index);
-        if(status != WFLZW::DecodeStatus::inputContinues) return status;
+    if(mEntriesAmount == kDictionaryMaxSize)
+        reset();
+    else if(mEntriesAmount == mMaxInputValueForCurrentBitSize &&
+            mEntriesAmount < kDictionaryMaxSize - 1)
+    {
+        ++mBitSize;
+        mMaxInputValueForCurrentBitSize = (1U << mBitSize) - 1;
     }
 
     return WFLZW::DecodeStatus::inputContinues;
 }
 
+/* With a partial match pending, the start of the string (its head entry, of
+   at most the pattern length) is matched byte by byte, both from the current
+   state and from the initial state. Once the two states are the same, so are
+   the rest of the states, and the occurrences that end later in the string
+   are those of the string on its own.
+*/
 template<unsigned kDictionaryMaxSize>
-WFLZW::Byte WFLZW::Decoder<kDictionaryMaxSize>::extractAndOutputStringAt(Index_t index)
+void WFLZW::PatternSearcher<kDictionaryMaxSize>::searchString(Index_t index)
 {
-    WFLZW::Byte* endOfBuffer = mDecodeBuffer + kDictionaryMaxSize;
-    WFLZW::Byte* decodedString = endOfBuffer;
+    const Entry& entry = mEntries[index];
+    std::uint32_t matchedLength = 0;
 
-    while(index != kEmptyIndex)
+    if(mState != 0)
     {
-        *(--decodedString) = mBytes[index];
-        index = mPrefixIndices[index];
+        const std::uint32_t headLength = mEntries[entry.headIndex].length;
+        WFLZW::Byte* headBytes = mHeadBuffer.data() + headLength;
+        for(Index_t i = entry.headIndex; i != kEmptyIndex; i = mEntries[i].prefixIndex)
+            *--headBytes = mEntries[i].byte;
+
+        std::uint32_t state = mState, stateFromStart = 0;
+        while(matchedLength < headLength)
+        {
+            const WFLZW::Byte byte = headBytes[matchedLength++];
+            state = mTransitions[state * 256 + byte];
+            stateFromStart = mTransitions[stateFromStart * 256 + byte];
+            if(state == mPatternLength)
+            {
+                ++mMatchesAmount;
+                outputMatch(mOutputOffset + matchedLength - mPatternLength);
+            }
+            if(state == stateFromStart) break;
+        }
+
+        if(state != stateFromStart)
+        {
+            // The whole string, which is shorter than the pattern, was matched.
+            assert(matchedLength == entry.length);
+            mState = state;
+            mOutputOffset += entry.length;
+            return;
+        }
     }
 
-    const WFLZW::Byte firstByte = *decodedString;
-    outputDecodedBytes(decodedString, endOfBuffer - decodedString);
-    return firstByte;
+    mMatchLengths.clear();
+    for(Index_t i = entry.matchIndex; i != kEmptyIndex && mEntries[i].length > matchedLength;)
+    {
+        mMatchLengths.push_back(mEntries[i].length);
+        const Index_t prefixIndex = mEntries[i].prefixIndex;
+        i = (prefixIndex == kEmptyIndex ? kEmptyIndex : mEntries[prefixIndex].matchIndex);
+    }
+
+    mMatchesAmount += mMatchLengths.size();
+    for(std::size_t i = mMatchLengths.size(); i > 0; --i)
+        outputMatch(mOutputOffset + mMatchLengths[i - 1] - mPatternLength);
+
+    mState = entry.state;
+    mOutputOffset += entry.length;
 }
 
 template<unsigned kDictionaryMaxSize>
-void WFLZW::Decoder<kDictionaryMaxSize>::addToDictionary(Index_t prefixIndex, WFLZW::Byte byteValue)
+void WFLZW::PatternSearcher<kDictionaryMaxSize>::addToDictionary
+(Index_t prefixIndex, WFLZW::Byte byteValue)
 {
-    mPrefixIndices[mEntriesAmount] = prefixIndex;
-    mBytes[mEntriesAmount] = byteValue;
+    const Entry& prefix = mEntries[prefixIndex];
+    Entry& entry = mEntries[mEntriesAmount];
+    const Index_t entryIndex = static_cast<Index_t>(mEntriesAmount);
+    entry.prefixIndex = prefixIndex;
+    entry.byte = byteValue;
+    entry.firstByte = prefix.firstByte;
+    entry.length = prefix.length + 1;
+    entry.state = mTransitions[prefix.state * 256 + byteValue];
+    entry.matchIndex = (entry.state == mPatternLength ? entryIndex : prefix.matchIndex);
+    entry.headIndex = (entry.length <= mPatternLength ? entryIndex : prefix.headIndex);
     ++mEntriesAmount;
 }
 
-template<unsigned kDictionaryMaxSize>
-WFLZW::DecodeStatus WFLZW::Decoder<kDictionaryMaxSize>::decodeIndex(Index_t index)
+
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::VerifyingEncoder
+(WFLZW::Byte maxInputByteValue, bool enableFlush):
+    Base(maxInputByteValue, enableFlush)
 {
-    if(index >= kDictionaryMaxSize)
-        return WFLZW::DecodeStatus::inputError;
+    initialize(maxInputByteValue, enableFlush);
+}
 
-    if(index == static_cast<Index_t>(mMaxInputByteValue) + 1)
-        return WFLZW::DecodeStatus::inputDone;
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+void WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::initialize
+(WFLZW::Byte maxInputByteValue, bool enableFlush)
+{
+    Base::initialize(maxInputByteValue, enableFlush);
+    for(unsigned byte = 0; byte <= maxInputByteValue; ++byte)
+        mShadowEntries[byte] = ShadowEntry { 1, 0, WFLZW::Byte(byte) };
+    mFirstEntryIndex = static_cast<unsigned>(maxInputByteValue) + 2 + enableFlush;
+    resetShadowDictionary();
+    Base::codeLog().clear();
+    mInput.clear();
+    mFailed = false;
+}
 
-    if(index < mEntriesAmount)
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+void WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::resetShadowDictionary()
+{
+    mShadowEntriesAmount = mFirstEntryIndex;
+    mOldIndex = kEmptyIndex;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeBytes
+(const WFLZW::Byte* bytes, const std::size_t amount)
+{
+    return addInput(bytes, amount, nullptr);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeBytes
+(const WFLZW::Byte* bytes, const std::size_t amount, const WFLZW::ByteRemapper& remapper)
+{
+    return addInput(bytes, amount, remapper.encodeMap);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeByte
+(WFLZW::Byte byte)
+{
+    return addInput(&byte, 1, nullptr);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::encodeByte
+(WFLZW::Byte byte, const WFLZW::ByteRemapper& remapper)
+{
+    return addInput(&byte, 1, remapper.encodeMap);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::flush()
+{
+    if(mFailed) return WFLZW::EncodeStatus::verificationFailed;
+    Base::flush();
+    return verifyAllInput();
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus
+WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::finalizeMessage()
+{
+    if(mFailed) return WFLZW::EncodeStatus::verificationFailed;
+    Base::finalizeMessage();
+    return verifyAllInput();
+}
+
+// The shadow decoder starts the next stream from scratch, like a new decoder would.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus
+WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::finalizeEncoding()
+{
+    if(mFailed) return WFLZW::EncodeStatus::verificationFailed;
+    Base::finalizeEncoding();
+    const WFLZW::EncodeStatus status = verifyAllInput();
+    resetShadowDictionary();
+    return status;
+}
+
+/* The bytes are mapped with encodeMap if it's not null, and encoded from
+   mInput, a chunk at a time. A byte that's too large ends the chunk, so that
+   the bytes before it are encoded and verified as with WFLZW::Encoder.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::addInput
+(const WFLZW::Byte* bytes, const std::size_t amount, const WFLZW::Byte* encodeMap)
+{
+    if(mFailed) return WFLZW::EncodeStatus::verificationFailed;
+
+    const WFLZW::Byte maxInputByteValue = Base::maxByteValue();
+
+    for(std::size_t index = 0; index < amount;)
     {
-        mOldFirstByte = extractAndOutputStringAt(index);
-        if(mOldIndex != kEmptyIndex)
-            addToDictionary(mOldIndex, mOldFirstByte);
-        mOldIndex = index;
+        const std::size_t chunkSize = std::min(amount - index, std::size_t(kChunkSize));
+        const std::size_t chunkStart = mInput.size();
+        mInput.resize(chunkStart + chunkSize);
+        WFLZW::Byte* chunk = mInput.data() + chunkStart;
+
+        std::size_t i = 0;
+        for(; i < chunkSize; ++i)
+        {
+            const WFLZW::Byte byte = (encodeMap ? encodeMap[bytes[index + i]] : bytes[index + i]);
+            if(byte > maxInputByteValue) break;
+            chunk[i] = byte;
+        }
+        mInput.resize(chunkStart + i);
+
+        Base::encodeBytes(mInput.data() + chunkStart, i);
+        if(!verifyCodes()) return WFLZW::EncodeStatus::verificationFailed;
+        if(i < chunkSize) return WFLZW::EncodeStatus::inputByteTooLarge;
+        index += chunkSize;
     }
-    else
+
+    return WFLZW::EncodeStatus::ok;
+}
+
+/* Decodes the codes output since the last call, and removes the input they
+   matched. What's left is the current string of the encoder.
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+bool WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::verifyCodes()
+{
+    const WFLZW::Byte* input = mInput.data();
+    const WFLZW::Byte* const inputEnd = input + mInput.size();
+
+    for(const Index_t code: Base::codeLog())
     {
-        const Index_t newIndex = static_cast<Index_t>(mEntriesAmount);
-        addToDictionary(mOldIndex, mOldFirstByte);
-        mOldFirstByte = extractAndOutputStringAt(newIndex);
-        mOldIndex = newIndex;
+        if(!verifyCode(code, input, inputEnd))
+        {
+            mFailed = true;
+            return false;
+        }
     }
 
-    if(mEntriesAmount == kDictionaryMaxSize)
+    Base::codeLog().clear();
+    mInput.erase(mInput.begin(), mInput.begin() + (input - mInput.data()));
+    return true;
+}
+
+/* The same as WFLZW::Decoder::decodeIndex(), except that the string is
+   compared with the input, which is then advanced past it. Like
+   WFLZW::PatternSearcher::searchIndex(), this has to be kept in sync with
+   decodeIndex().
+*/
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+bool WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::verifyCode
+(Index_t index, const WFLZW::Byte*& input, const WFLZW::Byte* inputEnd)
+{
+    if(index > mShadowEntriesAmount)
+        return false;
+
+    // The end and sync codes.
+    if(index > Base::maxByteValue() && index < mFirstEntryIndex)
     {
-        reset();
+        mOldIndex = kEmptyIndex;
+        return true;
     }
-    else if(mEntriesAmount == mMaxInputValueForCurrentBitSize &&
-            mEntriesAmount < kDictionaryMaxSize - 1)
+
+    if(index == mShadowEntriesAmount)
     {
-        ++mBitSize;
-        mMaxInputValueForCurrentBitSize = (1U << mBitSize) - 1;
+        if(mOldIndex == kEmptyIndex)
+            return false;
+        mShadowEntries[mShadowEntriesAmount++] = ShadowEntry
+            { mShadowEntries[mOldIndex].length + 1, Index_t(mOldIndex), mOldFirstByte };
+        mOldIndex = kEmptyIndex;
     }
 
-    return WFLZW::DecodeStatus::inputContinues;
+    const std::uint32_t length = mShadowEntries[index].length;
+    if(length > static_cast<std::size_t>(inputEnd - input))
+        return false;
+
+    const WFLZW::Byte* byte = input + length;
+    for(Index_t entryIndex = index; byte != input;)
+    {
+        const ShadowEntry& entry = mShadowEntries[entryIndex];
+        if(entry.byte != *--byte)
+            return false;
+        entryIndex = entry.prefixIndex;
+    }
+
+    if(mOldIndex != kEmptyIndex)
+    {
+        mShadowEntries[mShadowEntriesAmount++] = ShadowEntry
+            { mShadowEntries[mOldIndex].length + 1, Index_t(mOldIndex), *input };
+    }
+    mOldIndex = index;
+    mOldFirstByte = *input;
+    input += length;
+
+    if(mShadowEntriesAmount == kDictionaryMaxSize)
+        resetShadowDictionary();
+    return true;
+}
+
+// After the current string has been output, all of the input has to be matched.
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictType, unsigned kOutputBufferSize>
+WFLZW::EncodeStatus
+WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictType, kOutputBufferSize>::verifyAllInput()
+{
+    if(!verifyCodes() || !mInput.empty())
+    {
+        mFailed = true;
+        return WFLZW::EncodeStatus::verificationFailed;
+    }
+    return WFLZW::EncodeStatus::ok;
 }
 
 #endif
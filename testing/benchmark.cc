@@ -73,6 +73,14 @@ class TestDecoderContainer
 };
 #endif
 
+#ifdef WFLZW_COLLECT_STATS
+namespace
+{
+    WFLZW::EncoderStats gEncoderStats;
+    WFLZW::DecoderStats gDecoderStats;
+}
+#endif
+
 static double runEncoder(unsigned iterations)
 {
     TestEncoderContainer encoder;
@@ -84,7 +92,11 @@ static double runEncoder(unsigned iterations)
         encoder.instance().encodeBytes(&gInputData[0], gInputData.size());
         encoder.instance().finalizeEncoding();
     }
-    return double(std::clock() - iClock) / double(CLOCKS_PER_SEC);
+    const double seconds = double(std::clock() - iClock) / double(CLOCKS_PER_SEC);
+#ifdef WFLZW_COLLECT_STATS
+    gEncoderStats = encoder.instance().stats();
+#endif
+    return seconds;
 }
 
 static double runEncoder(unsigned iterations, const WFLZW::ByteRemapper& remapper)
@@ -94,11 +106,15 @@ static double runEncoder(unsigned iterations, const WFLZW::ByteRemapper& remappe
     for(unsigned i = 0; i < iterations; ++i)
     {
         gEncodedData.clear();
-        encoder.instance().initialize(remapper.decodeMapSize - 1);
+        encoder.instance().initialize(remapper.maxByteValue());
         encoder.instance().encodeBytes(&gInputData[0], gInputData.size(), remapper);
         encoder.instance().finalizeEncoding();
     }
-    return double(std::clock() - iClock) / double(CLOCKS_PER_SEC);
+    const double seconds = double(std::clock() - iClock) / double(CLOCKS_PER_SEC);
+#ifdef WFLZW_COLLECT_STATS
+    gEncoderStats = encoder.instance().stats();
+#endif
+    return seconds;
 }
 
 static double runDecoder(unsigned iterations, WFLZW::Byte maxByteValue = 255)
@@ -111,7 +127,11 @@ static double runDecoder(unsigned iterations, WFLZW::Byte maxByteValue = 255)
         decoder.instance().initialize(maxByteValue);
         decoder.instance().decodeBytes(&gEncodedData[0], gEncodedData.size());
     }
-    return double(std::clock() - iClock) / double(CLOCKS_PER_SEC);
+    const double seconds = double(std::clock() - iClock) / double(CLOCKS_PER_SEC);
+#ifdef WFLZW_COLLECT_STATS
+    gDecoderStats = decoder.instance().stats();
+#endif
+    return seconds;
 }
 
 static void printSize(unsigned size)
@@ -124,16 +144,58 @@ static void printSize(unsigned size)
         std::printf("%u MB", (size + 512*1024) / (1024*1024));
 }
 
-static void runBenchmark(const char* inputFileName, unsigned iterations, bool useRemapper)
+#ifdef WFLZW_COLLECT_STATS
+static void printCodesPerBitSize(const std::uint64_t* codesPerBitSize, unsigned iterations)
+{
+    std::printf("  Codes per bit width:");
+    for(unsigned bitSize = 0; bitSize <= 32; ++bitSize)
+        if(codesPerBitSize[bitSize])
+            std::printf(" %u:%llu", bitSize,
+                        (unsigned long long)(codesPerBitSize[bitSize] / iterations));
+    std::printf("\n");
+}
+
+// The statistics have been accumulated over all the iterations.
+static void printStats(unsigned iterations)
+{
+    const WFLZW::EncoderStats& encoderStats = gEncoderStats;
+    const WFLZW::DecoderStats& decoderStats = gDecoderStats;
+
+    std::printf("Encoder statistics (per iteration):\n");
+    printCodesPerBitSize(encoderStats.codesPerBitSize, iterations);
+    std::printf
+        ("  Dictionary resets: %llu\n"
+         "  Average match length: %.2f bytes\n"
+         "  Average dictionary probe depth: %.2f\n"
+         "  Output callbacks: %llu\n",
+         (unsigned long long)(encoderStats.dictionaryResets / iterations),
+         encoderStats.averageMatchLength(), encoderStats.averageProbeDepth(),
+         (unsigned long long)(encoderStats.outputCallbacks / iterations));
+
+    std::printf("Decoder statistics (per iteration):\n");
+    printCodesPerBitSize(decoderStats.codesPerBitSize, iterations);
+    std::printf
+        ("  Dictionary resets: %llu\n"
+         "  Average string chain length: %.2f\n"
+         "  Longest string chain: %llu\n"
+         "  Output callbacks: %llu\n",
+         (unsigned long long)(decoderStats.dictionaryResets / iterations),
+         decoderStats.averageChainLength(), (unsigned long long)decoderStats.longestChain,
+         (unsigned long long)(decoderStats.outputCallbacks / iterations));
+}
+#endif
+
+static void runBenchmark(const char* inputFileName, unsigned iterations, bool useRemapper,
+                         WFLZW::RootOrder rootOrder)
 {
     WFLZW::ByteRemapper remapper;
     double encodeTime = 0, decodeTime = 0;
 
     if(useRemapper)
     {
-        remapper.createEncodeMapFromInputBytes(&gInputData[0], gInputData.size());
+        remapper.createEncodeMapFromInputBytes(&gInputData[0], gInputData.size(), rootOrder);
         encodeTime = runEncoder(iterations, remapper);
-        decodeTime = runDecoder(iterations, remapper.decodeMapSize - 1);
+        decodeTime = runDecoder(iterations, remapper.maxByteValue());
         remapper.decodeBytes(&gDecodedData[0], gDecodedData.size());
     }
     else
@@ -160,7 +222,8 @@ static void runBenchmark(const char* inputFileName, unsigned iterations, bool us
         (" (dictionary type: " STRINGIFY(WFLZW_DICT_TYPE) ")\n"
          "Input file size: %zu bytes\n", gInputData.size());
     if(useRemapper)
-        std::printf("Using byte remapping; number of distinct bytes: %u\n",
+        std::printf("Using byte remapping%s; number of distinct bytes: %u\n",
+                    rootOrder == WFLZW::RootOrder::frequency ? " by frequency" : "",
                     remapper.decodeMapSize);
     std::printf
         ("Compressed size: %zu bytes (%.1f%%)\n"
@@ -172,6 +235,10 @@ static void runBenchmark(const char* inputFileName, unsigned iterations, bool us
          gInputData.size() * double(iterations) / (1048576.0 * encodeTime),
          iterations, decodeTime*1000.0 / iterations,
          gEncodedData.size() * double(iterations) / (1048576.0 * decodeTime));
+
+#ifdef WFLZW_COLLECT_STATS
+    printStats(iterations);
+#endif
 }
 
 int main(int argc, char* argv[])
@@ -179,6 +246,7 @@ int main(int argc, char* argv[])
     const char* inputFileName = nullptr;
     unsigned iterations = 100;
     bool useRemapper = false;
+    WFLZW::RootOrder rootOrder = WFLZW::RootOrder::byteValue;
 
     for(int i = 1; i < argc; ++i)
     {
@@ -191,6 +259,11 @@ int main(int argc, char* argv[])
         }
         else if(std::strcmp(argv[i], "-remapBytes") == 0)
             useRemapper = true;
+        else if(std::strcmp(argv[i], "-remapBytesByFrequency") == 0)
+        {
+            useRemapper = true;
+            rootOrder = WFLZW::RootOrder::frequency;
+        }
         else
             inputFileName = argv[i];
     }
@@ -201,13 +274,15 @@ int main(int argc, char* argv[])
             ("Usage: benchmark [<options>] <input file>\n\n"
              "<options>:\n"
              " -iterations <amount> : Run the encoder and decoder this many times (default: 100)\n"
-             " -remapBytes : Use the byte remapper\n\n"
+             " -remapBytes : Use the byte remapper\n"
+             " -remapBytesByFrequency : Use the byte remapper, most common bytes first\n\n"
              "You can compile the benchmark program specifying the WFLZW_DICT_SIZE\n"
              "preprocessor macro with a maximum dictionary size to use some value\n"
              "other than the default (which is 65536). For example:\n"
              "  g++ -O3 -DWFLZW_DICT_SIZE=16384 benchmark.cc -o benchmark\n\n"
              "Likewise you can specify the preprocessor macro WFLZW_DICT_TYPE=list\n"
-             "to use the list dictionary type instead of the tree type.\n");
+             "to use the list dictionary type instead of the tree type.\n\n"
+             "Defining WFLZW_COLLECT_STATS prints encoder and decoder statistics as well.\n");
         return 0;
     }
 
@@ -223,5 +298,5 @@ int main(int argc, char* argv[])
     gEncodedData.reserve(gInputData.size());
     gDecodedData.reserve(gInputData.size());
 
-    runBenchmark(inputFileName, iterations, useRemapper);
+    runBenchmark(inputFileName, iterations, useRemapper, rootOrder);
 }
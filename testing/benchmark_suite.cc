@@ -0,0 +1,448 @@
+#include "../WFLZW.hh"
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace
+{
+    enum class OutputFormat { table, json, csv };
+
+    struct Corpus
+    {
+        std::string name;
+        std::vector<WFLZW::Byte> data;
+    };
+
+    struct Timing
+    {
+        double medianSeconds, p99Seconds;
+    };
+
+    struct Result
+    {
+        const Corpus* corpus;
+        unsigned dictionarySize;
+        const char* dictionaryType;
+        std::size_t encoderSize, decoderSize, compressedSize;
+        Timing encodeTiming, decodeTiming;
+    };
+
+    struct Options
+    {
+        unsigned iterations = 20, warmupIterations = 2;
+        OutputFormat outputFormat = OutputFormat::table;
+        bool useSyntheticCorpora = true;
+    };
+
+    std::vector<WFLZW::Byte> gEncodedData, gDecodedData;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictionaryType>
+class BenchmarkEncoder: public WFLZW::Encoder<kDictionaryMaxSize, kDictionaryType>
+{
+ public:
+    virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+    {
+        gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+    }
+};
+
+template<unsigned kDictionaryMaxSize>
+class BenchmarkDecoder: public WFLZW::Decoder<kDictionaryMaxSize>
+{
+ public:
+    virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
+    {
+        gDecodedData.insert(gDecodedData.end(), bytes, bytes + amount);
+    }
+};
+
+
+//============================================================================
+// Corpora
+//============================================================================
+static bool readFile(const std::string& fileName, std::vector<Corpus>& corpora)
+{
+    std::FILE* inputFile = std::fopen(fileName.c_str(), "rb");
+    if(!inputFile) { std::perror(fileName.c_str()); return false; }
+    std::fseek(inputFile, 0, SEEK_END);
+    const long fileSize = std::ftell(inputFile);
+    std::fseek(inputFile, 0, SEEK_SET);
+
+    Corpus corpus;
+    corpus.name = fileName;
+    corpus.data.resize(fileSize);
+    const std::size_t bytesRead = std::fread(corpus.data.data(), 1, corpus.data.size(), inputFile);
+    std::fclose(inputFile);
+
+    if(bytesRead != corpus.data.size())
+    { std::fprintf(stderr, "Error reading %s\n", fileName.c_str()); return false; }
+
+    if(!corpus.data.empty())
+        corpora.push_back(std::move(corpus));
+    return true;
+}
+
+static bool readFileOrDirectory(const std::string& path, std::vector<Corpus>& corpora)
+{
+    struct stat pathInfo;
+    if(stat(path.c_str(), &pathInfo) != 0) { std::perror(path.c_str()); return false; }
+    if(!S_ISDIR(pathInfo.st_mode)) return readFile(path, corpora);
+
+    DIR* directory = opendir(path.c_str());
+    if(!directory) { std::perror(path.c_str()); return false; }
+
+    std::vector<std::string> fileNames;
+    while(const dirent* entry = readdir(directory))
+    {
+        const std::string fileName = path + "/" + entry->d_name;
+        if(entry->d_name[0] != '.' && stat(fileName.c_str(), &pathInfo) == 0 &&
+           S_ISREG(pathInfo.st_mode))
+            fileNames.push_back(fileName);
+    }
+    closedir(directory);
+
+    std::sort(fileNames.begin(), fileNames.end());
+    for(const auto& fileName: fileNames)
+        if(!readFile(fileName, corpora))
+            return false;
+    return true;
+}
+
+/* The synthetic corpora are generated with a fixed seed, so that they are the
+   same on every run.
+*/
+static void addSyntheticCorpora(std::vector<Corpus>& corpora)
+{
+    const std::size_t kCorpusSize = 1 << 20;
+    std::mt19937 rngEngine(0);
+
+    Corpus random { "synthetic:random", {} };
+    std::uniform_int_distribution<unsigned> randomByte(0, 255);
+    for(std::size_t i = 0; i < kCorpusSize; ++i)
+        random.data.push_back(WFLZW::Byte(randomByte(rngEngine)));
+    corpora.push_back(std::move(random));
+
+    // Words from a fixed vocabulary, with a roughly Zipfian distribution.
+    Corpus text { "synthetic:text", {} };
+    std::vector<std::string> vocabulary;
+    std::uniform_int_distribution<unsigned> wordLength(1, 10), letter('a', 'z');
+    for(unsigned i = 0; i < 2000; ++i)
+    {
+        std::string word;
+        for(unsigned length = wordLength(rngEngine); length > 0; --length)
+            word += char(letter(rngEngine));
+        vocabulary.push_back(word);
+    }
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for(unsigned wordsInLine = 0; text.data.size() < kCorpusSize; ++wordsInLine)
+    {
+        const std::string& word =
+            vocabulary[std::size_t(std::pow(double(vocabulary.size()), uniform(rngEngine))) - 1];
+        text.data.insert(text.data.end(), word.begin(), word.end());
+        text.data.push_back(wordsInLine % 12 == 11 ? '\n' : ' ');
+    }
+    text.data.resize(kCorpusSize);
+    corpora.push_back(std::move(text));
+
+    Corpus runs { "synthetic:runs", {} };
+    std::uniform_int_distribution<unsigned> runLength(1, 64), runByte(0, 15);
+    while(runs.data.size() < kCorpusSize)
+        runs.data.insert(runs.data.end(), runLength(rngEngine), WFLZW::Byte(runByte(rngEngine)));
+    runs.data.resize(kCorpusSize);
+    corpora.push_back(std::move(runs));
+
+    Corpus records { "synthetic:records", {} };
+    std::uniform_int_distribution<unsigned> randomValue(0, 99999), randomStatus(0, 3);
+    static const char* const kStatuses[] = { "active", "inactive", "pending", "deleted" };
+    char line[256];
+    for(unsigned id = 0; records.data.size() < kCorpusSize; ++id)
+    {
+        const int length = std::snprintf
+            (line, sizeof(line), "{\"id\":%u,\"user\":\"user%05u\",\"value\":%u,\"status\":\"%s\"}\n",
+             id, randomValue(rngEngine), randomValue(rngEngine), kStatuses[randomStatus(rngEngine)]);
+        records.data.insert(records.data.end(), line, line + length);
+    }
+    records.data.resize(kCorpusSize);
+    corpora.push_back(std::move(records));
+}
+
+
+//============================================================================
+// Measuring
+//============================================================================
+template<typename Function_t>
+static Timing measure(const Options& options, Function_t function)
+{
+    for(unsigned i = 0; i < options.warmupIterations; ++i)
+        function();
+
+    std::vector<double> seconds;
+    for(unsigned i = 0; i < options.iterations; ++i)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        function();
+        const auto endTime = std::chrono::steady_clock::now();
+        seconds.push_back(std::chrono::duration<double>(endTime - startTime).count());
+    }
+
+    std::sort(seconds.begin(), seconds.end());
+    const std::size_t p99Index = (seconds.size() * 99 + 99) / 100 - 1;
+    return Timing { seconds[seconds.size() / 2], seconds[p99Index] };
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictionaryType>
+static bool runConfiguration(const Options& options, const Corpus& corpus,
+                             std::vector<Result>& results)
+{
+    using Encoder = BenchmarkEncoder<kDictionaryMaxSize, kDictionaryType>;
+    using Decoder = BenchmarkDecoder<kDictionaryMaxSize>;
+    std::unique_ptr<Encoder> encoder(new Encoder);
+    std::unique_ptr<Decoder> decoder(new Decoder);
+
+    gEncodedData.reserve(corpus.data.size() + corpus.data.size() / 2);
+    gDecodedData.reserve(corpus.data.size());
+
+    Result result;
+    result.corpus = &corpus;
+    result.dictionarySize = kDictionaryMaxSize;
+    result.dictionaryType = (kDictionaryType == WFLZW::DictionaryType::list ? "list" : "tree");
+    result.encoderSize = sizeof(Encoder);
+    result.decoderSize = sizeof(Decoder);
+
+    result.encodeTiming = measure
+        (options, [&]()
+         {
+             gEncodedData.clear();
+             encoder->initialize();
+             encoder->encodeBytes(corpus.data.data(), corpus.data.size());
+             encoder->finalizeEncoding();
+         });
+    result.compressedSize = gEncodedData.size();
+
+    result.decodeTiming = measure
+        (options, [&]()
+         {
+             gDecodedData.clear();
+             decoder->initialize();
+             decoder->decodeBytes(gEncodedData.data(), gEncodedData.size());
+         });
+
+    if(gDecodedData != corpus.data)
+    {
+        std::fprintf(stderr, "FATAL ERROR: Decoded data is not equal to the input data! "
+                     "(%s, dictionary size %u, %s)\n",
+                     corpus.name.c_str(), kDictionaryMaxSize, result.dictionaryType);
+        return false;
+    }
+
+    results.push_back(result);
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+static bool runDictionarySize(const Options& options, const Corpus& corpus,
+                              std::vector<Result>& results)
+{
+    return runConfiguration<kDictionaryMaxSize, WFLZW::DictionaryType::list>
+        (options, corpus, results) &&
+        runConfiguration<kDictionaryMaxSize, WFLZW::DictionaryType::tree>
+        (options, corpus, results);
+}
+
+static bool runAllConfigurations(const Options& options, const Corpus& corpus,
+                                 std::vector<Result>& results)
+{
+    return runDictionarySize<1024>(options, corpus, results) &&
+        runDictionarySize<2048>(options, corpus, results) &&
+        runDictionarySize<4096>(options, corpus, results) &&
+        runDictionarySize<8192>(options, corpus, results) &&
+        runDictionarySize<16384>(options, corpus, results) &&
+        runDictionarySize<32768>(options, corpus, results) &&
+        runDictionarySize<65536>(options, corpus, results) &&
+        runDictionarySize<131072>(options, corpus, results) &&
+        runDictionarySize<262144>(options, corpus, results);
+}
+
+
+//============================================================================
+// Output
+//============================================================================
+static double megabytesPerSecond(std::size_t bytes, double seconds)
+{
+    return double(bytes) / (1048576.0 * seconds);
+}
+
+static std::string jsonEscaped(const std::string& str)
+{
+    std::string result;
+    for(const char c: str)
+    {
+        if(c == '"' || c == '\\') { result += '\\'; result += c; }
+        else if(static_cast<unsigned char>(c) < 0x20) result += ' ';
+        else result += c;
+    }
+    return result;
+}
+
+static void printTable(const std::vector<Result>& results)
+{
+    const Corpus* currentCorpus = nullptr;
+    for(const Result& result: results)
+    {
+        if(result.corpus != currentCorpus)
+        {
+            currentCorpus = result.corpus;
+            std::printf
+                ("\n%s, %zu bytes\n"
+                 "| Dictionary size | Dictionary type | Size of encoder | Size of decoder "
+                 "| Compressed data size | %% of original | Compression time (median / p99) "
+                 "| Compression speed | Decompression time (median / p99) "
+                 "| Decompression speed |\n"
+                 "|:---:|:---:|:---:|:---:|:---:|:---:|:---:|:---:|:---:|:---:|\n",
+                 currentCorpus->name.c_str(), currentCorpus->data.size());
+        }
+
+        std::printf
+            ("| %u | %s | %zu kB | %zu kB | %zu | %.1f%% | %.2f / %.2f ms | %.1f MB/s "
+             "| %.2f / %.2f ms | %.1f MB/s |\n",
+             result.dictionarySize, result.dictionaryType,
+             (result.encoderSize + 512) / 1024, (result.decoderSize + 512) / 1024,
+             result.compressedSize,
+             double(result.compressedSize) * 100.0 / double(result.corpus->data.size()),
+             result.encodeTiming.medianSeconds * 1000.0, result.encodeTiming.p99Seconds * 1000.0,
+             megabytesPerSecond(result.corpus->data.size(), result.encodeTiming.medianSeconds),
+             result.decodeTiming.medianSeconds * 1000.0, result.decodeTiming.p99Seconds * 1000.0,
+             megabytesPerSecond(result.corpus->data.size(), result.decodeTiming.medianSeconds));
+    }
+}
+
+static void printCSV(const std::vector<Result>& results)
+{
+    std::printf("corpus,input_size,dictionary_size,dictionary_type,encoder_size,decoder_size,"
+                "compressed_size,encode_median_ms,encode_p99_ms,encode_mb_per_s,"
+                "decode_median_ms,decode_p99_ms,decode_mb_per_s\n");
+
+    for(const Result& result: results)
+    {
+        std::string corpusName = result.corpus->name;
+        std::replace(corpusName.begin(), corpusName.end(), ',', '_');
+        std::printf
+            ("%s,%zu,%u,%s,%zu,%zu,%zu,%.4f,%.4f,%.2f,%.4f,%.4f,%.2f\n",
+             corpusName.c_str(), result.corpus->data.size(),
+             result.dictionarySize, result.dictionaryType,
+             result.encoderSize, result.decoderSize, result.compressedSize,
+             result.encodeTiming.medianSeconds * 1000.0, result.encodeTiming.p99Seconds * 1000.0,
+             megabytesPerSecond(result.corpus->data.size(), result.encodeTiming.medianSeconds),
+             result.decodeTiming.medianSeconds * 1000.0, result.decodeTiming.p99Seconds * 1000.0,
+             megabytesPerSecond(result.corpus->data.size(), result.decodeTiming.medianSeconds));
+    }
+}
+
+static void printJSON(const Options& options, const std::vector<Result>& results)
+{
+    std::printf("{\n  \"version\": \"%s\",\n  \"iterations\": %u,\n  \"warmup_iterations\": %u,\n"
+                "  \"results\": [",
+                WFLZW_VERSION_STRING, options.iterations, options.warmupIterations);
+
+    for(std::size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& result = results[i];
+        std::printf
+            ("%s\n    { \"corpus\": \"%s\", \"input_size\": %zu, \"dictionary_size\": %u, "
+             "\"dictionary_type\": \"%s\", \"encoder_size\": %zu, \"decoder_size\": %zu, "
+             "\"compressed_size\": %zu, "
+             "\"encode_median_ms\": %.4f, \"encode_p99_ms\": %.4f, \"encode_mb_per_s\": %.2f, "
+             "\"decode_median_ms\": %.4f, \"decode_p99_ms\": %.4f, \"decode_mb_per_s\": %.2f }",
+             i > 0 ? "," : "", jsonEscaped(result.corpus->name).c_str(),
+             result.corpus->data.size(), result.dictionarySize, result.dictionaryType,
+             result.encoderSize, result.decoderSize, result.compressedSize,
+             result.encodeTiming.medianSeconds * 1000.0, result.encodeTiming.p99Seconds * 1000.0,
+             megabytesPerSecond(result.corpus->data.size(), result.encodeTiming.medianSeconds),
+             result.decodeTiming.medianSeconds * 1000.0, result.decodeTiming.p99Seconds * 1000.0,
+             megabytesPerSecond(result.corpus->data.size(), result.decodeTiming.medianSeconds));
+    }
+
+    std::printf("\n  ]\n}\n");
+}
+
+
+//============================================================================
+// main
+//============================================================================
+static void printUsage()
+{
+    std::printf
+        ("Usage: benchmark_suite [<options>] [<file or directory> ...]\n\n"
+         "Compresses and decompresses each given file (and each regular file in each\n"
+         "given directory), as well as a set of generated synthetic corpora, with every\n"
+         "dictionary size from 1024 to 262144 using both dictionary types.\n\n"
+         "<options>:\n"
+         " -iterations <amount> : Timed runs per measurement (default: 20)\n"
+         " -warmup <amount> : Untimed runs before each measurement (default: 2)\n"
+         " -format <table|json|csv> : Output format (default: table)\n"
+         " -noSynthetic : Don't include the synthetic corpora\n");
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    std::vector<Corpus> corpora;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strcmp(argv[i], "-iterations") == 0 || std::strcmp(argv[i], "-warmup") == 0)
+        {
+            if(i + 1 == argc)
+            { std::printf("Error: expecting parameter after %s\n", argv[i]); return 1; }
+            const int value = std::atoi(argv[i + 1]);
+            if(argv[i][1] == 'i') options.iterations = (value < 1 ? 1 : value);
+            else options.warmupIterations = (value < 0 ? 0 : value);
+            ++i;
+        }
+        else if(std::strcmp(argv[i], "-format") == 0)
+        {
+            if(++i == argc)
+            { std::printf("Error: expecting parameter after -format\n"); return 1; }
+            if(std::strcmp(argv[i], "table") == 0) options.outputFormat = OutputFormat::table;
+            else if(std::strcmp(argv[i], "json") == 0) options.outputFormat = OutputFormat::json;
+            else if(std::strcmp(argv[i], "csv") == 0) options.outputFormat = OutputFormat::csv;
+            else { std::printf("Error: unknown format %s\n", argv[i]); return 1; }
+        }
+        else if(std::strcmp(argv[i], "-noSynthetic") == 0)
+            options.useSyntheticCorpora = false;
+        else if(std::strcmp(argv[i], "-help") == 0 || std::strcmp(argv[i], "-h") == 0)
+        { printUsage(); return 0; }
+        else if(!readFileOrDirectory(argv[i], corpora))
+            return 1;
+    }
+
+    if(options.useSyntheticCorpora)
+        addSyntheticCorpora(corpora);
+
+    if(corpora.empty()) { printUsage(); return 0; }
+
+    std::vector<Result> results;
+    for(const Corpus& corpus: corpora)
+    {
+        std::fprintf(stderr, "Running %s\n", corpus.name.c_str());
+        if(!runAllConfigurations(options, corpus, results))
+            return 1;
+    }
+
+    switch(options.outputFormat)
+    {
+      case OutputFormat::table: printTable(results); break;
+      case OutputFormat::json: printJSON(options, results); break;
+      case OutputFormat::csv: printCSV(results); break;
+    }
+}
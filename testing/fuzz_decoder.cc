@@ -0,0 +1,472 @@
+/* Fuzz harness for the decoders.
+
+   Built with libFuzzer (clang++ -fsanitize=fuzzer,address,undefined
+   -DWFLZW_LIBFUZZER fuzz_decoder.cc) the input is generated by the fuzzer.
+   Otherwise (see the Makefile) this is a standalone program that either
+   decodes the files given as parameters (to reproduce a crash found by the
+   fuzzer), or runs its own simple mutation-based fuzzing loop starting from
+   valid compressed streams, which is best compiled with the sanitizers too.
+
+   Besides memory errors, the harness checks that WFLZW::Decoder and
+   WFLZW::DecoderStream agree on both the decoded data and on whether the
+   input is valid, and WFLZW::PatternSearcher finds the same occurrences as
+   searching the decoded data. WFLZW::ClassicDecoder is fuzzed with the
+   classic formats, and WFLZW::Decoder also with 16-bit symbols. The segment
+   functions are fuzzed with a reset point index read by readResetPoints(),
+   which is as untrusted as the stream.
+*/
+
+#define WFLZW_USE_THREADS
+#include "../WFLZW.hh"
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+namespace
+{
+    std::vector<WFLZW::Byte> gDecodedData;
+}
+
+// With 16-bit symbols gDecodedData gets the low bytes of the symbols.
+template<unsigned kDictionaryMaxSize, typename Symbol_t = WFLZW::Byte>
+class FuzzDecoder: public WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>
+{
+ public:
+    FuzzDecoder(Symbol_t maxInputByteValue, bool enableFlush):
+        WFLZW::Decoder<kDictionaryMaxSize, Symbol_t>(maxInputByteValue, enableFlush) {}
+
+    virtual void outputDecodedBytes(Symbol_t* bytes, unsigned amount)
+    {
+        if(amount == 0 || amount > kDictionaryMaxSize) std::abort();
+        for(unsigned i = 0; i < amount; ++i)
+        {
+            if(bytes[i] > this->maxByteValue()) std::abort();
+            gDecodedData.push_back(static_cast<WFLZW::Byte>(bytes[i]));
+        }
+    }
+};
+
+template<unsigned kDictionaryMaxSize, typename Symbol_t = WFLZW::Byte>
+static WFLZW::DecodeStatus fuzzDecoder(const WFLZW::Byte* data, std::size_t size,
+                                       unsigned maxInputByteValue, bool enableFlush)
+{
+    std::unique_ptr<FuzzDecoder<kDictionaryMaxSize, Symbol_t>> decoder
+        (new FuzzDecoder<kDictionaryMaxSize, Symbol_t>(static_cast<Symbol_t>(maxInputByteValue),
+                                                       enableFlush));
+    gDecodedData.clear();
+
+    // Feed the data in two parts to also exercise resuming in the middle of a code.
+    const std::size_t firstPartSize = size / 3;
+    const WFLZW::DecodeStatus status = decoder->decodeBytes(data, firstPartSize);
+    if(status != WFLZW::DecodeStatus::inputContinues) return status;
+    return decoder->decodeBytes(data + firstPartSize, size - firstPartSize);
+}
+
+template<unsigned kDictionaryMaxSize>
+static void fuzzDecoderStream(const WFLZW::Byte* data, std::size_t size)
+{
+    const WFLZW::DecodeStatus decoderStatus = fuzzDecoder<kDictionaryMaxSize>
+        (data, size, WFLZW::DecoderStream<kDictionaryMaxSize>().maxByteValue(), false);
+
+    std::unique_ptr<WFLZW::DecoderStream<kDictionaryMaxSize>> stream
+        (new WFLZW::DecoderStream<kDictionaryMaxSize>);
+    std::vector<WFLZW::Byte> streamData;
+    WFLZW::Byte output[7];
+    std::size_t outputAmount;
+    WFLZW::StreamStatus status;
+    stream->setInput(data, size);
+
+    do
+    {
+        status = stream->decode(output, sizeof(output), outputAmount);
+        if(outputAmount > sizeof(output)) std::abort();
+        streamData.insert(streamData.end(), output, output + outputAmount);
+    } while(status == WFLZW::StreamStatus::outputFull);
+
+    // On error the stream may have stopped earlier than the decoder, but not later.
+    switch(decoderStatus)
+    {
+      case WFLZW::DecodeStatus::inputContinues:
+          if(status != WFLZW::StreamStatus::inputNeeded || streamData != gDecodedData)
+              std::abort();
+          break;
+      case WFLZW::DecodeStatus::inputDone:
+          if(status != WFLZW::StreamStatus::done || streamData != gDecodedData)
+              std::abort();
+          break;
+      case WFLZW::DecodeStatus::inputError:
+          if(status != WFLZW::StreamStatus::inputError || streamData.size() > gDecodedData.size())
+              std::abort();
+          break;
+    }
+}
+
+template<unsigned kDictionaryMaxSize>
+class FuzzPatternSearcher: public WFLZW::PatternSearcher<kDictionaryMaxSize>
+{
+ public:
+    std::vector<std::uint64_t> mMatchOffsets;
+
+    FuzzPatternSearcher(const WFLZW::Byte* pattern, std::size_t patternLength):
+        WFLZW::PatternSearcher<kDictionaryMaxSize>(pattern, patternLength) {}
+
+    virtual void outputMatch(std::uint64_t offset) { mMatchOffsets.push_back(offset); }
+};
+
+// The pattern is taken from the decoded data, so that it has occurrences.
+template<unsigned kDictionaryMaxSize>
+static void fuzzPatternSearcher(const WFLZW::Byte* data, std::size_t size)
+{
+    const WFLZW::DecodeStatus decoderStatus =
+        fuzzDecoder<kDictionaryMaxSize>(data, size, 255, false);
+
+    std::vector<WFLZW::Byte> pattern(1, 0);
+    if(!gDecodedData.empty())
+    {
+        const std::size_t offset = size % gDecodedData.size();
+        const std::size_t length = std::min(1 + size % 20, gDecodedData.size() - offset);
+        pattern.assign(gDecodedData.begin() + offset, gDecodedData.begin() + offset + length);
+    }
+
+    std::unique_ptr<FuzzPatternSearcher<kDictionaryMaxSize>> searcher
+        (new FuzzPatternSearcher<kDictionaryMaxSize>(pattern.data(), pattern.size()));
+    const std::size_t firstPartSize = size / 3;
+    WFLZW::DecodeStatus status = searcher->searchBytes(data, firstPartSize);
+    if(status == WFLZW::DecodeStatus::inputContinues)
+        status = searcher->searchBytes(data + firstPartSize, size - firstPartSize);
+
+    std::vector<std::uint64_t> expectedOffsets;
+    for(auto iter = gDecodedData.begin();
+        (iter = std::search(iter, gDecodedData.end(), pattern.begin(), pattern.end())) !=
+            gDecodedData.end(); ++iter)
+        expectedOffsets.push_back(std::uint64_t(iter - gDecodedData.begin()));
+
+    if(status != decoderStatus || searcher->decompressedSize() != gDecodedData.size() ||
+       searcher->mMatchOffsets != expectedOffsets)
+        std::abort();
+}
+
+template<unsigned kDictionaryMaxSize>
+class FuzzBlockDecoder: public WFLZW::BlockDecoder<kDictionaryMaxSize, 4096>
+{
+ public:
+    virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
+    {
+        if(amount == 0 || amount > 4096) std::abort();
+        gDecodedData.insert(gDecodedData.end(), bytes, bytes + amount);
+    }
+};
+
+template<unsigned kDictionaryMaxSize>
+static void fuzzBlockDecoder(const WFLZW::Byte* data, std::size_t size)
+{
+    std::unique_ptr<FuzzBlockDecoder<kDictionaryMaxSize>> decoder
+        (new FuzzBlockDecoder<kDictionaryMaxSize>);
+    gDecodedData.clear();
+    decoder->decodeBytes(data, size / 2);
+    decoder->decodeBytes(data + size / 2, size - size / 2);
+}
+
+/* The data starts with the size of the reset point index (two bytes, little
+   endian), followed by the index and the stream. decompressInParallel() must
+   succeed exactly when every segment decodes with decompressSegment(), and
+   produce the same data.
+*/
+template<unsigned kDictionaryMaxSize>
+static void fuzzResetPoints(const WFLZW::Byte* data, std::size_t size)
+{
+    if(size < 2) return;
+    const std::size_t indexSize = std::min(std::size_t(data[0] | (data[1] << 8)), size - 2);
+    std::vector<WFLZW::ResetPoint> resetPoints;
+    if(!WFLZW::readResetPoints(data + 2, indexSize, resetPoints)) return;
+    const WFLZW::Byte* const stream = data + 2 + indexSize;
+    const std::size_t streamSize = size - 2 - indexSize;
+
+    std::vector<WFLZW::Byte> segmentsData;
+    bool segmentsDecoded = true;
+    for(std::size_t i = 0; i <= resetPoints.size() && segmentsDecoded; ++i)
+        segmentsDecoded = (WFLZW::decompressSegment<kDictionaryMaxSize>
+                           (stream, streamSize, resetPoints, i, segmentsData) ==
+                           WFLZW::DecodeStatus::inputDone);
+
+    std::vector<WFLZW::Byte> parallelData;
+    const WFLZW::DecodeStatus status = WFLZW::decompressInParallel<kDictionaryMaxSize>
+        (stream, streamSize, resetPoints, parallelData, 3);
+
+    if((status == WFLZW::DecodeStatus::inputDone) != segmentsDecoded ||
+       (segmentsDecoded && parallelData != segmentsData))
+        std::abort();
+}
+
+class FuzzClassicDecoder: public WFLZW::ClassicDecoder<16>
+{
+ public:
+    explicit FuzzClassicDecoder(const WFLZW::ClassicFormat& format):
+        WFLZW::ClassicDecoder<16>(format) {}
+
+    virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
+    {
+        if(amount == 0 || amount > (1U << 16)) std::abort();
+        gDecodedData.insert(gDecodedData.end(), bytes, bytes + amount);
+    }
+};
+
+static WFLZW::ClassicFormat classicFormat(unsigned selector)
+{
+    switch(selector)
+    {
+      case 10: return WFLZW::unixCompressFormat();
+      case 11: return WFLZW::gifFormat(2);
+      default: return WFLZW::tiffFormat();
+    }
+}
+
+static void fuzzClassicDecoder(const WFLZW::Byte* data, std::size_t size,
+                               const WFLZW::ClassicFormat& format)
+{
+    std::unique_ptr<FuzzClassicDecoder> decoder(new FuzzClassicDecoder(format));
+    gDecodedData.clear();
+    if(decoder->decodeBytes(data, size / 3) == WFLZW::DecodeStatus::inputContinues)
+        decoder->decodeBytes(data + size / 3, size - size / 3);
+}
+
+/* The first input byte selects the decoder configuration, and the rest is the
+   compressed data.
+*/
+static void fuzzOneInput(const WFLZW::Byte* data, std::size_t size)
+{
+    if(size == 0) return;
+    const WFLZW::Byte selector = data[0];
+    ++data; --size;
+
+    switch(selector % 16)
+    {
+      case 0: fuzzDecoder<8>(data, size, 5, false); break;
+      case 1: fuzzDecoder<300>(data, size, 255, false); break;
+      case 2: fuzzDecoder<4096>(data, size, 255, false); break;
+      case 3: fuzzDecoder<4096>(data, size, 255, true); break;
+      case 4: fuzzDecoder<65536>(data, size, 255, false); break;
+      case 5: fuzzDecoder<65536>(data, size, 15, true); break;
+      case 6: fuzzDecoder<65537>(data, size, 255, false); break;
+      case 7: fuzzDecoderStream<4096>(data, size); break;
+      case 8: fuzzBlockDecoder<300>(data, size); break;
+      case 9: fuzzBlockDecoder<65536>(data, size); break;
+      case 13: fuzzDecoder<8192, std::uint16_t>(data, size, 4095, true); break;
+      case 14: fuzzPatternSearcher<4096>(data, size); break;
+      case 15: fuzzResetPoints<4096>(data, size); break;
+      default: fuzzClassicDecoder(data, size, classicFormat(selector % 16)); break;
+    }
+}
+
+#ifdef WFLZW_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+    fuzzOneInput(data, size);
+    return 0;
+}
+
+#else
+//============================================================================
+// Standalone fuzzing
+//============================================================================
+template<unsigned kDictionaryMaxSize, typename Symbol_t = WFLZW::Byte>
+static std::vector<WFLZW::Byte> createValidStream
+(std::mt19937& rng, unsigned maxInputByteValue, bool enableFlush)
+{
+    using Base = WFLZW::Encoder<kDictionaryMaxSize, WFLZW::DictionaryType::tree, 256, Symbol_t>;
+    class StreamEncoder: public Base
+    {
+     public:
+        std::vector<WFLZW::Byte> mOutput;
+
+        StreamEncoder(Symbol_t maxInputByteValue, bool enableFlush):
+            Base(maxInputByteValue, enableFlush) {}
+
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            mOutput.insert(mOutput.end(), bytes, bytes + amount);
+        }
+    };
+
+    std::unique_ptr<StreamEncoder> encoder
+        (new StreamEncoder(static_cast<Symbol_t>(maxInputByteValue), enableFlush));
+    const unsigned length = rng() % 20000;
+    const unsigned alphabetSize = 1 + rng() % (maxInputByteValue + 1U);
+
+    for(unsigned i = 0; i < length; ++i)
+    {
+        encoder->encodeByte(static_cast<Symbol_t>(rng() % alphabetSize));
+        if(enableFlush && rng() % 1000 == 0) encoder->flush();
+    }
+    encoder->finalizeEncoding();
+    return encoder->mOutput;
+}
+
+// Block streams with all the block types.
+template<unsigned kDictionaryMaxSize>
+static std::vector<WFLZW::Byte> createValidBlockStream(std::mt19937& rng)
+{
+    class StreamEncoder: public WFLZW::BlockEncoder<kDictionaryMaxSize,
+                                                    WFLZW::DictionaryType::tree, 4096>
+    {
+     public:
+        std::vector<WFLZW::Byte> mOutput;
+
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            mOutput.insert(mOutput.end(), bytes, bytes + amount);
+        }
+    };
+
+    std::unique_ptr<StreamEncoder> encoder(new StreamEncoder);
+    const unsigned length = rng() % 20000;
+    const unsigned alphabetSize = 1 + rng() % 256;
+    encoder->setEntropyCoding(rng() % 2);
+    encoder->setFilter(static_cast<WFLZW::Filter>(rng() % 4), 1 + rng() % 8);
+
+    for(unsigned i = 0; i < length; ++i)
+        encoder->encodeByte(static_cast<WFLZW::Byte>(rng() % alphabetSize));
+    encoder->finalizeEncoding();
+    return encoder->mOutput;
+}
+
+static std::vector<WFLZW::Byte> createValidClassicStream
+(std::mt19937& rng, const WFLZW::ClassicFormat& format)
+{
+    class StreamEncoder: public WFLZW::ClassicEncoder<16>
+    {
+     public:
+        std::vector<WFLZW::Byte> mOutput;
+
+        explicit StreamEncoder(const WFLZW::ClassicFormat& format):
+            WFLZW::ClassicEncoder<16>(format) {}
+
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            mOutput.insert(mOutput.end(), bytes, bytes + amount);
+        }
+    };
+
+    std::unique_ptr<StreamEncoder> encoder(new StreamEncoder(format));
+    const unsigned length = rng() % 20000;
+    const unsigned alphabetSize = 1 + rng() % format.rootsAmount;
+
+    for(unsigned i = 0; i < length; ++i)
+        encoder->encodeByte(static_cast<WFLZW::Byte>(rng() % alphabetSize));
+    encoder->finalizeEncoding();
+    return encoder->mOutput;
+}
+
+// A stream with several dictionary resets, preceded by its reset point index.
+template<unsigned kDictionaryMaxSize>
+static std::vector<WFLZW::Byte> createValidResetPointStream(std::mt19937& rng)
+{
+    std::vector<WFLZW::Byte> input(rng() % 20000);
+    const unsigned alphabetSize = 1 + rng() % 256;
+    for(auto& byte: input) byte = static_cast<WFLZW::Byte>(rng() % alphabetSize);
+
+    std::vector<WFLZW::Byte> stream, index;
+    std::vector<WFLZW::ResetPoint> resetPoints;
+    WFLZW::compress<kDictionaryMaxSize>(input.data(), input.size(), stream, resetPoints);
+    WFLZW::writeResetPoints(resetPoints, index);
+
+    std::vector<WFLZW::Byte> result;
+    result.push_back(static_cast<WFLZW::Byte>(index.size()));
+    result.push_back(static_cast<WFLZW::Byte>(index.size() >> 8));
+    result.insert(result.end(), index.begin(), index.end());
+    result.insert(result.end(), stream.begin(), stream.end());
+    return result;
+}
+
+static std::vector<WFLZW::Byte> createValidInput(std::mt19937& rng)
+{
+    const WFLZW::Byte selector = static_cast<WFLZW::Byte>(rng() % 16);
+    std::vector<WFLZW::Byte> result(1, selector);
+    std::vector<WFLZW::Byte> stream;
+
+    switch(selector)
+    {
+      case 0: stream = createValidStream<8>(rng, 5, false); break;
+      case 1: stream = createValidStream<300>(rng, 255, false); break;
+      case 2: case 7: case 14: stream = createValidStream<4096>(rng, 255, false); break;
+      case 3: stream = createValidStream<4096>(rng, 255, true); break;
+      case 4: stream = createValidStream<65536>(rng, 255, false); break;
+      case 5: stream = createValidStream<65536>(rng, 15, true); break;
+      case 6: stream = createValidStream<65537>(rng, 255, false); break;
+      case 8: stream = createValidBlockStream<300>(rng); break;
+      case 9: stream = createValidBlockStream<65536>(rng); break;
+      case 13: stream = createValidStream<8192, std::uint16_t>(rng, 4095, true); break;
+      case 15: stream = createValidResetPointStream<4096>(rng); break;
+      default: stream = createValidClassicStream(rng, classicFormat(selector)); break;
+    }
+
+    result.insert(result.end(), stream.begin(), stream.end());
+    return result;
+}
+
+static void mutate(std::vector<WFLZW::Byte>& input, std::mt19937& rng)
+{
+    const unsigned mutationsAmount = 1 + rng() % 8;
+    for(unsigned i = 0; i < mutationsAmount && input.size() > 1; ++i)
+    {
+        const std::size_t position = 1 + rng() % (input.size() - 1);
+        switch(rng() % 5)
+        {
+          case 0: input[position] ^= static_cast<WFLZW::Byte>(1U << (rng() % 8)); break;
+          case 1: input[position] = static_cast<WFLZW::Byte>(rng()); break;
+          case 2: input.resize(position); break;
+          case 3: input.insert(input.begin() + position, static_cast<WFLZW::Byte>(rng())); break;
+          case 4: input.erase(input.begin() + position); break;
+        }
+    }
+}
+
+static bool readFile(const char* fileName, std::vector<WFLZW::Byte>& data)
+{
+    std::FILE* inFile = std::fopen(fileName, "rb");
+    if(!inFile) { std::perror(fileName); return false; }
+    WFLZW::Byte buffer[4096];
+    std::size_t amount;
+    while((amount = std::fread(buffer, 1, sizeof(buffer), inFile)) > 0)
+        data.insert(data.end(), buffer, buffer + amount);
+    std::fclose(inFile);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc > 1 && std::strcmp(argv[1], "-iterations") != 0)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            std::vector<WFLZW::Byte> data;
+            if(!readFile(argv[i], data)) return 1;
+            std::printf("Decoding %s\n", argv[i]);
+            fuzzOneInput(data.data(), data.size());
+        }
+        return 0;
+    }
+
+    const unsigned long iterations = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000);
+    std::mt19937 rng(12345);
+    std::vector<WFLZW::Byte> input;
+
+    for(unsigned long iteration = 0; iteration < iterations; ++iteration)
+    {
+        if(iteration % 64 == 0) input = createValidInput(rng);
+        std::vector<WFLZW::Byte> mutatedInput = input;
+        if(iteration % 64 != 0) mutate(mutatedInput, rng);
+        fuzzOneInput(mutatedInput.data(), mutatedInput.size());
+
+        if((iteration + 1) % 10000 == 0)
+            std::printf("%lu iterations\n", iteration + 1);
+    }
+
+    std::printf("Done.\n");
+}
+#endif
@@ -5,6 +5,7 @@
 #include <utility>
 #include <algorithm>
 #include <memory>
+#include <cstring>
 
 //#define RUN_EXTENSIVE_TESTS
 
@@ -396,6 +397,2195 @@ bool testPatterns()
     return true;
 }
 
+template<unsigned kDictionaryMaxSize>
+class TestBlockEncoder: public WFLZW::BlockEncoder<kDictionaryMaxSize, kDictType, 4096>
+{
+ public:
+    virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+    {
+        gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+    }
+};
+
+template<unsigned kDictionaryMaxSize>
+class TestBlockDecoder: public WFLZW::BlockDecoder<kDictionaryMaxSize, 4096>
+{
+ public:
+    virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
+    {
+        gDecodedData.insert(gDecodedData.end(), bytes, bytes + amount);
+    }
+};
+
+template<unsigned kDictionaryMaxSize>
+bool testBlockFormat(bool entropyCoding)
+{
+    std::cout << "Testing block format with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << (entropyCoding ? " and entropy coding\n" : "\n");
+
+    std::unique_ptr<TestBlockEncoder<kDictionaryMaxSize>> encoder
+        (new TestBlockEncoder<kDictionaryMaxSize>);
+    std::unique_ptr<TestBlockDecoder<kDictionaryMaxSize>> decoder
+        (new TestBlockDecoder<kDictionaryMaxSize>);
+    encoder->setEntropyCoding(entropyCoding);
+    std::mt19937 rngEngine(1);
+    std::uniform_int_distribution<unsigned> randomByte(0, 255), randomChunkSize(1, 3000);
+
+    const unsigned kBlockDataSizes[] = { 0, 1, 100, 4095, 4096, 4097, 20000, 100000 };
+
+    for(unsigned dataSize: kBlockDataSizes)
+    {
+        for(unsigned dataType = 0; dataType < 3; ++dataType)
+        {
+            gInputData.resize(dataSize);
+            for(unsigned i = 0; i < dataSize; ++i)
+            {
+                // 0 = random, 1 = repetitive, 2 = alternating runs of random and repetitive
+                const bool randomPart = (dataType == 0 || (dataType == 2 && (i / 3000) % 2));
+                gInputData[i] = (randomPart ? WFLZW::Byte(randomByte(rngEngine)) :
+                                 WFLZW::Byte("abracadabra"[i % 11]));
+            }
+
+            gEncodedData.clear();
+            gDecodedData.clear();
+            for(std::size_t i = 0; i < dataSize;)
+            {
+                const std::size_t amount =
+                    std::min(std::size_t(randomChunkSize(rngEngine)), dataSize - i);
+                encoder->encodeBytes(&gInputData[i], amount);
+                i += amount;
+            }
+            encoder->finalizeEncoding();
+
+            const std::size_t maxEncodedSize = dataSize + (dataSize / 4096 + 1) * 9 + 1;
+            if(gEncodedData.size() > maxEncodedSize)
+                PRINTERROR("Error: dataSize=", dataSize, ", dataType=", dataType,
+                           ", gEncodedData.size()=", gEncodedData.size(), "\n");
+
+            decoder->initialize();
+            WFLZW::DecodeStatus status = WFLZW::DecodeStatus::inputContinues;
+            for(std::size_t i = 0; i < gEncodedData.size();)
+            {
+                const std::size_t amount =
+                    std::min(std::size_t(randomChunkSize(rngEngine)), gEncodedData.size() - i);
+                status = decoder->decodeBytes(&gEncodedData[i], amount);
+                i += amount;
+            }
+
+            if(status != WFLZW::DecodeStatus::inputDone)
+                PRINTERROR("Error: dataSize=", dataSize, ", dataType=", dataType,
+                           ", decoding status=", int(status), "\n");
+            if(gInputData != gDecodedData)
+                PRINTERROR("Error: dataSize=", dataSize, ", dataType=", dataType,
+                           ", gInputData.size()=", gInputData.size(),
+                           ", gDecodedData.size()=", gDecodedData.size(), "\n");
+
+            if(dataSize > 1)
+            {
+                gEncodedData[1] ^= 0x80;
+                decoder->initialize();
+                if(decoder->decodeBytes(&gEncodedData[0], gEncodedData.size()) !=
+                   WFLZW::DecodeStatus::inputError)
+                    PRINTERROR("Error: corrupted block header was not detected (dataSize=",
+                               dataSize, ", dataType=", dataType, ")\n");
+            }
+        }
+    }
+
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+bool testBatch()
+{
+    std::cout << "Testing batch encoding with kDictionaryMaxSize=" << kDictionaryMaxSize << "\n";
+
+    std::mt19937 rngEngine(2);
+    std::uniform_int_distribution<unsigned> randomSize(0, 3000), randomByte(0, 15);
+    std::vector<std::vector<WFLZW::Byte>> records(300);
+    std::vector<WFLZW::ByteSpan> inputs;
+
+    for(auto& record: records)
+    {
+        record.resize(randomSize(rngEngine));
+        for(auto& byte: record) byte = WFLZW::Byte(randomByte(rngEngine) * 3);
+        inputs.push_back(WFLZW::ByteSpan { record.data(), record.size() });
+    }
+
+    std::unique_ptr<WFLZW::BatchEncoder<kDictionaryMaxSize>> batchEncoder
+        (new WFLZW::BatchEncoder<kDictionaryMaxSize>);
+    std::unique_ptr<WFLZW::BatchDecoder<kDictionaryMaxSize>> batchDecoder
+        (new WFLZW::BatchDecoder<kDictionaryMaxSize>);
+    TestEncoderContainer<kDictionaryMaxSize> encoderContainer;
+    TestEncoder<kDictionaryMaxSize>& encoder = encoderContainer.instance();
+
+    std::vector<WFLZW::Byte> batchOutput, parallelOutput, decodedOutput;
+    std::vector<std::size_t> batchOffsets, parallelOffsets, decodedOffsets;
+
+    if(batchEncoder->encodeBatch(inputs.data(), inputs.size(), batchOutput, batchOffsets) !=
+       WFLZW::EncodeStatus::ok)
+        PRINTERROR("Error: encodeBatch() failed\n");
+#ifdef WFLZW_USE_THREADS
+    if(WFLZW::BatchEncoder<kDictionaryMaxSize>::encodeBatchInParallel
+       (inputs.data(), inputs.size(), parallelOutput, parallelOffsets, 3) != WFLZW::EncodeStatus::ok)
+        PRINTERROR("Error: encodeBatchInParallel() failed\n");
+
+    if(batchOutput != parallelOutput || batchOffsets != parallelOffsets)
+        PRINTERROR("Error: encodeBatchInParallel() output differs from encodeBatch()\n");
+#endif
+
+    for(std::size_t i = 0; i < records.size(); ++i)
+    {
+        gEncodedData.clear();
+        encoder.initialize();
+        encoder.encodeBytes(records[i].data(), records[i].size());
+        encoder.finalizeEncoding();
+        if(!std::equal(gEncodedData.begin(), gEncodedData.end(),
+                       batchOutput.begin() + batchOffsets[i]) ||
+           gEncodedData.size() != batchOffsets[i + 1] - batchOffsets[i])
+            PRINTERROR("Error: batch encoding of record ", i, " differs from Encoder\n");
+    }
+
+    if(batchDecoder->decodeBatch(batchOutput.data(), batchOffsets.data(), records.size(),
+                                 decodedOutput, decodedOffsets) != WFLZW::DecodeStatus::inputDone)
+        PRINTERROR("Error: decodeBatch() failed\n");
+
+    for(std::size_t i = 0; i < records.size(); ++i)
+        if(!std::equal(records[i].begin(), records[i].end(),
+                       decodedOutput.begin() + decodedOffsets[i]) ||
+           records[i].size() != decodedOffsets[i + 1] - decodedOffsets[i])
+            PRINTERROR("Error: decodeBatch() output of record ", i, " is wrong\n");
+
+#ifdef WFLZW_USE_THREADS
+    std::vector<WFLZW::ByteSpan> encodedInputs;
+    for(std::size_t i = 0; i < records.size(); ++i)
+        encodedInputs.push_back(WFLZW::ByteSpan { &batchOutput[batchOffsets[i]],
+                                                  batchOffsets[i + 1] - batchOffsets[i] });
+    parallelOutput.clear();
+    if(WFLZW::BatchDecoder<kDictionaryMaxSize>::decodeBatchInParallel
+       (encodedInputs.data(), encodedInputs.size(), parallelOutput, parallelOffsets, 4) !=
+       WFLZW::DecodeStatus::inputDone ||
+       parallelOutput != decodedOutput || parallelOffsets != decodedOffsets)
+        PRINTERROR("Error: decodeBatchInParallel() output differs from decodeBatch()\n");
+#endif
+
+    // A byte too large for a small dictionary stops the batch at its record.
+    if(kDictionaryMaxSize <= 257)
+    {
+        const std::size_t badRecordIndex = 150;
+        records[badRecordIndex].push_back(WFLZW::Byte(kDictionaryMaxSize - 2));
+        inputs[badRecordIndex].size = records[badRecordIndex].size();
+        const std::vector<WFLZW::Byte> goodOutput
+            (batchOutput.begin(), batchOutput.begin() + batchOffsets[badRecordIndex]);
+
+        for(unsigned threadsAmount = 0; threadsAmount < 4; ++threadsAmount)
+        {
+            batchOutput.clear();
+#ifdef WFLZW_USE_THREADS
+            const WFLZW::EncodeStatus status = (threadsAmount == 0 ?
+                batchEncoder->encodeBatch(inputs.data(), inputs.size(), batchOutput, batchOffsets) :
+                WFLZW::BatchEncoder<kDictionaryMaxSize>::encodeBatchInParallel
+                (inputs.data(), inputs.size(), batchOutput, batchOffsets, threadsAmount));
+#else
+            if(threadsAmount > 0) break;
+            const WFLZW::EncodeStatus status =
+                batchEncoder->encodeBatch(inputs.data(), inputs.size(), batchOutput, batchOffsets);
+#endif
+            if(status != WFLZW::EncodeStatus::inputByteTooLarge ||
+               batchOffsets.size() != badRecordIndex + 1 || batchOutput != goodOutput)
+                PRINTERROR("Error: a too large byte in record ", badRecordIndex,
+                           " was not reported (threadsAmount=", threadsAmount, ", status=",
+                           int(status), ", offsets.size()=", batchOffsets.size(), ")\n");
+        }
+    }
+
+    return true;
+}
+
+bool runBatchTests()
+{
+    if(!testBatch<64>()) ERRORRET;
+    if(!testBatch<4096>()) ERRORRET;
+    if(!testBatch<(1U<<16)>()) ERRORRET;
+    if(!testBatch<(1U<<18)>()) ERRORRET;
+    return true;
+}
+
+// Uses new and delete unless compiled with WFLZW_USE_HUGE_PAGES (see the Makefile).
+template<unsigned kDictionaryMaxSize>
+bool testLargeObjects()
+{
+    std::cout << "Testing large object allocation with kDictionaryMaxSize="
+              << kDictionaryMaxSize << "\n";
+
+    std::mt19937 rngEngine(7);
+    std::uniform_int_distribution<unsigned> randomByte(0, 99);
+    gInputData.resize(3000000);
+    for(auto& byte: gInputData) byte = WFLZW::Byte(randomByte(rngEngine));
+
+    for(unsigned round = 0; round < 2; ++round)
+    {
+        WFLZW::LargeObjectPtr<TestEncoder<kDictionaryMaxSize>> encoder =
+            WFLZW::makeLargeObject<TestEncoder<kDictionaryMaxSize>>();
+        WFLZW::LargeObjectPtr<WFLZW::DecoderStream<kDictionaryMaxSize>> decoder =
+            WFLZW::makeLargeObject<WFLZW::DecoderStream<kDictionaryMaxSize>>(99);
+        if(decoder->maxByteValue() != 99)
+            PRINTERROR("Error: makeLargeObject() didn't pass the constructor parameters\n");
+
+        gEncodedData.clear();
+        encoder->initialize(99);
+        encoder->encodeBytes(gInputData.data(), gInputData.size());
+        encoder->finalizeEncoding();
+
+        gDecodedData.resize(gInputData.size() + 1);
+        std::size_t outputAmount = 0;
+        decoder->setInput(gEncodedData.data(), gEncodedData.size());
+        if(decoder->decode(gDecodedData.data(), gDecodedData.size(), outputAmount) !=
+           WFLZW::StreamStatus::done || outputAmount != gInputData.size())
+            PRINTERROR("Error: decoding failed\n");
+        gDecodedData.pop_back();
+        if(gDecodedData != gInputData)
+            PRINTERROR("Error: decoded data differs from the original\n");
+    }
+
+    return true;
+}
+
+// The memory is released and the exception passed on if the constructor throws.
+bool testLargeObjectConstructorException()
+{
+    std::cout << "Testing large object allocation with a throwing constructor\n";
+
+    struct ThrowingObject
+    {
+        WFLZW::Byte data[1 << 22];
+        ThrowingObject(int value) { throw value; }
+    };
+
+    for(int round = 0; round < 100; ++round)
+    {
+        try
+        {
+            WFLZW::makeLargeObject<ThrowingObject>(round);
+            PRINTERROR("Error: makeLargeObject() didn't throw\n");
+        }
+        catch(int value)
+        {
+            if(value != round)
+                PRINTERROR("Error: makeLargeObject() threw the wrong exception\n");
+        }
+    }
+
+    return true;
+}
+
+bool runLargeObjectTests()
+{
+    if(!testLargeObjects<(1U<<12)>()) ERRORRET;
+    if(!testLargeObjects<(1U<<20)>()) ERRORRET;
+    if(!testLargeObjectConstructorException()) ERRORRET;
+    return true;
+}
+
+#ifdef WFLZW_COLLECT_STATS
+template<unsigned kDictionaryMaxSize>
+bool testStats()
+{
+    std::cout << "Testing statistics with kDictionaryMaxSize=" << kDictionaryMaxSize << "\n";
+
+    TestEncoderContainer<kDictionaryMaxSize> encoderContainer;
+    TestDecoderContainer<kDictionaryMaxSize> decoderContainer;
+    TestEncoder<kDictionaryMaxSize>& encoder = encoderContainer.instance();
+    TestDecoder<kDictionaryMaxSize>& decoder = decoderContainer.instance();
+
+    std::mt19937 rngEngine(3);
+    std::uniform_int_distribution<unsigned> randomByte(0, 20);
+    gInputData.resize(200000);
+    for(auto& byte: gInputData) byte = WFLZW::Byte(randomByte(rngEngine));
+
+    gEncodedData.clear();
+    encoder.initialize();
+    encoder.encodeBytes(gInputData.data(), gInputData.size() / 2);
+    for(std::size_t i = gInputData.size() / 2; i < gInputData.size(); ++i)
+        encoder.encodeByte(gInputData[i]);
+    encoder.finalizeEncoding();
+
+    gDecodedData.clear();
+    decoder.initialize();
+    decoder.decodeBytes(gEncodedData.data(), gEncodedData.size());
+
+    const WFLZW::EncoderStats encoderStats = encoder.stats();
+    const WFLZW::DecoderStats& decoderStats = decoder.stats();
+
+    std::uint64_t encodedBits = 0;
+    for(unsigned bitSize = 0; bitSize <= 32; ++bitSize)
+    {
+        encodedBits += encoderStats.codesPerBitSize[bitSize] * bitSize;
+        if(encoderStats.codesPerBitSize[bitSize] != decoderStats.codesPerBitSize[bitSize])
+            PRINTERROR("Error: encoder and decoder code counts differ for width ", bitSize, "\n");
+    }
+
+    if(encoderStats.inputBytes != gInputData.size())
+        PRINTERROR("Error: inputBytes is ", encoderStats.inputBytes, "\n");
+    if((encodedBits + 7) / 8 != gEncodedData.size())
+        PRINTERROR("Error: code counts don't match the encoded size\n");
+    if(encoderStats.streamsFinalized != 1 ||
+       encoderStats.dictionaryResets != decoderStats.dictionaryResets ||
+       (kDictionaryMaxSize < 65536 && encoderStats.dictionaryResets == 0))
+        PRINTERROR("Error: wrong amount of streams or dictionary resets\n");
+    if(encoderStats.dictionaryLookups + encoderStats.dictionaryResets + 1 !=
+       encoderStats.inputBytes ||
+       encoderStats.averageProbeDepth() <= 0.0)
+        PRINTERROR("Error: wrong amount of dictionary lookups\n");
+    if(encoderStats.outputCallbacks != (gEncodedData.size() + 255) / 256)
+        PRINTERROR("Error: wrong amount of output callbacks\n");
+    if(decoderStats.chainLengthTotal != gInputData.size() ||
+       decoderStats.outputCallbacks + 1 != decoderStats.codes() ||
+       decoderStats.averageChainLength() != encoderStats.averageMatchLength())
+        PRINTERROR("Error: decoder chain statistics are wrong\n");
+
+    encoder.resetStats();
+    decoder.resetStats();
+    if(encoder.stats().codes() != 0 || encoder.stats().dictionaryProbes != 0 ||
+       decoder.stats().codes() != 0)
+        PRINTERROR("Error: resetStats() didn't reset the statistics\n");
+
+    return true;
+}
+#endif
+
+/* After each flush, everything output so far must decode to everything
+   encoded so far.
+*/
+template<unsigned kDictionaryMaxSize>
+bool testFlush(WFLZW::Byte maxByteValue, unsigned maxFlushInterval)
+{
+    std::cout << "Testing flush with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << ", maxByteValue=" << unsigned(maxByteValue)
+              << ", maxFlushInterval=" << maxFlushInterval << "\n";
+
+    TestEncoderContainer<kDictionaryMaxSize> encoderContainer;
+    TestDecoderContainer<kDictionaryMaxSize> decoderContainer;
+    TestEncoder<kDictionaryMaxSize>& encoder = encoderContainer.instance();
+    TestDecoder<kDictionaryMaxSize>& decoder = decoderContainer.instance();
+
+    std::mt19937 rngEngine(4);
+    std::uniform_int_distribution<unsigned> randomByte(0, maxByteValue);
+    std::uniform_int_distribution<unsigned> randomInterval(0, maxFlushInterval);
+    gInputData.resize(100000);
+    for(auto& byte: gInputData) byte = WFLZW::Byte(randomByte(rngEngine));
+
+    gEncodedData.clear();
+    gDecodedData.clear();
+    encoder.initialize(maxByteValue, true);
+    decoder.initialize(maxByteValue, true);
+    std::size_t inputIndex = 0, decodedInputIndex = 0;
+
+    while(inputIndex < gInputData.size())
+    {
+        const std::size_t amount =
+            std::min(std::size_t(randomInterval(rngEngine)), gInputData.size() - inputIndex);
+        if(amount % 2)
+            encoder.encodeBytes(&gInputData[inputIndex], amount);
+        else
+            for(std::size_t i = 0; i < amount; ++i)
+                encoder.encodeByte(gInputData[inputIndex + i]);
+        inputIndex += amount;
+        encoder.flush();
+
+        if(decoder.decodeBytes(gEncodedData.data() + decodedInputIndex,
+                               gEncodedData.size() - decodedInputIndex) !=
+           WFLZW::DecodeStatus::inputContinues)
+            PRINTERROR("Error: decoding flushed data didn't return inputContinues\n");
+        decodedInputIndex = gEncodedData.size();
+
+        if(gDecodedData.size() != inputIndex ||
+           !std::equal(gDecodedData.begin(), gDecodedData.end(), gInputData.begin()))
+            PRINTERROR("Error: decoded data after flush at ", inputIndex, " is wrong\n");
+    }
+
+    encoder.finalizeEncoding();
+    if(decoder.decodeBytes(gEncodedData.data() + decodedInputIndex,
+                           gEncodedData.size() - decodedInputIndex) !=
+       WFLZW::DecodeStatus::inputDone || gDecodedData != gInputData)
+        PRINTERROR("Error: decoding the finalized stream failed\n");
+
+    return true;
+}
+
+bool runFlushTests()
+{
+    if(!testFlush<16>(1, 3)) ERRORRET;
+    if(!testFlush<64>(7, 20)) ERRORRET;
+    if(!testFlush<1024>(2, 5)) ERRORRET;
+    if(!testFlush<1024>(255, 50)) ERRORRET;
+    if(!testFlush<(1U<<16)>(20, 10)) ERRORRET;
+    if(!testFlush<(1U<<16)>(255, 1000)) ERRORRET;
+    if(!testFlush<(1U<<18)>(255, 10000)) ERRORRET;
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+bool testSession(WFLZW::Byte maxByteValue, bool enableFlush, unsigned maxMessageSize)
+{
+    std::cout << "Testing sessions with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << ", maxByteValue=" << unsigned(maxByteValue) << ", enableFlush="
+              << enableFlush << ", maxMessageSize=" << maxMessageSize << "\n";
+
+    TestEncoderContainer<kDictionaryMaxSize> encoderContainer;
+    TestDecoderContainer<kDictionaryMaxSize> decoderContainer;
+    TestEncoder<kDictionaryMaxSize>& encoder = encoderContainer.instance();
+    TestDecoder<kDictionaryMaxSize>& decoder = decoderContainer.instance();
+
+    // Similar messages: random picks from a small set of words.
+    std::mt19937 rngEngine(6);
+    std::vector<std::vector<WFLZW::Byte>> words(20);
+    std::uniform_int_distribution<unsigned> randomByte(0, maxByteValue);
+    for(auto& word: words)
+    {
+        word.resize(1 + rngEngine() % 8);
+        for(auto& byte: word) byte = WFLZW::Byte(randomByte(rngEngine));
+    }
+
+    gEncodedData.clear();
+    encoder.initialize(maxByteValue, enableFlush);
+    decoder.initialize(maxByteValue, enableFlush);
+    std::size_t sessionSize = 0, independentSize = 0;
+
+    for(unsigned messageIndex = 0; messageIndex < 2000; ++messageIndex)
+    {
+        std::vector<WFLZW::Byte> message;
+        const unsigned messageSize = rngEngine() % (maxMessageSize + 1);
+        while(message.size() < messageSize)
+        {
+            const auto& word = words[rngEngine() % words.size()];
+            message.insert(message.end(), word.begin(), word.end());
+        }
+        message.resize(messageSize);
+
+        // With flushing enabled, some messages are sent in two parts.
+        const std::size_t messageStart = gEncodedData.size();
+        const std::size_t flushPosition =
+            (enableFlush && messageIndex % 3 == 0 ? messageSize / 2 : messageSize);
+        encoder.encodeBytes(message.data(), flushPosition);
+        if(flushPosition < messageSize) encoder.flush();
+        encoder.encodeBytes(message.data() + flushPosition, messageSize - flushPosition);
+        encoder.finalizeMessage();
+        sessionSize += gEncodedData.size() - messageStart;
+
+        if(messageIndex == 0)
+        {
+            TestEncoderContainer<kDictionaryMaxSize> singleEncoderContainer;
+            TestEncoder<kDictionaryMaxSize>& singleEncoder = singleEncoderContainer.instance();
+            std::vector<WFLZW::Byte> sessionData(gEncodedData);
+            gEncodedData.clear();
+            singleEncoder.initialize(maxByteValue, enableFlush);
+            singleEncoder.encodeBytes(message.data(), flushPosition);
+            if(flushPosition < messageSize) singleEncoder.flush();
+            singleEncoder.encodeBytes(message.data() + flushPosition, messageSize - flushPosition);
+            singleEncoder.finalizeEncoding();
+            if(gEncodedData != sessionData)
+                PRINTERROR("Error: the first message differs from a single stream\n");
+            gEncodedData = sessionData;
+        }
+
+        gDecodedData.clear();
+        if(decoder.decodeBytes(gEncodedData.data() + messageStart,
+                               gEncodedData.size() - messageStart) !=
+           WFLZW::DecodeStatus::inputDone || gDecodedData != message)
+            PRINTERROR("Error: decoding message ", messageIndex, " failed\n");
+
+        independentSize +=
+            WFLZW::compress<kDictionaryMaxSize>(message.data(), message.size()).size();
+    }
+
+    if(maxMessageSize >= 100 && sessionSize * 2 > independentSize)
+        PRINTERROR("Error: session size ", sessionSize, " is not much smaller than ",
+                   independentSize, "\n");
+
+    return true;
+}
+
+// Streams ending when the decoder has just increased the code width, but the encoder hasn't.
+bool testEndCodeWidth()
+{
+    std::cout << "Testing the end code width\n";
+
+    std::mt19937 rngEngine(7);
+    for(std::size_t dataSize = 0; dataSize < 3000; ++dataSize)
+    {
+        gInputData.resize(dataSize);
+        for(auto& byte: gInputData) byte = WFLZW::Byte(rngEngine() % 3);
+
+        const std::vector<WFLZW::Byte> compressed =
+            WFLZW::compress<1024>(gInputData.data(), dataSize);
+        if(WFLZW::decompress<1024>(compressed.data(), compressed.size(), dataSize) != gInputData)
+            PRINTERROR("Error: decoding failed with size ", dataSize, "\n");
+    }
+
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+bool testCheckpoints(WFLZW::Byte maxByteValue, bool enableFlush)
+{
+    std::cout << "Testing checkpoints with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << ", maxByteValue=" << unsigned(maxByteValue) << ", enableFlush="
+              << enableFlush << "\n";
+
+    // Appending alternately with both dictionary types, which use the same checkpoints.
+    class ListEncoder: public WFLZW::Encoder<kDictionaryMaxSize, WFLZW::DictionaryType::list>
+    {
+     public:
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+        }
+    };
+
+    std::unique_ptr<TestEncoder<kDictionaryMaxSize>> treeEncoder
+        (new TestEncoder<kDictionaryMaxSize>);
+    std::unique_ptr<ListEncoder> listEncoder(new ListEncoder);
+    TestDecoderContainer<kDictionaryMaxSize> decoderContainer;
+    TestDecoder<kDictionaryMaxSize>& decoder = decoderContainer.instance();
+
+    std::mt19937 rngEngine(8);
+    std::uniform_int_distribution<unsigned> randomByte(0, maxByteValue);
+    gInputData.resize(300000);
+    for(std::size_t i = 0; i < gInputData.size(); ++i)
+        gInputData[i] = WFLZW::Byte(i % 1000 < 500 ? randomByte(rngEngine) : i % 3);
+
+    gEncodedData.clear();
+    treeEncoder->initialize(maxByteValue, enableFlush);
+    treeEncoder->encodeBytes(gInputData.data(), gInputData.size());
+    treeEncoder->finalizeEncoding();
+    const std::vector<WFLZW::Byte> singleStream = gEncodedData;
+
+    std::vector<WFLZW::Byte> checkpoint;
+    std::size_t inputIndex = 0;
+    gEncodedData.clear();
+
+    for(unsigned appendIndex = 0; inputIndex < gInputData.size(); ++appendIndex)
+    {
+        const std::size_t amount =
+            std::min(std::size_t(rngEngine() % (appendIndex % 4 ? 1000 : 100000)),
+                     gInputData.size() - inputIndex);
+        std::uint64_t streamSize = 0;
+
+        if(appendIndex == 0)
+        {
+            treeEncoder->initialize(maxByteValue, enableFlush);
+            treeEncoder->encodeBytes(gInputData.data(), amount);
+            treeEncoder->finalizeEncoding(checkpoint);
+        }
+        else if(appendIndex % 2)
+        {
+            if(!listEncoder->resumeEncoding(checkpoint.data(), checkpoint.size(), streamSize))
+                PRINTERROR("Error: resumeEncoding() failed\n");
+            gEncodedData.resize(streamSize);
+            listEncoder->encodeBytes(gInputData.data() + inputIndex, amount);
+            listEncoder->finalizeEncoding(checkpoint);
+        }
+        else
+        {
+            if(!treeEncoder->resumeEncoding(checkpoint.data(), checkpoint.size(), streamSize))
+                PRINTERROR("Error: resumeEncoding() failed\n");
+            gEncodedData.resize(streamSize);
+            treeEncoder->encodeBytes(gInputData.data() + inputIndex, amount);
+            treeEncoder->finalizeEncoding(checkpoint);
+        }
+        inputIndex += amount;
+
+        gDecodedData.clear();
+        decoder.initialize(maxByteValue, enableFlush);
+        if(decoder.decodeBytes(gEncodedData.data(), gEncodedData.size()) !=
+           WFLZW::DecodeStatus::inputDone || gDecodedData.size() != inputIndex ||
+           !std::equal(gDecodedData.begin(), gDecodedData.end(), gInputData.begin()))
+            PRINTERROR("Error: decoding the stream after ", appendIndex, " appends failed\n");
+    }
+
+    if(gEncodedData != singleStream)
+        PRINTERROR("Error: the appended stream differs from a single stream\n");
+
+    // Invalid checkpoints must be rejected, or at least be harmless.
+    std::uint64_t streamSize;
+    if(treeEncoder->resumeEncoding(checkpoint.data(), checkpoint.size() - 1, streamSize) ||
+       treeEncoder->resumeEncoding(checkpoint.data(), 10, streamSize))
+        PRINTERROR("Error: truncated checkpoint was accepted\n");
+
+    for(unsigned i = 0; i < 200; ++i)
+    {
+        std::vector<WFLZW::Byte> corruptCheckpoint = checkpoint;
+        corruptCheckpoint[rngEngine() % corruptCheckpoint.size()] ^=
+            WFLZW::Byte(1U << (rngEngine() % 8));
+        gEncodedData.clear();
+        if(treeEncoder->resumeEncoding(corruptCheckpoint.data(), corruptCheckpoint.size(),
+                                       streamSize))
+        {
+            treeEncoder->encodeBytes(gInputData.data(), 10000);
+            treeEncoder->finalizeEncoding();
+        }
+    }
+
+    return true;
+}
+
+/* Input with repeated words, long runs of the same byte (longer than the
+   lookahead of WFLZW::LookaheadEncoder) and random bytes.
+*/
+static void createWordsInput(WFLZW::Byte maxByteValue, std::size_t size, unsigned seed)
+{
+    std::mt19937 rngEngine(seed);
+    std::uniform_int_distribution<unsigned> randomByte(0, maxByteValue);
+    std::vector<std::vector<WFLZW::Byte>> words(200);
+    for(std::vector<WFLZW::Byte>& word: words)
+        for(unsigned i = 2 + rngEngine() % 10; i > 0; --i)
+            word.push_back(WFLZW::Byte(randomByte(rngEngine)));
+
+    gInputData.clear();
+    while(gInputData.size() < size)
+    {
+        const unsigned selector = rngEngine() % 100;
+        if(selector == 0)
+            gInputData.insert(gInputData.end(), rngEngine() % 3000, WFLZW::Byte(randomByte(rngEngine)));
+        else if(selector < 5)
+            gInputData.push_back(WFLZW::Byte(randomByte(rngEngine)));
+        else
+        {
+            const std::vector<WFLZW::Byte>& word = words[rngEngine() % 20 * (rngEngine() % 10)];
+            gInputData.insert(gInputData.end(), word.begin(), word.end());
+        }
+    }
+    gInputData.resize(size);
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictionaryType>
+bool testLookaheadEncoder(WFLZW::Byte maxByteValue, bool enableFlush)
+{
+    std::cout << "Testing lookahead encoding with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << ", " << (kDictionaryType == WFLZW::DictionaryType::list ? "list" : "tree")
+              << ", maxByteValue=" << unsigned(maxByteValue) << ", enableFlush="
+              << enableFlush << "\n";
+
+    class LookaheadEncoder: public WFLZW::LookaheadEncoder<kDictionaryMaxSize, kDictionaryType>
+    {
+     public:
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+        }
+    };
+
+    std::unique_ptr<LookaheadEncoder> encoder(new LookaheadEncoder);
+    TestEncoderContainer<kDictionaryMaxSize> greedyEncoderContainer;
+    TestDecoderContainer<kDictionaryMaxSize> decoderContainer;
+    TestEncoder<kDictionaryMaxSize>& greedyEncoder = greedyEncoderContainer.instance();
+    TestDecoder<kDictionaryMaxSize>& decoder = decoderContainer.instance();
+
+    createWordsInput(maxByteValue, 300000, kDictionaryMaxSize);
+    std::mt19937 rngEngine(kDictionaryMaxSize + maxByteValue);
+
+    // Fed in pieces of various sizes, and flushed between some of them. The
+    // greedy reference is flushed at the same points.
+    std::vector<std::pair<std::size_t, bool>> pieces;
+    for(std::size_t inputIndex = 0; inputIndex < gInputData.size();)
+    {
+        const std::size_t amount = std::min(std::size_t(rngEngine() % (rngEngine() % 2 ? 20 : 20000)),
+                                            gInputData.size() - inputIndex);
+        pieces.emplace_back(amount, enableFlush && rngEngine() % 20 == 0);
+        inputIndex += amount;
+    }
+
+    gEncodedData.clear();
+    greedyEncoder.initialize(maxByteValue, enableFlush);
+    for(std::size_t inputIndex = 0, i = 0; i < pieces.size(); ++i)
+    {
+        greedyEncoder.encodeBytes(gInputData.data() + inputIndex, pieces[i].first);
+        inputIndex += pieces[i].first;
+        if(pieces[i].second)
+            greedyEncoder.flush();
+    }
+    greedyEncoder.finalizeEncoding();
+    const std::size_t greedySize = gEncodedData.size();
+
+    gEncodedData.clear();
+    encoder->initialize(maxByteValue, enableFlush);
+    for(std::size_t inputIndex = 0, i = 0; i < pieces.size(); ++i)
+    {
+        const std::size_t amount = pieces[i].first;
+        if(amount == 1)
+        {
+            if(encoder->encodeByte(gInputData[inputIndex]) != WFLZW::EncodeStatus::ok)
+                PRINTERROR("Error: encodeByte() failed\n");
+        }
+        else if(encoder->encodeBytes(gInputData.data() + inputIndex, amount) !=
+                WFLZW::EncodeStatus::ok)
+            PRINTERROR("Error: encodeBytes() failed\n");
+        inputIndex += amount;
+
+        if(pieces[i].second)
+            encoder->flush();
+    }
+    if(maxByteValue < 255 &&
+       encoder->encodeByte(WFLZW::Byte(maxByteValue + 1)) != WFLZW::EncodeStatus::inputByteTooLarge)
+        PRINTERROR("Error: a too large byte was not rejected\n");
+    encoder->finalizeEncoding();
+
+    gDecodedData.clear();
+    decoder.initialize(maxByteValue, enableFlush);
+    if(decoder.decodeBytes(gEncodedData.data(), gEncodedData.size()) !=
+       WFLZW::DecodeStatus::inputDone || gDecodedData != gInputData)
+        PRINTERROR("Error: decoding the lookahead encoded stream failed\n");
+
+    std::cout << "  Greedy: " << greedySize << " bytes, lookahead: " << gEncodedData.size()
+              << " bytes\n";
+    if(gEncodedData.size() > greedySize)
+        PRINTERROR("Error: lookahead encoding is larger than greedy encoding\n");
+    return true;
+}
+
+bool runLookaheadEncoderTests()
+{
+    using WFLZW::DictionaryType;
+    if(!testLookaheadEncoder<16, DictionaryType::tree>(3, false)) ERRORRET;
+    if(!testLookaheadEncoder<64, DictionaryType::list>(7, true)) ERRORRET;
+    if(!testLookaheadEncoder<1024, DictionaryType::tree>(255, false)) ERRORRET;
+    if(!testLookaheadEncoder<4096, DictionaryType::list>(100, false)) ERRORRET;
+    if(!testLookaheadEncoder<(1U<<16), DictionaryType::tree>(255, true)) ERRORRET;
+    if(!testLookaheadEncoder<(1U<<17), DictionaryType::tree>(255, false)) ERRORRET;
+    return true;
+}
+
+bool runSessionTests()
+{
+    if(!testEndCodeWidth()) ERRORRET;
+    if(!testSession<64>(7, false, 30)) ERRORRET;
+    if(!testSession<1024>(255, false, 0)) ERRORRET;
+    if(!testSession<1024>(255, true, 200)) ERRORRET;
+    if(!testSession<4096>(100, false, 300)) ERRORRET;
+    if(!testSession<(1U<<16)>(255, false, 1000)) ERRORRET;
+    if(!testSession<(1U<<16)>(255, true, 1000)) ERRORRET;
+    return true;
+}
+
+bool runCheckpointTests()
+{
+    if(!testCheckpoints<64>(7, true)) ERRORRET;
+    if(!testCheckpoints<1024>(255, false)) ERRORRET;
+    if(!testCheckpoints<4096>(20, true)) ERRORRET;
+    if(!testCheckpoints<(1U<<16)>(255, false)) ERRORRET;
+    if(!testCheckpoints<(1U<<17)>(255, true)) ERRORRET;
+    return true;
+}
+
+template<unsigned kMaxBitSize>
+class TestClassicEncoder: public WFLZW::ClassicEncoder<kMaxBitSize>
+{
+ public:
+    explicit TestClassicEncoder(const WFLZW::ClassicFormat& format):
+        WFLZW::ClassicEncoder<kMaxBitSize>(format) {}
+
+    virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+    {
+        gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+    }
+};
+
+template<unsigned kMaxBitSize>
+class TestClassicDecoder: public WFLZW::ClassicDecoder<kMaxBitSize>
+{
+ public:
+    explicit TestClassicDecoder(const WFLZW::ClassicFormat& format):
+        WFLZW::ClassicDecoder<kMaxBitSize>(format) {}
+
+    virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
+    {
+        gDecodedData.insert(gDecodedData.end(), bytes, bytes + amount);
+    }
+};
+
+/* The LZW data of "TOBEORNOTTOBEORTOBEORNOT#" as written by Unix compress
+   (-b16), by the GIF encoder of Pillow and by libtiff.
+*/
+bool testClassicFormatVectors()
+{
+    std::cout << "Testing classic LZW formats with known streams\n";
+
+    const char* const kInput = "TOBEORNOTTOBEORTOBEORNOT#";
+    const struct { WFLZW::ClassicFormat format; std::vector<WFLZW::Byte> stream; } kVectors[] =
+    {
+        { WFLZW::unixCompressFormat(16),
+          { 0x1F,0x9D,0x90,0x54,0x9E,0x08,0x29,0xF2,0x44,0x8A,0x93,0x27,0x54,0x02,0x0E,
+            0x2C,0xA8,0x90,0xA0,0x41,0x84,0x23,0x00 } },
+        { WFLZW::gifFormat(8),
+          { 0x00,0xA9,0x3C,0x11,0x52,0xE4,0x89,0x14,0x27,0x4F,0xA8,0x08,0x24,0x68,0x70,
+            0x61,0xC1,0x83,0x09,0x47,0x04,0x04 } },
+        { WFLZW::tiffFormat(),
+          { 0x80,0x15,0x09,0xE4,0x22,0x29,0x3C,0xA4,0x4E,0x27,0x95,0x20,0x50,0x48,0x34,
+            0x2E,0x0B,0x07,0x84,0x88,0xE0,0x20 } }
+    };
+
+    gInputData.assign(kInput, kInput + std::strlen(kInput));
+
+    for(const auto& vector: kVectors)
+    {
+        std::unique_ptr<TestClassicEncoder<16>> encoder(new TestClassicEncoder<16>(vector.format));
+        std::unique_ptr<TestClassicDecoder<16>> decoder(new TestClassicDecoder<16>(vector.format));
+
+        gEncodedData.clear();
+        encoder->encodeBytes(gInputData.data(), gInputData.size());
+        encoder->finalizeEncoding();
+        if(gEncodedData != vector.stream)
+            PRINTERROR("Error: the encoded stream differs from the known stream\n");
+
+        gDecodedData.clear();
+        const WFLZW::DecodeStatus status =
+            decoder->decodeBytes(vector.stream.data(), vector.stream.size());
+        if(status != (vector.format.hasEndCode ? WFLZW::DecodeStatus::inputDone :
+                      WFLZW::DecodeStatus::inputContinues) || gDecodedData != gInputData)
+            PRINTERROR("Error: decoding the known stream failed\n");
+    }
+
+    return true;
+}
+
+template<unsigned kMaxBitSize>
+bool testClassicFormat(const char* formatName, const WFLZW::ClassicFormat& format)
+{
+    std::cout << "Testing classic LZW format " << formatName << ", rootsAmount="
+              << format.rootsAmount << ", maxBitSize=" << format.maxBitSize << "\n";
+
+    std::unique_ptr<TestClassicEncoder<kMaxBitSize>> encoder
+        (new TestClassicEncoder<kMaxBitSize>(format));
+    std::unique_ptr<TestClassicDecoder<kMaxBitSize>> decoder
+        (new TestClassicDecoder<kMaxBitSize>(format));
+    const WFLZW::Byte maxByteValue = WFLZW::Byte(format.rootsAmount - 1);
+    const WFLZW::DecodeStatus expectedStatus =
+        (format.hasEndCode ? WFLZW::DecodeStatus::inputDone : WFLZW::DecodeStatus::inputContinues);
+    std::mt19937 rngEngine(format.rootsAmount + format.maxBitSize);
+
+    for(unsigned sizeIndex = 0; sizeIndex < kDataSizesAmount; ++sizeIndex)
+    {
+        if(kDataSizes[sizeIndex] > 1000000) break;
+
+        for(unsigned inputType = 0; inputType < 2; ++inputType)
+        {
+            if(inputType == 0)
+                createWordsInput(maxByteValue, kDataSizes[sizeIndex], sizeIndex);
+            else
+            {
+                std::uniform_int_distribution<unsigned> randomByte(0, maxByteValue);
+                gInputData.resize(kDataSizes[sizeIndex]);
+                for(WFLZW::Byte& byte: gInputData)
+                    byte = WFLZW::Byte(randomByte(rngEngine));
+            }
+
+            // The encoder is reused, as finalizeEncoding() starts a new stream.
+            gEncodedData.clear();
+            if(encoder->encodeBytes(gInputData.data(), gInputData.size()) !=
+               WFLZW::EncodeStatus::ok)
+                PRINTERROR("Error: encodeBytes() failed\n");
+            if(maxByteValue < 255 &&
+               encoder->encodeByte(WFLZW::Byte(maxByteValue + 1)) !=
+               WFLZW::EncodeStatus::inputByteTooLarge)
+                PRINTERROR("Error: a too large byte was not rejected\n");
+            encoder->finalizeEncoding();
+
+            // Decoded in pieces of various sizes, to resume in the middle of codes.
+            gDecodedData.clear();
+            decoder->initialize(format);
+            WFLZW::DecodeStatus status = WFLZW::DecodeStatus::inputContinues;
+            for(std::size_t inputIndex = 0; inputIndex < gEncodedData.size();)
+            {
+                const std::size_t amount = std::min(std::size_t(1 + rngEngine() % 100),
+                                                    gEncodedData.size() - inputIndex);
+                status = decoder->decodeBytes(gEncodedData.data() + inputIndex, amount);
+                inputIndex += amount;
+            }
+
+            if(status != expectedStatus || gDecodedData != gInputData)
+                PRINTERROR("Error: decoding failed with input size ", gInputData.size(),
+                           " (gDecodedData.size()=", gDecodedData.size(), ")\n");
+        }
+    }
+
+    return true;
+}
+
+bool testClassicFormatInvalidInput()
+{
+    std::cout << "Testing classic LZW formats with invalid input\n";
+
+    std::unique_ptr<TestClassicDecoder<16>> decoder
+        (new TestClassicDecoder<16>(WFLZW::unixCompressFormat()));
+
+    // A wrong magic number, and a larger maximum code width than the decoder supports.
+    const WFLZW::Byte kBadMagic[] = { 0x1F, 0x8B, 0x90, 0x54 };
+    const WFLZW::Byte kTooWide[] = { 0x1F, 0x9D, 0x91, 0x54 };
+    if(decoder->decodeBytes(kBadMagic, sizeof(kBadMagic)) != WFLZW::DecodeStatus::inputError)
+        PRINTERROR("Error: a wrong magic number was not detected\n");
+    decoder->initialize(WFLZW::unixCompressFormat());
+    if(decoder->decodeBytes(kTooWide, sizeof(kTooWide)) != WFLZW::DecodeStatus::inputError)
+        PRINTERROR("Error: a too large code width was not detected\n");
+
+    // GIF with 2-bit pixels: the clear code (4) followed by code 7, which isn't defined yet.
+    const WFLZW::Byte kUndefinedCode[] = { 0x3C, 0x00 };
+    decoder->initialize(WFLZW::gifFormat(2));
+    if(decoder->decodeBytes(kUndefinedCode, sizeof(kUndefinedCode)) !=
+       WFLZW::DecodeStatus::inputError)
+        PRINTERROR("Error: an undefined code was not detected\n");
+
+    return true;
+}
+
+bool runClassicFormatTests()
+{
+    if(!testClassicFormatVectors()) ERRORRET;
+    if(!testClassicFormatInvalidInput()) ERRORRET;
+    if(!testClassicFormat<16>("compress", WFLZW::unixCompressFormat(16))) ERRORRET;
+    if(!testClassicFormat<12>("compress", WFLZW::unixCompressFormat(10))) ERRORRET;
+
+    WFLZW::ClassicFormat nonBlockFormat = WFLZW::unixCompressFormat(12);
+    nonBlockFormat.hasClearCode = false;
+    if(!testClassicFormat<16>("compress without clear code", nonBlockFormat)) ERRORRET;
+
+    if(!testClassicFormat<12>("GIF", WFLZW::gifFormat(8))) ERRORRET;
+    if(!testClassicFormat<12>("GIF", WFLZW::gifFormat(2))) ERRORRET;
+    if(!testClassicFormat<12>("TIFF", WFLZW::tiffFormat())) ERRORRET;
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+class TestPatternSearcher: public WFLZW::PatternSearcher<kDictionaryMaxSize>
+{
+ public:
+    std::vector<std::uint64_t> mMatchOffsets;
+
+    TestPatternSearcher(const WFLZW::Byte* pattern, std::size_t patternLength):
+        WFLZW::PatternSearcher<kDictionaryMaxSize>(pattern, patternLength) {}
+
+    virtual void outputMatch(std::uint64_t offset) { mMatchOffsets.push_back(offset); }
+};
+
+template<unsigned kDictionaryMaxSize>
+bool testPatternSearch(WFLZW::Byte maxByteValue, bool enableFlush)
+{
+    std::cout << "Testing pattern search with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << ", maxByteValue=" << unsigned(maxByteValue) << ", enableFlush="
+              << enableFlush << "\n";
+
+    createWordsInput(maxByteValue, 300000, 8);
+    TestEncoderContainer<kDictionaryMaxSize> encoderContainer;
+    TestEncoder<kDictionaryMaxSize>& encoder = encoderContainer.instance();
+    gEncodedData.clear();
+    encoder.initialize(maxByteValue, enableFlush);
+    for(std::size_t index = 0; index < gInputData.size(); index += 10000)
+    {
+        encoder.encodeBytes(gInputData.data() + index, 10000);
+        if(enableFlush) encoder.flush();
+    }
+    encoder.finalizeEncoding();
+
+    // Patterns from the input (of which the longer ones are repeated words and
+    // runs of the same byte), one with the same byte, and one that isn't in it.
+    std::mt19937 rngEngine(8);
+    std::vector<std::vector<WFLZW::Byte>> patterns;
+    for(unsigned i = 0; i < 60; ++i)
+    {
+        const std::size_t length = 1 + i % 20 * (1 + i / 20), offset = rngEngine() % 290000;
+        patterns.emplace_back(gInputData.begin() + offset, gInputData.begin() + offset + length);
+    }
+    patterns.emplace_back(40, gInputData[1000]);
+    patterns.emplace_back(3, WFLZW::Byte(maxByteValue + 1));
+
+    std::unique_ptr<TestPatternSearcher<kDictionaryMaxSize>> searcher
+        (new TestPatternSearcher<kDictionaryMaxSize>(patterns[0].data(), patterns[0].size()));
+    for(const std::vector<WFLZW::Byte>& pattern: patterns)
+    {
+        std::vector<std::uint64_t> expectedOffsets;
+        for(auto iter = gInputData.begin();
+            (iter = std::search(iter, gInputData.end(), pattern.begin(), pattern.end())) !=
+                gInputData.end(); ++iter)
+            expectedOffsets.push_back(std::uint64_t(iter - gInputData.begin()));
+
+        // In pieces of various sizes, to also end the input in the middle of codes.
+        searcher->initialize(maxByteValue, enableFlush);
+        searcher->setPattern(pattern.data(), pattern.size());
+        searcher->mMatchOffsets.clear();
+        WFLZW::DecodeStatus status = WFLZW::DecodeStatus::inputContinues;
+        for(std::size_t index = 0;
+            index < gEncodedData.size() && status == WFLZW::DecodeStatus::inputContinues;)
+        {
+            const std::size_t amount =
+                std::min(std::size_t(1 + rngEngine() % 2000), gEncodedData.size() - index);
+            status = searcher->searchBytes(gEncodedData.data() + index, amount);
+            index += amount;
+        }
+
+        if(status != WFLZW::DecodeStatus::inputDone ||
+           searcher->decompressedSize() != gInputData.size())
+            PRINTERROR("Error: searching failed with a pattern of length ", pattern.size(), "\n");
+        if(searcher->mMatchOffsets != expectedOffsets ||
+           searcher->matchesAmount() != expectedOffsets.size())
+            PRINTERROR("Error: found ", searcher->mMatchOffsets.size(), " occurrences instead of ",
+                       expectedOffsets.size(), " with a pattern of length ", pattern.size(), "\n");
+    }
+
+    // Invalid input is detected like by the decoder.
+    TestDecoderContainer<kDictionaryMaxSize> decoderContainer;
+    TestDecoder<kDictionaryMaxSize>& decoder = decoderContainer.instance();
+    const std::vector<WFLZW::Byte> validStream = gEncodedData;
+    for(unsigned i = 0; i < 100; ++i)
+    {
+        std::vector<WFLZW::Byte> stream(validStream.begin(), validStream.begin() + 20000);
+        stream[rngEngine() % stream.size()] ^= WFLZW::Byte(1U << (rngEngine() % 8));
+        decoder.initialize(maxByteValue, enableFlush);
+        searcher->initialize(maxByteValue, enableFlush);
+        if(searcher->searchBytes(stream.data(), stream.size()) !=
+           decoder.decodeBytes(stream.data(), stream.size()))
+            PRINTERROR("Error: the searcher and the decoder disagree on corrupted input\n");
+    }
+
+    return true;
+}
+
+bool runPatternSearchTests()
+{
+    if(!testPatternSearch<64>(7, true)) ERRORRET;
+    if(!testPatternSearch<1024>(3, false)) ERRORRET;
+    if(!testPatternSearch<4096>(100, true)) ERRORRET;
+    if(!testPatternSearch<65536>(255, false)) ERRORRET;
+    if(!testPatternSearch<131072>(1, false)) ERRORRET;
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictionaryType>
+bool testVerifyingEncoder(WFLZW::Byte maxByteValue, bool enableFlush)
+{
+    std::cout << "Testing verifying encoder with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << ", " << (kDictionaryType == WFLZW::DictionaryType::list ? "list" : "tree")
+              << ", maxByteValue=" << unsigned(maxByteValue) << ", enableFlush="
+              << enableFlush << "\n";
+
+    class VerifyingEncoder: public WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictionaryType>
+    {
+     public:
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+        }
+    };
+
+    class ReferenceEncoder: public WFLZW::Encoder<kDictionaryMaxSize, kDictionaryType>
+    {
+     public:
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+        }
+    };
+
+    std::unique_ptr<VerifyingEncoder> encoder(new VerifyingEncoder);
+    std::unique_ptr<ReferenceEncoder> referenceEncoder(new ReferenceEncoder);
+
+    createWordsInput(maxByteValue, 300000, kDictionaryMaxSize + 1);
+    std::mt19937 rngEngine(kDictionaryMaxSize + maxByteValue);
+
+    // The same pieces, flushes and messages (and a second stream) to both
+    // encoders, whose output has to be the same.
+    std::vector<WFLZW::Byte> expectedData;
+    gEncodedData.clear();
+    encoder->initialize(maxByteValue, enableFlush);
+    referenceEncoder->initialize(maxByteValue, enableFlush);
+    for(std::size_t inputIndex = 0; inputIndex < gInputData.size();)
+    {
+        const std::size_t amount = std::min(std::size_t(rngEngine() % (rngEngine() % 2 ? 20 : 40000)),
+                                            gInputData.size() - inputIndex);
+        WFLZW::EncodeStatus status;
+        gEncodedData.swap(expectedData);
+        if(amount == 1)
+        {
+            referenceEncoder->encodeByte(gInputData[inputIndex]);
+            gEncodedData.swap(expectedData);
+            status = encoder->encodeByte(gInputData[inputIndex]);
+        }
+        else
+        {
+            referenceEncoder->encodeBytes(gInputData.data() + inputIndex, amount);
+            gEncodedData.swap(expectedData);
+            status = encoder->encodeBytes(gInputData.data() + inputIndex, amount);
+        }
+        if(status != WFLZW::EncodeStatus::ok)
+            PRINTERROR("Error: encoding ", amount, " bytes at ", inputIndex, " failed\n");
+        inputIndex += amount;
+
+        const unsigned selector = rngEngine() % 40;
+        if(selector == 0 || (enableFlush && selector < 3))
+        {
+            gEncodedData.swap(expectedData);
+            if(selector == 0) referenceEncoder->finalizeMessage();
+            else referenceEncoder->flush();
+            gEncodedData.swap(expectedData);
+            if((selector == 0 ? encoder->finalizeMessage() : encoder->flush()) !=
+               WFLZW::EncodeStatus::ok)
+                PRINTERROR("Error: verification failed at ", inputIndex, "\n");
+        }
+
+        if(inputIndex >= gInputData.size() / 2 && inputIndex - amount < gInputData.size() / 2)
+        {
+            gEncodedData.swap(expectedData);
+            referenceEncoder->finalizeEncoding();
+            gEncodedData.swap(expectedData);
+            if(encoder->finalizeEncoding() != WFLZW::EncodeStatus::ok)
+                PRINTERROR("Error: verification failed at the end of the first stream\n");
+        }
+    }
+    if(maxByteValue < 255 &&
+       encoder->encodeByte(WFLZW::Byte(maxByteValue + 1)) != WFLZW::EncodeStatus::inputByteTooLarge)
+        PRINTERROR("Error: a too large byte was not rejected\n");
+    gEncodedData.swap(expectedData);
+    referenceEncoder->finalizeEncoding();
+    gEncodedData.swap(expectedData);
+    if(encoder->finalizeEncoding() != WFLZW::EncodeStatus::ok)
+        PRINTERROR("Error: verification failed at the end\n");
+    if(gEncodedData != expectedData)
+        PRINTERROR("Error: the output differs from that of WFLZW::Encoder\n");
+
+    // With a remapper, the bytes before an unmapped one are encoded.
+    if(maxByteValue < 255)
+    {
+        std::vector<WFLZW::Byte> input(gInputData.begin(), gInputData.begin() + 50000);
+        input[30000] = WFLZW::Byte(maxByteValue + 1);
+        WFLZW::ByteRemapper remapper;
+        remapper.createEncodeMapFromInputBytes(input.data(), 30000, WFLZW::RootOrder::frequency);
+
+        gEncodedData.clear();
+        encoder->initialize(remapper.maxByteValue(), enableFlush);
+        if(encoder->encodeBytes(input.data(), input.size(), remapper) !=
+           WFLZW::EncodeStatus::inputByteTooLarge ||
+           encoder->finalizeEncoding() != WFLZW::EncodeStatus::ok)
+            PRINTERROR("Error: encoding up to a too large byte failed\n");
+
+        TestDecoderContainer<kDictionaryMaxSize> decoderContainer;
+        TestDecoder<kDictionaryMaxSize>& decoder = decoderContainer.instance();
+        gDecodedData.clear();
+        decoder.initialize(remapper.maxByteValue(), enableFlush);
+        if(decoder.decodeBytes(gEncodedData.data(), gEncodedData.size()) !=
+           WFLZW::DecodeStatus::inputDone || gDecodedData.size() != 30000)
+            PRINTERROR("Error: decoding the stream up to a too large byte failed\n");
+        for(std::size_t i = 0; i < gDecodedData.size(); ++i)
+            if(remapper.decodeMap[gDecodedData[i]] != input[i])
+                PRINTERROR("Error: decoded byte ", i, " is wrong\n");
+    }
+
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize, WFLZW::DictionaryType kDictionaryType>
+bool testVerificationFailure(WFLZW::Byte maxByteValue, std::size_t inputSize)
+{
+    std::cout << "Testing verification failure with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << ", " << (kDictionaryType == WFLZW::DictionaryType::list ? "list" : "tree")
+              << ", maxByteValue=" << unsigned(maxByteValue) << ", inputSize=" << inputSize
+              << "\n";
+
+    // Replaces the first literal code with another literal the first time
+    // output is written, before the codes are verified.
+    class CorruptingEncoder: public WFLZW::VerifyingEncoder<kDictionaryMaxSize, kDictionaryType>
+    {
+     public:
+        bool corrupt = true;
+
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+            if(!corrupt) return;
+            for(auto& code: this->codeLog())
+            {
+                if(code <= this->maxByteValue())
+                {
+                    code = (code == 0 ? 1 : code - 1);
+                    corrupt = false;
+                    return;
+                }
+            }
+        }
+    };
+
+    std::unique_ptr<CorruptingEncoder> encoder(new CorruptingEncoder);
+    createWordsInput(maxByteValue, inputSize, kDictionaryMaxSize + 1);
+
+    // A large input fails during encodeBytes(), a small one (whose output
+    // all fits in the output buffer) only when it's finalized.
+    gEncodedData.clear();
+    encoder->initialize(maxByteValue);
+    WFLZW::EncodeStatus status = encoder->encodeBytes(gInputData.data(), gInputData.size());
+    if(status == WFLZW::EncodeStatus::ok)
+        status = encoder->finalizeEncoding();
+    if(status != WFLZW::EncodeStatus::verificationFailed)
+        PRINTERROR("Error: a corrupted code was not detected\n");
+    if(encoder->corrupt)
+        PRINTERROR("Error: no code was corrupted\n");
+
+    // The failure sticks, and nothing more is encoded, until initialize().
+    const std::size_t encodedSize = gEncodedData.size();
+    if(encoder->encodeByte(0) != WFLZW::EncodeStatus::verificationFailed ||
+       encoder->encodeBytes(gInputData.data(), gInputData.size()) !=
+       WFLZW::EncodeStatus::verificationFailed ||
+       encoder->flush() != WFLZW::EncodeStatus::verificationFailed ||
+       encoder->finalizeMessage() != WFLZW::EncodeStatus::verificationFailed ||
+       encoder->finalizeEncoding() != WFLZW::EncodeStatus::verificationFailed)
+        PRINTERROR("Error: the verification failure didn't persist\n");
+    if(gEncodedData.size() != encodedSize)
+        PRINTERROR("Error: output was written after the verification failure\n");
+
+    gEncodedData.clear();
+    encoder->initialize(maxByteValue);
+    if(encoder->encodeBytes(gInputData.data(), gInputData.size()) != WFLZW::EncodeStatus::ok ||
+       encoder->finalizeEncoding() != WFLZW::EncodeStatus::ok)
+        PRINTERROR("Error: encoding after initialize() failed\n");
+
+    TestDecoderContainer<kDictionaryMaxSize> decoderContainer;
+    TestDecoder<kDictionaryMaxSize>& decoder = decoderContainer.instance();
+    gDecodedData.clear();
+    decoder.initialize(maxByteValue);
+    if(decoder.decodeBytes(gEncodedData.data(), gEncodedData.size()) !=
+       WFLZW::DecodeStatus::inputDone || gDecodedData != gInputData)
+        PRINTERROR("Error: decoding the stream encoded after initialize() failed\n");
+
+    return true;
+}
+
+bool runVerifyingEncoderTests()
+{
+    using WFLZW::DictionaryType;
+    if(!testVerifyingEncoder<16, DictionaryType::tree>(3, false)) ERRORRET;
+    if(!testVerifyingEncoder<64, DictionaryType::list>(7, true)) ERRORRET;
+    if(!testVerifyingEncoder<1024, DictionaryType::tree>(255, true)) ERRORRET;
+    if(!testVerifyingEncoder<4096, DictionaryType::list>(100, false)) ERRORRET;
+    if(!testVerifyingEncoder<(1U<<16), DictionaryType::tree>(200, true)) ERRORRET;
+    if(!testVerifyingEncoder<(1U<<17), DictionaryType::tree>(255, false)) ERRORRET;
+    if(!testVerificationFailure<64, DictionaryType::list>(7, 100000)) ERRORRET;
+    if(!testVerificationFailure<4096, DictionaryType::tree>(255, 100000)) ERRORRET;
+    if(!testVerificationFailure<4096, DictionaryType::tree>(255, 100)) ERRORRET;
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+bool testConvenienceFunctions()
+{
+    std::cout << "Testing compress() and decompress() with kDictionaryMaxSize="
+              << kDictionaryMaxSize << "\n";
+
+    TestEncoderContainer<kDictionaryMaxSize> encoderContainer;
+    TestEncoder<kDictionaryMaxSize>& encoder = encoderContainer.instance();
+    std::mt19937 rngEngine(5);
+    std::uniform_int_distribution<unsigned> randomByte(0, 40);
+
+    for(std::size_t dataSize: { 0, 1, 2, 100, 5000, 300000 })
+    {
+        gInputData.resize(dataSize);
+        for(auto& byte: gInputData) byte = WFLZW::Byte(randomByte(rngEngine));
+        const WFLZW::Byte* const input = gInputData.data();
+
+        gEncodedData.clear();
+        encoder.initialize();
+        encoder.encodeBytes(input, dataSize);
+        encoder.finalizeEncoding();
+
+        const std::vector<WFLZW::Byte> compressed =
+            WFLZW::compress<kDictionaryMaxSize>(input, dataSize);
+        if(compressed != gEncodedData)
+            PRINTERROR("Error: compress() output differs from Encoder, size ", dataSize, "\n");
+        if(compressed.size() > WFLZW::compressedSizeBound<kDictionaryMaxSize>(dataSize))
+            PRINTERROR("Error: compressedSizeBound() is too small\n");
+
+        std::string compressedString = "abc";
+        if(WFLZW::compress<kDictionaryMaxSize>(input, dataSize, compressedString) !=
+           WFLZW::EncodeStatus::ok ||
+           compressedString.compare(0, 3, "abc") != 0 ||
+           !std::equal(compressed.begin(), compressed.end(),
+                       reinterpret_cast<const WFLZW::Byte*>(compressedString.data()) + 3))
+            PRINTERROR("Error: compress() into a string failed\n");
+
+        for(std::size_t sizeHint: { std::size_t(0), dataSize, dataSize / 3 })
+        {
+            std::vector<WFLZW::Byte> decompressed(2, 7);
+            if(WFLZW::decompress<kDictionaryMaxSize>(compressed.data(), compressed.size(),
+                                                     decompressed, sizeHint) !=
+               WFLZW::DecodeStatus::inputDone ||
+               decompressed.size() != dataSize + 2 || decompressed[0] != 7 ||
+               !std::equal(gInputData.begin(), gInputData.end(), decompressed.begin() + 2))
+                PRINTERROR("Error: decompress() with size hint ", sizeHint, " failed\n");
+        }
+
+        std::string decompressedString;
+        if(WFLZW::decompress<kDictionaryMaxSize>(compressed.data(), compressed.size(),
+                                                 decompressedString) !=
+           WFLZW::DecodeStatus::inputDone ||
+           !std::equal(gInputData.begin(), gInputData.end(),
+                       reinterpret_cast<const WFLZW::Byte*>(decompressedString.data())) ||
+           WFLZW::decompress<kDictionaryMaxSize>(compressed.data(), compressed.size(), dataSize)
+           != gInputData)
+            PRINTERROR("Error: decompress() failed\n");
+
+        if(WFLZW::decompress<kDictionaryMaxSize>(compressed.data(), compressed.size() - 1,
+                                                 decompressedString) !=
+           WFLZW::DecodeStatus::inputError ||
+           !WFLZW::decompress<kDictionaryMaxSize>(compressed.data(), compressed.size() - 1).empty())
+            PRINTERROR("Error: decompress() didn't detect truncated input\n");
+    }
+
+    if(kDictionaryMaxSize <= 257)
+    {
+        gInputData.assign(1000, WFLZW::Byte(10));
+        gInputData[500] = WFLZW::Byte(kDictionaryMaxSize - 2);
+        std::vector<WFLZW::Byte> compressed;
+        if(WFLZW::compress<kDictionaryMaxSize>(gInputData.data(), gInputData.size(), compressed) !=
+           WFLZW::EncodeStatus::inputByteTooLarge ||
+           !WFLZW::compress<kDictionaryMaxSize>(gInputData.data(), gInputData.size()).empty())
+            PRINTERROR("Error: compress() didn't detect a byte too large for the dictionary\n");
+    }
+
+    return true;
+}
+
+bool runConvenienceFunctionTests()
+{
+    if(!testConvenienceFunctions<64>()) ERRORRET;
+    if(!testConvenienceFunctions<4096>()) ERRORRET;
+    if(!testConvenienceFunctions<(1U<<16)>()) ERRORRET;
+    if(!testConvenienceFunctions<(1U<<20)>()) ERRORRET;
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+bool testResetPoints()
+{
+    std::cout << "Testing reset points with kDictionaryMaxSize=" << kDictionaryMaxSize << "\n";
+
+    std::mt19937 rngEngine(42);
+    std::uniform_int_distribution<unsigned> randomByte(0, 40);
+
+    for(std::size_t dataSize: { 0, 1, 100, 5000, 300000 })
+    {
+        gInputData.resize(dataSize);
+        for(auto& byte: gInputData) byte = WFLZW::Byte(randomByte(rngEngine));
+        const WFLZW::Byte* const input = gInputData.data();
+
+        std::vector<WFLZW::Byte> compressed;
+        std::vector<WFLZW::ResetPoint> resetPoints(3);
+        if(WFLZW::compress<kDictionaryMaxSize>(input, dataSize, compressed, resetPoints) !=
+           WFLZW::EncodeStatus::ok ||
+           compressed != WFLZW::compress<kDictionaryMaxSize>(input, dataSize))
+            PRINTERROR("Error: compress() with reset points failed, size ", dataSize, "\n");
+        if(dataSize == 300000 && resetPoints.size() < 10)
+            PRINTERROR("Error: only ", resetPoints.size(), " reset points\n");
+
+        std::vector<WFLZW::Byte> decompressed;
+        for(std::size_t i = 0; i <= resetPoints.size(); ++i)
+        {
+            const std::size_t startOffset = (i > 0 ? resetPoints[i - 1].byteOffset : 0);
+            const std::size_t endOffset =
+                (i < resetPoints.size() ? resetPoints[i].byteOffset : dataSize);
+            std::vector<WFLZW::Byte> segment(1, 7);
+            if(WFLZW::decompressSegment<kDictionaryMaxSize>
+               (compressed.data(), compressed.size(), resetPoints, i, segment) !=
+               WFLZW::DecodeStatus::inputDone ||
+               segment.size() != endOffset - startOffset + 1 || segment[0] != 7 ||
+               !std::equal(segment.begin() + 1, segment.end(), gInputData.begin() + startOffset))
+                PRINTERROR("Error: decompressSegment() failed for segment ", i,
+                           ", size ", dataSize, "\n");
+        }
+
+#ifdef WFLZW_USE_THREADS
+        for(unsigned threadsAmount: { 1, 3, 8 })
+        {
+            decompressed.clear();
+            if(WFLZW::decompressInParallel<kDictionaryMaxSize>
+               (compressed.data(), compressed.size(), resetPoints, decompressed,
+                threadsAmount) != WFLZW::DecodeStatus::inputDone ||
+               decompressed != gInputData)
+                PRINTERROR("Error: decompressInParallel() failed with ", threadsAmount,
+                           " threads, size ", dataSize, "\n");
+        }
+#endif
+
+        std::vector<WFLZW::Byte> sidecar;
+        std::vector<WFLZW::ResetPoint> readPoints;
+        WFLZW::writeResetPoints(resetPoints, sidecar);
+        if(sidecar.size() != resetPoints.size() * 16 ||
+           !WFLZW::readResetPoints(sidecar.data(), sidecar.size(), readPoints) ||
+           readPoints.size() != resetPoints.size() ||
+           !std::equal(readPoints.begin(), readPoints.end(), resetPoints.begin(),
+                       [](const WFLZW::ResetPoint& a, const WFLZW::ResetPoint& b)
+                       { return a.bitOffset == b.bitOffset && a.byteOffset == b.byteOffset; }))
+            PRINTERROR("Error: reset point serialization failed, size ", dataSize, "\n");
+
+        if(WFLZW::readResetPoints(sidecar.data(), sidecar.size() + 1, readPoints) ||
+           WFLZW::decompressSegment<kDictionaryMaxSize>
+           (compressed.data(), compressed.size(), resetPoints, resetPoints.size() + 1,
+            decompressed) != WFLZW::DecodeStatus::inputError)
+            PRINTERROR("Error: invalid reset point input not detected\n");
+
+        if(resetPoints.size() >= 2)
+        {
+            std::vector<WFLZW::ResetPoint> corruptPoints = resetPoints;
+            corruptPoints[0].byteOffset += 1;
+            decompressed.clear();
+            if(WFLZW::decompressSegment<kDictionaryMaxSize>
+               (compressed.data(), compressed.size(), corruptPoints, 1, decompressed) ==
+               WFLZW::DecodeStatus::inputDone)
+                PRINTERROR("Error: corrupt reset point not detected\n");
+#ifdef WFLZW_USE_THREADS
+            if(WFLZW::decompressInParallel<kDictionaryMaxSize>
+               (compressed.data(), compressed.size(), corruptPoints, decompressed, 2) ==
+               WFLZW::DecodeStatus::inputDone)
+                PRINTERROR("Error: corrupt reset point not detected in parallel\n");
+#endif
+
+            std::swap(corruptPoints[0], corruptPoints[1]);
+            if(WFLZW::decompressSegment<kDictionaryMaxSize>
+               (compressed.data(), compressed.size(), corruptPoints, 1, decompressed) ==
+               WFLZW::DecodeStatus::inputDone)
+                PRINTERROR("Error: unordered reset points not detected\n");
+#ifdef WFLZW_USE_THREADS
+            if(WFLZW::decompressInParallel<kDictionaryMaxSize>
+               (compressed.data(), compressed.size(), corruptPoints, decompressed, 2) ==
+               WFLZW::DecodeStatus::inputDone)
+                PRINTERROR("Error: unordered reset points not detected in parallel\n");
+#endif
+        }
+
+#ifdef WFLZW_USE_THREADS
+        // Reset points that pass readResetPoints() but promise far more data than the input holds.
+        for(const WFLZW::ResetPoint& resetPoint:
+            { WFLZW::ResetPoint { 8, std::uint64_t(1) << 50 },
+              WFLZW::ResetPoint { std::uint64_t(compressed.size()) * 8 + 1, 10 } })
+        {
+            const std::vector<WFLZW::ResetPoint> corruptPoints(1, resetPoint);
+            decompressed.clear();
+            if(WFLZW::decompressInParallel<kDictionaryMaxSize>
+               (compressed.data(), compressed.size(), corruptPoints, decompressed, 2) ==
+               WFLZW::DecodeStatus::inputDone)
+                PRINTERROR("Error: reset point ", resetPoint.bitOffset, " not detected\n");
+        }
+#endif
+    }
+
+    // Reset points reported by Encoder, with flushes, decoded with startAtBitOffset().
+    class ResetPointEncoder: public WFLZW::Encoder<kDictionaryMaxSize>
+    {
+     public:
+        std::vector<WFLZW::ResetPoint> mResetPoints;
+
+        ResetPointEncoder(): WFLZW::Encoder<kDictionaryMaxSize>(15, true) {}
+
+        virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+        {
+            gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+        }
+
+        virtual void outputResetPoint(const WFLZW::ResetPoint& resetPoint)
+        {
+            mResetPoints.push_back(resetPoint);
+        }
+    };
+
+    class ResetPointDecoder: public WFLZW::Decoder<kDictionaryMaxSize>
+    {
+     public:
+        ResetPointDecoder(): WFLZW::Decoder<kDictionaryMaxSize>(15, true) {}
+
+        virtual void outputDecodedBytes(WFLZW::Byte* bytes, unsigned amount)
+        {
+            gDecodedData.insert(gDecodedData.end(), bytes, bytes + amount);
+        }
+    };
+
+    std::unique_ptr<ResetPointEncoder> encoder(new ResetPointEncoder);
+    std::unique_ptr<ResetPointDecoder> decoder(new ResetPointDecoder);
+    std::uniform_int_distribution<unsigned> randomNibble(0, 15);
+    gInputData.resize(100000);
+    gEncodedData.clear();
+
+    for(std::size_t i = 0; i < gInputData.size(); ++i)
+    {
+        gInputData[i] = WFLZW::Byte(randomNibble(rngEngine));
+        encoder->encodeByte(gInputData[i]);
+        if(i % 777 == 0) encoder->flush();
+    }
+    encoder->finalizeEncoding();
+
+    if(encoder->mResetPoints.empty())
+        PRINTERROR("Error: Encoder reported no reset points\n");
+
+    for(const WFLZW::ResetPoint& resetPoint: encoder->mResetPoints)
+    {
+        const std::size_t byteIndex = resetPoint.bitOffset / 8;
+        gDecodedData.clear();
+        decoder->initialize(15, true);
+        decoder->startAtBitOffset(gEncodedData[byteIndex], resetPoint.bitOffset % 8);
+        if(decoder->decodeBytes(gEncodedData.data() + byteIndex + 1,
+                                gEncodedData.size() - byteIndex - 1) !=
+           WFLZW::DecodeStatus::inputDone ||
+           gDecodedData.size() != gInputData.size() - resetPoint.byteOffset ||
+           !std::equal(gDecodedData.begin(), gDecodedData.end(),
+                       gInputData.begin() + resetPoint.byteOffset))
+            PRINTERROR("Error: decoding from reset point at bit ", resetPoint.bitOffset,
+                       " failed\n");
+    }
+
+    return true;
+}
+
+bool runResetPointTests()
+{
+    if(!testResetPoints<1024>()) ERRORRET;
+    if(!testResetPoints<4096>()) ERRORRET;
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+bool testDecoderStream(unsigned maxInputChunkSize, unsigned maxOutputChunkSize)
+{
+    std::cout << "Testing DecoderStream with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << ", maxInputChunkSize=" << maxInputChunkSize
+              << ", maxOutputChunkSize=" << maxOutputChunkSize << "\n";
+
+    std::mt19937 rngEngine(6);
+    std::uniform_int_distribution<unsigned> randomByte(0, 3);
+    std::uniform_int_distribution<unsigned> inputChunkSize(0, maxInputChunkSize);
+    std::uniform_int_distribution<unsigned> outputChunkSize(1, maxOutputChunkSize);
+    gInputData.resize(200000);
+    for(auto& byte: gInputData) byte = WFLZW::Byte(randomByte(rngEngine));
+    const std::vector<WFLZW::Byte> compressed =
+        WFLZW::compress<kDictionaryMaxSize>(gInputData.data(), gInputData.size());
+
+    const std::vector<WFLZW::Byte> trailingBytes = { 1, 2, 3 };
+    std::vector<WFLZW::Byte> streamInput = compressed, outputChunk(maxOutputChunkSize);
+    streamInput.insert(streamInput.end(), trailingBytes.begin(), trailingBytes.end());
+
+    std::unique_ptr<WFLZW::DecoderStream<kDictionaryMaxSize>> stream
+        (new WFLZW::DecoderStream<kDictionaryMaxSize>);
+    gDecodedData.clear();
+    std::size_t inputIndex = 0;
+    WFLZW::StreamStatus status = WFLZW::StreamStatus::inputNeeded;
+
+    while(status != WFLZW::StreamStatus::done)
+    {
+        if(status == WFLZW::StreamStatus::inputNeeded)
+        {
+            if(inputIndex == streamInput.size())
+                PRINTERROR("Error: DecoderStream needs input past the end\n");
+            const std::size_t amount = std::min(std::size_t(inputChunkSize(rngEngine)),
+                                                streamInput.size() - inputIndex);
+            stream->setInput(&streamInput[inputIndex], amount);
+            inputIndex += amount;
+        }
+
+        const std::size_t capacity = outputChunkSize(rngEngine);
+        std::size_t outputAmount = 0;
+        status = stream->decode(outputChunk.data(), capacity, outputAmount);
+        if(outputAmount > capacity || status == WFLZW::StreamStatus::inputError ||
+           (status == WFLZW::StreamStatus::outputFull && outputAmount != capacity))
+            PRINTERROR("Error: DecoderStream::decode() returned a wrong status\n");
+        gDecodedData.insert(gDecodedData.end(), outputChunk.begin(),
+                            outputChunk.begin() + outputAmount);
+    }
+
+    if(gDecodedData != gInputData)
+        PRINTERROR("Error: DecoderStream output is wrong\n");
+    if(stream->remainingInputAmount() + streamInput.size() - inputIndex != trailingBytes.size())
+        PRINTERROR("Error: DecoderStream consumed a wrong amount of input\n");
+
+    std::size_t outputAmount = 0;
+    stream->initialize();
+    stream->setInput(compressed.data(), compressed.size() - 1);
+    while((status = stream->decode(outputChunk.data(), outputChunk.size(), outputAmount)) ==
+          WFLZW::StreamStatus::outputFull) {}
+    if(status != WFLZW::StreamStatus::inputNeeded)
+        PRINTERROR("Error: DecoderStream didn't request more input for truncated data\n");
+
+    return true;
+}
+
+bool runDecoderStreamTests()
+{
+    if(!testDecoderStream<1024>(1, 1)) ERRORRET;
+    if(!testDecoderStream<1024>(100, 7)) ERRORRET;
+    if(!testDecoderStream<(1U<<16)>(3, 1000)) ERRORRET;
+    if(!testDecoderStream<(1U<<16)>(5000, 50)) ERRORRET;
+    return true;
+}
+
+bool testByteRemapper(WFLZW::RootOrder rootOrder)
+{
+    std::cout << "Testing byte remapper with "
+              << (rootOrder == WFLZW::RootOrder::frequency ? "frequency" : "byte value")
+              << " order\n";
+
+    // Bytes 'a'+n with probability roughly proportional to 1/(n+1).
+    std::mt19937 rngEngine(8);
+    std::uniform_int_distribution<unsigned> randomValue(1, 1000);
+    gInputData.resize(300000);
+    for(auto& byte: gInputData) byte = WFLZW::Byte('a' + 1000 / randomValue(rngEngine) - 1);
+
+    WFLZW::ByteRemapper remapper;
+    remapper.createEncodeMapFromInputBytes(gInputData.data(), gInputData.size(), rootOrder);
+    std::vector<unsigned> counts(256);
+    for(WFLZW::Byte byte: gInputData) ++counts[byte];
+    const unsigned distinctBytesAmount =
+        unsigned(256 - std::count(counts.begin(), counts.end(), 0U));
+    if(remapper.decodeMapSize != distinctBytesAmount ||
+       remapper.maxByteValue() != distinctBytesAmount - 1)
+        PRINTERROR("Error: wrong amount of remapped bytes\n");
+
+    for(unsigned i = 0; i < remapper.decodeMapSize; ++i)
+    {
+        if(remapper.encodeMap[remapper.decodeMap[i]] != i)
+            PRINTERROR("Error: encodeMap and decodeMap don't match\n");
+        if(i > 0 && (rootOrder == WFLZW::RootOrder::frequency ?
+                     counts[remapper.decodeMap[i - 1]] < counts[remapper.decodeMap[i]] :
+                     remapper.decodeMap[i - 1] > remapper.decodeMap[i]))
+            PRINTERROR("Error: remapped bytes are in the wrong order\n");
+    }
+
+    TestEncoderContainer<(1U<<16)> encoderContainer;
+    TestDecoderContainer<(1U<<16)> decoderContainer;
+    TestEncoder<(1U<<16)>& encoder = encoderContainer.instance();
+    TestDecoder<(1U<<16)>& decoder = decoderContainer.instance();
+    gEncodedData.clear();
+    gDecodedData.clear();
+    encoder.initialize(remapper.maxByteValue());
+    if(encoder.encodeBytes(gInputData.data(), gInputData.size(), remapper) !=
+       WFLZW::EncodeStatus::ok)
+        PRINTERROR("Error: encoding with the remapper failed\n");
+    const WFLZW::Byte unseenByte = 'a' - 1;
+    if(encoder.encodeByte(unseenByte, remapper) != WFLZW::EncodeStatus::inputByteTooLarge)
+        PRINTERROR("Error: a byte missing from the remapper was not rejected\n");
+    encoder.finalizeEncoding();
+
+    decoder.initialize(remapper.maxByteValue());
+    if(decoder.decodeBytes(gEncodedData.data(), gEncodedData.size()) !=
+       WFLZW::DecodeStatus::inputDone)
+        PRINTERROR("Error: decoding failed\n");
+    remapper.decodeBytes(gDecodedData.data(), gDecodedData.size());
+    if(gDecodedData != gInputData)
+        PRINTERROR("Error: decoded data differs from the original\n");
+
+    // A map created from the start of the input, which also maps the unseen bytes.
+    remapper.startEncodeMapCreation();
+    remapper.addInputBytesForEncodeMap(gInputData.data(), 1000);
+    remapper.finalizeEncodeMapCreation(rootOrder, true);
+    if(remapper.decodeMapSize != 256)
+        PRINTERROR("Error: unseen bytes were not mapped\n");
+    for(unsigned i = 0; i < 256; ++i)
+    {
+        if(remapper.encodeMap[remapper.decodeMap[i]] != i)
+            PRINTERROR("Error: encodeMap and decodeMap don't match\n");
+        if(i > 0 && rootOrder == WFLZW::RootOrder::frequency &&
+           remapper.byteCounts[remapper.decodeMap[i - 1]] <
+           remapper.byteCounts[remapper.decodeMap[i]])
+            PRINTERROR("Error: remapped bytes are in the wrong order\n");
+    }
+
+    return true;
+}
+
+bool runByteRemapperTests()
+{
+    if(!testByteRemapper(WFLZW::RootOrder::byteValue)) ERRORRET;
+    if(!testByteRemapper(WFLZW::RootOrder::frequency)) ERRORRET;
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+class TestWideEncoder: public WFLZW::Encoder<kDictionaryMaxSize, kDictType, 256, std::uint16_t>
+{
+ public:
+    virtual void outputEncodedBytes(const WFLZW::Byte* bytes, unsigned amount)
+    {
+        gEncodedData.insert(gEncodedData.end(), bytes, bytes + amount);
+    }
+};
+
+template<unsigned kDictionaryMaxSize>
+class TestWideDecoder: public WFLZW::Decoder<kDictionaryMaxSize, std::uint16_t>
+{
+ public:
+    std::vector<std::uint16_t> mDecodedSymbols;
+
+    virtual void outputDecodedBytes(std::uint16_t* symbols, unsigned amount)
+    {
+        mDecodedSymbols.insert(mDecodedSymbols.end(), symbols, symbols + amount);
+    }
+};
+
+template<unsigned kDictionaryMaxSize>
+bool testWideSymbols(std::uint16_t maxSymbolValue, bool enableFlush)
+{
+    std::cout << "Testing 16-bit symbols with kDictionaryMaxSize=" << kDictionaryMaxSize
+              << ", maxSymbolValue=" << maxSymbolValue << ", enableFlush=" << enableFlush << "\n";
+
+    std::unique_ptr<TestWideEncoder<kDictionaryMaxSize>> encoder
+        (new TestWideEncoder<kDictionaryMaxSize>);
+    std::unique_ptr<TestWideDecoder<kDictionaryMaxSize>> decoder
+        (new TestWideDecoder<kDictionaryMaxSize>);
+
+    // Samples of a periodic signal with noise in the lowest bits.
+    std::mt19937 rngEngine(8);
+    std::vector<std::uint16_t> period(1000), input(1000000);
+    for(std::uint16_t& sample: period)
+        sample = std::uint16_t(rngEngine() % (maxSymbolValue / 2U + 1));
+    for(std::size_t i = 0; i < input.size(); ++i)
+        input[i] = std::uint16_t(period[i % period.size()] + rngEngine() % 4);
+
+    gEncodedData.clear();
+    encoder->initialize(maxSymbolValue, enableFlush);
+    for(std::size_t index = 0; index < input.size(); index += 100000)
+    {
+        if(encoder->encodeBytes(input.data() + index, 100000) != WFLZW::EncodeStatus::ok)
+            PRINTERROR("Error: encoding failed\n");
+        if(enableFlush) encoder->flush();
+    }
+    encoder->finalizeEncoding();
+
+    decoder->initialize(maxSymbolValue, enableFlush);
+    if(decoder->decodeBytes(gEncodedData.data(), gEncodedData.size()) !=
+       WFLZW::DecodeStatus::inputDone || decoder->mDecodedSymbols != input)
+        PRINTERROR("Error: decoded data differs from the original\n");
+    const std::vector<WFLZW::Byte> singleStream = gEncodedData;
+
+    if(encoder->encodeByte(std::uint16_t(maxSymbolValue + 1U)) !=
+       (maxSymbolValue < 0xFFFFU ?
+        WFLZW::EncodeStatus::inputByteTooLarge : WFLZW::EncodeStatus::ok))
+        PRINTERROR("Error: a too large symbol was not rejected\n");
+
+    // The same input as byte pairs.
+    gInputData.resize(input.size() * 2);
+    for(std::size_t i = 0; i < input.size(); ++i)
+    {
+        gInputData[i * 2] = WFLZW::Byte(input[i]);
+        gInputData[i * 2 + 1] = WFLZW::Byte(input[i] >> 8);
+    }
+    gEncodedData.clear();
+    TestEncoderContainer<kDictionaryMaxSize> byteEncoderContainer;
+    TestEncoder<kDictionaryMaxSize>& byteEncoder = byteEncoderContainer.instance();
+    byteEncoder.initialize(255, enableFlush);
+    byteEncoder.encodeBytes(gInputData.data(), gInputData.size());
+    byteEncoder.finalizeEncoding();
+    std::cout << "  Byte pairs: " << gEncodedData.size() << " bytes, 16-bit symbols: "
+              << singleStream.size() << " bytes\n";
+
+    // Appending to the stream from a checkpoint.
+    if(!enableFlush)
+    {
+        std::vector<WFLZW::Byte> checkpoint;
+        std::uint64_t streamSize = 0;
+        gEncodedData.clear();
+        encoder->initialize(maxSymbolValue, enableFlush);
+        encoder->encodeBytes(input.data(), 300001);
+        encoder->finalizeEncoding(checkpoint);
+        if(!encoder->resumeEncoding(checkpoint.data(), checkpoint.size(), streamSize))
+            PRINTERROR("Error: resumeEncoding() failed\n");
+        gEncodedData.resize(streamSize);
+        encoder->encodeBytes(input.data() + 300001, input.size() - 300001);
+        encoder->finalizeEncoding();
+        if(gEncodedData != singleStream)
+            PRINTERROR("Error: the appended stream differs from a single stream\n");
+    }
+
+    // Remapping the symbols that appear in the input, in frequency order.
+    std::unique_ptr<WFLZW::SymbolRemapper<std::uint16_t>> remapper
+        (new WFLZW::SymbolRemapper<std::uint16_t>);
+    remapper->createEncodeMapFromInputBytes(input.data(), input.size(),
+                                            WFLZW::RootOrder::frequency);
+    for(unsigned i = 1; i < remapper->decodeMapSize; ++i)
+        if(remapper->byteCounts[remapper->decodeMap[i - 1]] <
+           remapper->byteCounts[remapper->decodeMap[i]])
+            PRINTERROR("Error: remapped symbols are in the wrong order\n");
+
+    gEncodedData.clear();
+    encoder->initialize(remapper->maxByteValue(), enableFlush);
+    if(encoder->encodeBytes(input.data(), input.size(), *remapper) != WFLZW::EncodeStatus::ok)
+        PRINTERROR("Error: encoding with the remapper failed\n");
+    encoder->finalizeEncoding();
+
+    decoder->mDecodedSymbols.clear();
+    decoder->initialize(remapper->maxByteValue(), enableFlush);
+    if(decoder->decodeBytes(gEncodedData.data(), gEncodedData.size()) !=
+       WFLZW::DecodeStatus::inputDone)
+        PRINTERROR("Error: decoding failed with the remapper\n");
+    remapper->decodeBytes(decoder->mDecodedSymbols.data(), decoder->mDecodedSymbols.size());
+    if(decoder->mDecodedSymbols != input)
+        PRINTERROR("Error: decoded data differs from the original with the remapper\n");
+
+    return true;
+}
+
+bool runWideSymbolTests()
+{
+    if(!testWideSymbols<8192>(4095, false)) ERRORRET;
+    if(!testWideSymbols<8192>(4095, true)) ERRORRET;
+    if(!testWideSymbols<(1U<<16)>(4095, false)) ERRORRET;
+    if(!testWideSymbols<(1U<<18)>(1000, true)) ERRORRET;
+    if(!testWideSymbols<(1U<<18)>(0xFFFF, false)) ERRORRET;
+    return true;
+}
+
+/* The bit-packed index storage is only used by the encoders and decoders
+   when compiled with WFLZW_BIT_PACKED_INDICES (see the Makefile), so it's
+   also tested here directly, with records of two fields.
+*/
+template<unsigned kIndexBits, std::uint32_t kStoredEmptyIndex>
+static bool testBitPackedIndices()
+{
+    std::cout << "Testing bit-packed indices with " << kIndexBits << " bits" << std::endl;
+
+    using Index_t = WFLZW::BitPackedIndex<kIndexBits, kStoredEmptyIndex>;
+    struct Record
+    {
+        Index_t first, second;
+        Record(WFLZW::Byte* bytes, std::size_t bitOffset):
+            first(bytes, bitOffset), second(bytes, bitOffset + kIndexBits) {}
+    };
+
+    const unsigned kRecordsAmount = 1001;
+    std::unique_ptr<WFLZW::BitPackedArray<Record, 2 * kIndexBits, kRecordsAmount>> array
+        (new WFLZW::BitPackedArray<Record, 2 * kIndexBits, kRecordsAmount>);
+    std::vector<std::uint32_t> values(2 * kRecordsAmount, ~0U);
+    std::mt19937 rng(kIndexBits);
+    const std::uint32_t mask = ~0U >> (32 - kIndexBits);
+
+    for(unsigned i = 0; i < kRecordsAmount; ++i)
+        (*array)[i].first = (*array)[i].second = ~0U;
+
+    for(unsigned round = 0; round < 4; ++round)
+    {
+        for(unsigned i = 0; i < 4 * kRecordsAmount; ++i)
+        {
+            const unsigned recordIndex = rng() % kRecordsAmount, fieldIndex = rng() % 2;
+            std::uint32_t value = rng() & mask;
+            if(value == kStoredEmptyIndex || rng() % 8 == 0) value = ~0U;
+            values[2 * recordIndex + fieldIndex] = value;
+            if(fieldIndex == 0) (*array)[recordIndex].first = value;
+            else (*array)[recordIndex].second = value;
+        }
+
+        const auto& constArray = *array;
+        for(unsigned i = 0; i < kRecordsAmount; ++i)
+        {
+            const std::uint32_t first = constArray[i].first, second = constArray[i].second;
+            if(first != values[2 * i] || second != values[2 * i + 1])
+                PRINTERROR("Error: record ", i, " has values ", first, ", ", second,
+                           " instead of ", values[2 * i], ", ", values[2 * i + 1], "\n");
+        }
+    }
+
+    return true;
+}
+
+bool runBitPackedIndexTests()
+{
+    if(!testBitPackedIndices<1, 0>()) ERRORRET;
+    if(!testBitPackedIndices<17, 0>()) ERRORRET;
+    if(!testBitPackedIndices<17, 0x1FFFF>()) ERRORRET;
+    if(!testBitPackedIndices<23, 0x7FFFFF>()) ERRORRET;
+    if(!testBitPackedIndices<31, 0>()) ERRORRET;
+    if(!testBitPackedIndices<32, 0xFFFFFFFF>()) ERRORRET;
+    return true;
+}
+
+/* Builds compressed streams by hand, as 9-bit codes (which is the initial
+   code width with a 4096-entry dictionary and the default byte range), with
+   a code of 0 meaning padding to the next byte boundary.
+*/
+static std::vector<WFLZW::Byte> createCodeStream(const std::vector<unsigned>& codes)
+{
+    std::vector<WFLZW::Byte> result;
+    std::uint32_t buffer = 0;
+    unsigned bitsAmount = 0;
+    for(unsigned code: codes)
+    {
+        if(code == 0) bitsAmount = (bitsAmount + 7) / 8 * 8;
+        else { buffer |= code << bitsAmount; bitsAmount += 9; }
+
+        for(; bitsAmount >= 8; bitsAmount -= 8, buffer >>= 8)
+            result.push_back(WFLZW::Byte(buffer));
+    }
+    if(bitsAmount > 0) result.push_back(WFLZW::Byte(buffer));
+    return result;
+}
+
+bool testInvalidInput()
+{
+    std::cout << "Testing invalid input\n";
+
+    struct Test { std::vector<unsigned> codes; bool enableFlush; WFLZW::DecodeStatus status; };
+    const Test tests[] =
+    {
+        // KwKwK code as the first code
+        { { 257, 256 }, false, WFLZW::DecodeStatus::inputError },
+        // Codes past the next dictionary entry
+        { { 65, 258, 256 }, false, WFLZW::DecodeStatus::inputError },
+        { { 65, 300, 256 }, false, WFLZW::DecodeStatus::inputError },
+        { { 65, 66, 511, 256 }, false, WFLZW::DecodeStatus::inputError },
+        // KwKwK code right after a sync code
+        { { 65, 257, 0, 258, 256 }, true, WFLZW::DecodeStatus::inputError },
+        // Valid KwKwK codes
+        { { 65, 257, 256 }, false, WFLZW::DecodeStatus::inputDone },
+        { { 65, 257, 0, 66, 258, 256 }, true, WFLZW::DecodeStatus::inputDone },
+    };
+
+    for(const Test& test: tests)
+    {
+        const std::vector<WFLZW::Byte> input = createCodeStream(test.codes);
+        std::unique_ptr<TestDecoder<4096>> decoder(new TestDecoder<4096>);
+        decoder->initialize(255, test.enableFlush);
+        gDecodedData.clear();
+        if(decoder->decodeBytes(input.data(), input.size()) != test.status)
+            PRINTERROR("Error: wrong decoding status for test ", &test - tests, "\n");
+
+        if(!test.enableFlush)
+        {
+            std::vector<WFLZW::Byte> output;
+            if(WFLZW::decompress<4096>(input.data(), input.size(), output) != test.status)
+                PRINTERROR("Error: wrong decompress() status for test ", &test - tests, "\n");
+
+            WFLZW::DecoderStream<4096> stream;
+            WFLZW::Byte outputChunk[3];
+            std::size_t outputAmount;
+            WFLZW::StreamStatus status;
+            stream.setInput(input.data(), input.size());
+            while((status = stream.decode(outputChunk, sizeof(outputChunk), outputAmount)) ==
+                  WFLZW::StreamStatus::outputFull) {}
+            if((status == WFLZW::StreamStatus::inputError) !=
+               (test.status == WFLZW::DecodeStatus::inputError))
+                PRINTERROR("Error: wrong DecoderStream status for test ", &test - tests, "\n");
+        }
+    }
+
+    return true;
+}
+
+#ifdef WFLZW_COLLECT_STATS
+bool runStatsTests()
+{
+    if(!testStats<1024>()) ERRORRET;
+    if(!testStats<(1U<<16)>()) ERRORRET;
+    return true;
+}
+#endif
+
+bool testFilters()
+{
+    std::cout << "Testing pre-filters\n";
+
+    const WFLZW::Filter kFilters[] =
+    { WFLZW::Filter::none, WFLZW::Filter::delta, WFLZW::Filter::shuffle,
+      WFLZW::Filter::shuffleDelta };
+    const unsigned kElementSizes[] = { 1, 2, 3, 4, 8, 13, 255 };
+    std::mt19937 rngEngine(2);
+    std::uniform_int_distribution<unsigned> randomByte(0, 255), randomSize(0, 600);
+    std::vector<WFLZW::Byte> input, filtered, output;
+
+    for(unsigned round = 0; round < 20; ++round)
+    {
+        input.resize(round == 0 ? 0 : randomSize(rngEngine));
+        for(WFLZW::Byte& byte: input) byte = WFLZW::Byte(randomByte(rngEngine));
+        filtered.assign(input.size() + 1, 0xAA);
+        output.assign(input.size() + 1, 0x55);
+
+        for(WFLZW::Filter filter: kFilters)
+            for(unsigned elementSize: kElementSizes)
+            {
+                WFLZW::applyFilter(filter, elementSize, input.data(), filtered.data(),
+                                   input.size());
+                WFLZW::reverseFilter(filter, elementSize, filtered.data(), output.data(),
+                                     input.size());
+                if(!std::equal(input.begin(), input.end(), output.begin()) ||
+                   filtered.back() != 0xAA || output.back() != 0x55)
+                    PRINTERROR("Error: filter=", int(filter), ", elementSize=", elementSize,
+                               ", size=", input.size(), "\n");
+            }
+    }
+
+    // Byte planes of two 16-bit values, and the delta of three-byte pixels.
+    const WFLZW::Byte kValues[] = { 1, 2, 3, 4, 5 }, kShuffled[] = { 1, 3, 2, 4, 5 };
+    const WFLZW::Byte kPixels[] = { 10, 20, 30, 11, 22, 33 }, kDeltas[] = { 10, 20, 30, 1, 2, 3 };
+    WFLZW::Byte result[6];
+    WFLZW::applyFilter(WFLZW::Filter::shuffle, 2, kValues, result, 5);
+    if(!std::equal(kShuffled, kShuffled + 5, result)) PRINTERROR("Error: wrong shuffle\n");
+    WFLZW::applyFilter(WFLZW::Filter::delta, 3, kPixels, result, 6);
+    if(!std::equal(kDeltas, kDeltas + 6, result)) PRINTERROR("Error: wrong delta\n");
+
+    return true;
+}
+
+template<unsigned kDictionaryMaxSize>
+bool testBlockFilters()
+{
+    std::cout << "Testing filtered blocks with kDictionaryMaxSize=" << kDictionaryMaxSize << "\n";
+
+    std::unique_ptr<TestBlockEncoder<kDictionaryMaxSize>> encoder
+        (new TestBlockEncoder<kDictionaryMaxSize>);
+    std::unique_ptr<TestBlockDecoder<kDictionaryMaxSize>> decoder
+        (new TestBlockDecoder<kDictionaryMaxSize>);
+    std::mt19937 rngEngine(3);
+    std::uniform_int_distribution<unsigned> randomNoise(0, 15), randomChunkSize(1, 3000);
+
+    // 0 = increasing 32-bit counters, 1 = 3-byte pixels of a noisy gradient
+    for(unsigned dataType = 0; dataType < 2; ++dataType)
+    {
+        const unsigned kDataSize = 30000;
+        const WFLZW::Filter filter =
+            (dataType == 0 ? WFLZW::Filter::shuffleDelta : WFLZW::Filter::delta);
+        const unsigned elementSize = (dataType == 0 ? 4 : 3);
+
+        gInputData.resize(kDataSize);
+        std::uint32_t counter = 100000;
+        for(unsigned i = 0; i < kDataSize; ++i)
+        {
+            if(dataType == 0)
+            {
+                if(i % 4 == 0) counter += 50 + randomNoise(rngEngine);
+                gInputData[i] = WFLZW::Byte(counter >> (8 * (i % 4)));
+            }
+            else
+                gInputData[i] = WFLZW::Byte((i / 3) % 200 + (i % 3) * 20 + randomNoise(rngEngine));
+        }
+
+        // 0 = no filter, 1 = filter, 2 = filter and entropy coding
+        std::size_t encodedSizes[3];
+        for(unsigned useFilter = 0; useFilter < 3; ++useFilter)
+        {
+            gEncodedData.clear();
+            gDecodedData.clear();
+            encoder->setFilter(useFilter ? filter : WFLZW::Filter::none, elementSize);
+            encoder->setEntropyCoding(useFilter == 2);
+
+            for(std::size_t i = 0; i < kDataSize;)
+            {
+                const std::size_t amount =
+                    std::min(std::size_t(randomChunkSize(rngEngine)), kDataSize - i);
+                encoder->encodeBytes(&gInputData[i], amount);
+                i += amount;
+            }
+            encoder->finalizeEncoding();
+            encodedSizes[useFilter] = gEncodedData.size();
+
+            decoder->initialize();
+            WFLZW::DecodeStatus status = WFLZW::DecodeStatus::inputContinues;
+            for(std::size_t i = 0; i < gEncodedData.size();)
+            {
+                const std::size_t amount =
+                    std::min(std::size_t(randomChunkSize(rngEngine)), gEncodedData.size() - i);
+                status = decoder->decodeBytes(&gEncodedData[i], amount);
+                i += amount;
+            }
+
+            if(status != WFLZW::DecodeStatus::inputDone || gInputData != gDecodedData)
+                PRINTERROR("Error: dataType=", dataType, ", useFilter=", useFilter,
+                           ", decoding status=", int(status),
+                           ", gDecodedData.size()=", gDecodedData.size(), "\n");
+        }
+
+        std::cout << "  Unfiltered: " << encodedSizes[0] << " bytes, filtered: "
+                  << encodedSizes[1] << " bytes, filtered and entropy coded: "
+                  << encodedSizes[2] << " bytes\n";
+        if(encodedSizes[1] >= encodedSizes[0] || encodedSizes[2] > encodedSizes[1])
+            PRINTERROR("Error: the filter did not improve compression (dataType=",
+                       dataType, ")\n");
+
+        // An invalid filter type must be detected.
+        gEncodedData[9] = 0x7F;
+        decoder->initialize();
+        if(decoder->decodeBytes(&gEncodedData[0], gEncodedData.size()) !=
+           WFLZW::DecodeStatus::inputError)
+            PRINTERROR("Error: invalid filter type was not detected\n");
+    }
+
+    // Changing the filter in the middle of a block affects only the next block.
+    gInputData.assign(6000, 7);
+    gEncodedData.clear();
+    gDecodedData.clear();
+    encoder->setFilter(WFLZW::Filter::none);
+    encoder->setEntropyCoding(false);
+    encoder->encodeBytes(&gInputData[0], 1000);
+    encoder->setFilter(WFLZW::Filter::delta, 2);
+    encoder->encodeBytes(&gInputData[1000], 5000);
+    encoder->finalizeEncoding();
+
+    if(gEncodedData[0] != WFLZW::Byte(WFLZW::BlockType::lzw))
+        PRINTERROR("Error: wrong type for the first block: ", int(gEncodedData[0]), "\n");
+    decoder->initialize();
+    if(decoder->decodeBytes(&gEncodedData[0], gEncodedData.size()) !=
+       WFLZW::DecodeStatus::inputDone || gInputData != gDecodedData)
+        PRINTERROR("Error: decoding failed after changing the filter\n");
+
+    return true;
+}
+
+/* With a small dictionary the encoder only accepts bytes up to
+   kDictionaryMaxSize-3, so blocks with larger bytes have to be stored.
+*/
+bool testSmallDictionaryBlocks()
+{
+    std::cout << "Testing block format with kDictionaryMaxSize=64 and larger bytes\n";
+
+    std::unique_ptr<TestBlockEncoder<64>> encoder(new TestBlockEncoder<64>);
+    std::unique_ptr<TestBlockDecoder<64>> decoder(new TestBlockDecoder<64>);
+    const char* const kText = "The quick brown fox jumps over the lazy dog. ";
+
+    /* 0 = text, 1 = bytes up to 61, 2 = both, changing in the middle of the
+       second block, 3 = bytes up to 61 with the delta filter (whose output
+       the encoder rejects, so the blocks are compressed unfiltered)
+    */
+    for(unsigned dataType = 0; dataType < 4; ++dataType)
+    {
+        gInputData.resize(132000);
+        for(std::size_t i = 0; i < gInputData.size(); ++i)
+            gInputData[i] = (dataType == 0 || (dataType == 2 && i >= 6000) ?
+                             WFLZW::Byte(kText[i % 45]) : WFLZW::Byte(kText[i % 45] % 62));
+
+        encoder->setFilter(dataType == 3 ? WFLZW::Filter::delta : WFLZW::Filter::none);
+        gEncodedData.clear();
+        gDecodedData.clear();
+        encoder->encodeBytes(gInputData.data(), gInputData.size());
+        encoder->finalizeEncoding();
+
+        decoder->initialize();
+        if(decoder->decodeBytes(gEncodedData.data(), gEncodedData.size()) !=
+           WFLZW::DecodeStatus::inputDone || gInputData != gDecodedData)
+            PRINTERROR("Error: dataType=", dataType, ", gDecodedData.size()=",
+                       gDecodedData.size(), "\n");
+
+        const WFLZW::BlockType expectedType =
+            (dataType == 0 ? WFLZW::BlockType::stored : WFLZW::BlockType::lzw);
+        if(gEncodedData[0] != WFLZW::Byte(expectedType) ||
+           (dataType % 2 == 1 && gEncodedData.size() >= gInputData.size()))
+            PRINTERROR("Error: dataType=", dataType, ", first block type ", int(gEncodedData[0]),
+                       ", gEncodedData.size()=", gEncodedData.size(), "\n");
+    }
+
+    return true;
+}
+
+bool runBlockFormatTests()
+{
+    if(!testBlockFormat<1024>(false)) ERRORRET;
+    if(!testBlockFormat<(1U<<16)>(false)) ERRORRET;
+    if(!testBlockFormat<300>(true)) ERRORRET;
+    if(!testBlockFormat<1024>(true)) ERRORRET;
+    if(!testBlockFormat<(1U<<16)>(true)) ERRORRET;
+    if(!testSmallDictionaryBlocks()) ERRORRET;
+    if(!testFilters()) ERRORRET;
+    if(!testBlockFilters<1024>()) ERRORRET;
+    if(!testBlockFilters<(1U<<16)>()) ERRORRET;
+    return true;
+}
+
 void printSize(unsigned size)
 {
     if(size < 16*1024)
@@ -461,6 +2651,26 @@ bool runGenericTests()
 int main()
 {
     if(!runCombinationsTests()) return 1;
+    if(!runBlockFormatTests()) return 1;
+    if(!runBatchTests()) return 1;
+    if(!runLargeObjectTests()) return 1;
+#ifdef WFLZW_COLLECT_STATS
+    if(!runStatsTests()) return 1;
+#endif
+    if(!runFlushTests()) return 1;
+    if(!runSessionTests()) return 1;
+    if(!runCheckpointTests()) return 1;
+    if(!runLookaheadEncoderTests()) return 1;
+    if(!runClassicFormatTests()) return 1;
+    if(!runPatternSearchTests()) return 1;
+    if(!runVerifyingEncoderTests()) return 1;
+    if(!runConvenienceFunctionTests()) return 1;
+    if(!runResetPointTests()) return 1;
+    if(!runDecoderStreamTests()) return 1;
+    if(!testInvalidInput()) return 1;
+    if(!runByteRemapperTests()) return 1;
+    if(!runWideSymbolTests()) return 1;
+    if(!runBitPackedIndexTests()) return 1;
     if(!runGenericTests()) return 1;
 
     std::cout << "All tests ok.\n";